@@ -40,10 +40,23 @@ struct RefcountMapValuePurgeable {
 // don't want the table to act as a root for `leaks`.
 typedef objc::DenseMap<DisguisedPtr<objc_object>,size_t,RefcountMapValuePurgeable> RefcountMap;
 
+#if ISA_HAS_BIASED_RC
+// A thread's share of the retain counts of its biased objects.
+// See OBJC_BIASED_RC in NSObject.mm.
+struct BiasedRCTable;
+#endif
+
 // Template parameters.
 enum HaveOld { DontHaveOld = false, DoHaveOld = true };
 enum HaveNew { DontHaveNew = false, DoHaveNew = true };
 
+struct SideTableAux;
+
+// slock protects refcnts. The lock for weak_table is in the stripe's
+// SideTableAux, on a cache line of its own, so retain counts and weak
+// references of objects in one stripe do not contend. Code that needs
+// both takes the weak lock first. These three fields keep the layout
+// and stride debuggers know; everything else is in SideTableAux.
 struct SideTable {
     spinlock_t slock;
     RefcountMap refcnts;
@@ -59,9 +72,18 @@ struct SideTable {
 
     void lock() { slock.lock(); }
     void unlock() { slock.unlock(); }
-    void reset() { slock.reset(); }
 
-    // Address-ordered lock discipline for a pair of side tables.
+    inline SideTableAux& aux();
+
+    inline void lockWeak();
+    inline void unlockWeak();
+    inline void reset();
+
+    inline unsigned beginWeakRead();
+    inline void endWeakRead(unsigned phase);
+    void waitForWeakReaders();
+
+    // Address-ordered weak lock discipline for a pair of side tables.
 
     template<HaveOld, HaveNew>
     static void lockTwo(SideTable *lock1, SideTable *lock2);
@@ -69,6 +91,146 @@ struct SideTable {
     static void unlockTwo(SideTable *lock1, SideTable *lock2);
 };
 
+// The rest of a side table stripe, in an array parallel to the stripes.
+struct SideTableAux {
+    // Protects the stripe's weak_table.
+    spinlock_t wlock;
+#if ISA_HAS_BIASED_RC
+    // The owner of each biased object in this stripe. Protected by slock.
+    objc::DenseMap<DisguisedPtr<objc_object>, BiasedRCTable *> biasedOwners;
+#endif
+
+    // Lock-free weak loads in progress, counted in the phase that was
+    // current when they started. See waitForWeakReaders().
+    std::atomic<uintptr_t> weakReaders[2] alignas(CacheLineSize);
+    std::atomic<unsigned> weakReaderPhase;
+
+    SideTableAux() : weakReaders{0, 0}, weakReaderPhase(0) { }
+
+    ~SideTableAux() {
+        _objc_fatal("Do not delete SideTableAux.");
+    }
+};
+
+void SideTable::lockWeak() { aux().wlock.lock(); }
+void SideTable::unlockWeak() { aux().wlock.unlock(); }
+
+void SideTable::reset() {
+    slock.reset();
+    aux().wlock.reset();
+    aux().weakReaders[0].store(0, std::memory_order_relaxed);
+    aux().weakReaders[1].store(0, std::memory_order_relaxed);
+}
+
+unsigned SideTable::beginWeakRead() {
+    SideTableAux& a = aux();
+    unsigned phase = a.weakReaderPhase.load(std::memory_order_relaxed) & 1;
+    a.weakReaders[phase].fetch_add(1, std::memory_order_seq_cst);
+    return phase;
+}
+
+void SideTable::endWeakRead(unsigned phase) {
+    aux().weakReaders[phase].fetch_sub(1, std::memory_order_release);
+}
+
+
+// The side tables, striped by object address. The stripe count is a
+// power of two chosen from the number of CPUs when the runtime starts,
+// so processes on large machines spread their retain counts and weak
+// references over more locks. Debuggers find the stripes through
+// objc_debug_side_table_stripes: the array pointer, then the index mask.
+// Each stripe's SideTableAux is at the same index in a second array.
+class SideTableStripes : nocopy_t {
+    struct PaddedSideTable {
+        SideTable value alignas(CacheLineSize);
+    };
+    struct PaddedSideTableAux {
+        SideTableAux value alignas(CacheLineSize);
+    };
+
+    PaddedSideTable *array;
+    uintptr_t mask;
+    PaddedSideTableAux *auxArray;
+
+    unsigned indexForPointer(const void *p) const {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+        return ((addr >> 4) ^ (addr >> 9)) & mask;
+    }
+
+public:
+    static constexpr size_t StripeSize = sizeof(PaddedSideTable);
+    static constexpr size_t AuxSize = sizeof(PaddedSideTableAux);
+    static constexpr size_t StripeAlignment = alignof(PaddedSideTable);
+
+    // storage holds count stripes of StripeSize bytes, and auxStorage
+    // count of AuxSize bytes. Both are StripeAlignment aligned.
+    SideTableStripes(void *storage, void *auxStorage, unsigned count)
+        : mask(count - 1)
+    {
+        ASSERT(count  &&  (count & (count - 1)) == 0);
+        ASSERT((uintptr_t)storage % StripeAlignment == 0);
+        ASSERT((uintptr_t)auxStorage % StripeAlignment == 0);
+        array = (PaddedSideTable *)storage;
+        auxArray = (PaddedSideTableAux *)auxStorage;
+        for (unsigned i = 0; i < count; i++) {
+            new (&array[i]) PaddedSideTable();
+            new (&auxArray[i]) PaddedSideTableAux();
+        }
+    }
+
+    SideTable& operator[] (const void *p) {
+        return array[indexForPointer(p)].value;
+    }
+
+    SideTableAux& auxFor(const SideTable *table) {
+        return auxArray[(const PaddedSideTable *)table - array].value;
+    }
+
+    template<typename F>
+    void forEach(F f) {
+        for (unsigned i = 0; i <= mask; i++) {
+            f(array[i].value);
+        }
+    }
+
+    // Lock every weak lock, then every refcount lock.
+    void lockAll() {
+        for (unsigned i = 0; i <= mask; i++) auxArray[i].value.wlock.lock();
+        for (unsigned i = 0; i <= mask; i++) array[i].value.slock.lock();
+    }
+
+    void unlockAll() {
+        for (unsigned i = 0; i <= mask; i++) array[i].value.slock.unlock();
+        for (unsigned i = 0; i <= mask; i++) auxArray[i].value.wlock.unlock();
+    }
+
+    void forceResetAll() {
+        forEach([](SideTable& table) { table.reset(); });
+    }
+
+    // Weak locks in address order, then refcount locks in address order.
+    void defineLockOrder() {
+        for (unsigned i = 1; i <= mask; i++) {
+            lockdebug::lock_precedes_lock(&auxArray[i-1].value.wlock,
+                                          &auxArray[i].value.wlock);
+            lockdebug::lock_precedes_lock(&array[i-1].value.slock,
+                                          &array[i].value.slock);
+        }
+        lockdebug::lock_precedes_lock(&auxArray[mask].value.wlock,
+                                      &array[0].value.slock);
+    }
+
+    void precedeLock(const void *newlock) {
+        // assumes defineLockOrder is also called
+        lockdebug::lock_precedes_lock(&array[mask].value.slock, newlock);
+    }
+
+    void succeedLock(const void *oldlock) {
+        // assumes defineLockOrder is also called
+        lockdebug::lock_precedes_lock(oldlock, &auxArray[0].value.wlock);
+    }
+};
+
 }
 
 #endif
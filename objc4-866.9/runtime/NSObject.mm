@@ -120,6 +120,7 @@ static void _initializeSwiftRefcountingThenCallRelease(id objc) {
 
 namespace objc {
     extern int PageCountWarning;
+    extern int PoolPageStashLimit;
 }
 
 namespace {
@@ -141,51 +142,104 @@ template<>
 void SideTable::lockTwo<DoHaveOld, DoHaveNew>
     (SideTable *lock1, SideTable *lock2)
 {
-    spinlock_t::lockTwo(&lock1->slock, &lock2->slock);
+    spinlock_t::lockTwo(&lock1->aux().wlock, &lock2->aux().wlock);
 }
 
 template<>
 void SideTable::lockTwo<DoHaveOld, DontHaveNew>
     (SideTable *lock1, SideTable *)
 {
-    lock1->lock();
+    lock1->lockWeak();
 }
 
 template<>
 void SideTable::lockTwo<DontHaveOld, DoHaveNew>
     (SideTable *, SideTable *lock2)
 {
-    lock2->lock();
+    lock2->lockWeak();
 }
 
 template<>
 void SideTable::unlockTwo<DoHaveOld, DoHaveNew>
     (SideTable *lock1, SideTable *lock2)
 {
-    spinlock_t::unlockTwo(&lock1->slock, &lock2->slock);
+    spinlock_t::unlockTwo(&lock1->aux().wlock, &lock2->aux().wlock);
 }
 
 template<>
 void SideTable::unlockTwo<DoHaveOld, DontHaveNew>
     (SideTable *lock1, SideTable *)
 {
-    lock1->unlock();
+    lock1->unlockWeak();
 }
 
 template<>
 void SideTable::unlockTwo<DontHaveOld, DoHaveNew>
     (SideTable *, SideTable *lock2)
 {
-    lock2->unlock();
+    lock2->unlockWeak();
 }
 
-static objc::ExplicitInit<StripedMap<SideTable>> SideTablesMap;
-OBJC_EXTERN void *const objc_debug_side_tables_map = &SideTablesMap;
+#if TARGET_OS_IPHONE && !TARGET_OS_SIMULATOR
+enum { SideTableMinStripes = 8, SideTableMaxStripes = 64 };
+#else
+enum { SideTableMinStripes = 64, SideTableMaxStripes = 1024 };
+#endif
+
+// SideTableMinStripes is the old fixed stripe count. That many stripes
+// live in static storage, as they always have; more are allocated.
+alignas(SideTableStripes::StripeAlignment)
+static uint8_t SideTableStorage[SideTableMinStripes * SideTableStripes::StripeSize];
+alignas(SideTableStripes::StripeAlignment)
+static uint8_t SideTableAuxStorage[SideTableMinStripes * SideTableStripes::AuxSize];
+
+static objc::ExplicitInit<SideTableStripes> SideTablesMap;
+static bool SideTablesInitialized;
+
+// The array pointer, then the index mask.
+OBJC_EXTERN void *const objc_debug_side_table_stripes = &SideTablesMap;
+// The static stripes, with the same layout and stride as before. They
+// are the stripes in use unless the CPU count asked for more.
+OBJC_EXTERN void *const objc_debug_side_tables_map = SideTableStorage;
 
-static StripedMap<SideTable>& SideTables() {
+static SideTableStripes& SideTables() {
     return SideTablesMap.get();
 }
 
+SideTableAux& SideTable::aux() {
+    return SideTables().auxFor(this);
+}
+
+static void *allocSideTableArray(size_t size) {
+    void *result;
+    if (posix_memalign(&result, SideTableStripes::StripeAlignment, size) != 0) {
+        _objc_fatal("could not allocate %zu bytes of side tables", size);
+    }
+    return result;
+}
+
+// Set up the side tables: four stripes per CPU, rounded up to a 
+// power of two and clamped to [SideTableMinStripes, SideTableMaxStripes].
+// Called by arr_init(), and earlier by the lock order setup 
+// when LOCKDEBUG is on.
+static void SideTablesInit() {
+    if (SideTablesInitialized) return;
+
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    unsigned wanted = (cpus > 0) ? (unsigned)cpus * 4 : SideTableMinStripes;
+    unsigned count = SideTableMinStripes;
+    while (count < wanted  &&  count < SideTableMaxStripes) count *= 2;
+
+    if (count == SideTableMinStripes) {
+        SideTablesMap.init(SideTableStorage, SideTableAuxStorage, count);
+    } else {
+        SideTablesMap.init(allocSideTableArray(count * SideTableStripes::StripeSize),
+                           allocSideTableArray(count * SideTableStripes::AuxSize),
+                           count);
+    }
+    SideTablesInitialized = true;
+}
+
 // anonymous namespace
 };
 
@@ -202,18 +256,22 @@ void SideTableForceResetAll() {
 }
 
 void SideTableDefineLockOrder() {
+    SideTablesInit();
     SideTables().defineLockOrder();
 }
 
 void SideTableLocksPrecedeLock(const void *newlock) {
+    SideTablesInit();
     SideTables().precedeLock(newlock);
 }
 
 void SideTableLocksSucceedLock(const void *oldlock) {
+    SideTablesInit();
     SideTables().succeedLock(oldlock);
 }
 
 void SideTableLocksPrecedeLocks(StripedMap<spinlock_t>& newlocks) {
+    SideTablesInit();
     int i = 0;
     const void *newlock;
     while ((newlock = newlocks.getLock(i++))) {
@@ -222,6 +280,7 @@ void SideTableLocksPrecedeLocks(StripedMap<spinlock_t>& newlocks) {
 }
 
 void SideTableLocksSucceedLocks(StripedMap<spinlock_t>& oldlocks) {
+    SideTablesInit();
     int i = 0;
     const void *oldlock;
     while ((oldlock = oldlocks.getLock(i++))) {
@@ -493,6 +552,78 @@ objc_destroyWeak(id *location)
   So we now don't touch the storage until deallocation completes.
 */
 
+/***********************************************************************
+* SideTable::waitForWeakReaders
+* Wait for lock-free weak loads that may have read a referrer before 
+* weak_clear_no_lock() cleared it, so the referent is not freed while 
+* they look at its isa. Loads that start later re-read the referrer 
+* after counting themselves, and see nil.
+* Each counter only stays nonzero while a load that counted itself 
+* in it is running, so seeing each counter at zero once is enough. 
+* New loads count themselves in the current phase's counter. Before
+* waiting for that counter, the phase is flipped to keep new loads out
+* of it, so a steady stream of them cannot starve the caller. The
+* other counter only drains, so it is waited for without a flip.
+* Locking: the weak lock must be held. It serializes the flips. 
+* The refcount lock must not be held: loads may call rootTryRetain.
+**********************************************************************/
+void
+SideTable::waitForWeakReaders()
+{
+    SideTableAux& a = aux();
+    auto& weakReaders = a.weakReaders;
+    auto& weakReaderPhase = a.weakReaderPhase;
+
+    // Order the cleared referrers before the counter reads.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    for (unsigned i = 0; i < 2; i++) {
+        unsigned current = weakReaderPhase.load(std::memory_order_relaxed) & 1;
+        unsigned phase = current;
+        if (weakReaders[phase].load(std::memory_order_seq_cst) == 0) {
+            phase ^= 1;
+            if (weakReaders[phase].load(std::memory_order_seq_cst) == 0) {
+                return;
+            }
+        }
+        if (phase == current) {
+            weakReaderPhase.fetch_add(1, std::memory_order_seq_cst);
+        }
+        while (weakReaders[phase].load(std::memory_order_seq_cst) != 0) {
+            sched_yield();
+        }
+    }
+}
+
+
+#if SUPPORT_NONPOINTER_ISA
+// Load and retain a weak referent without the weak lock.
+// Returns true and sets *result if the load was decided, 
+// or false if the caller must take the locked path.
+static ALWAYS_INLINE bool
+loadWeakRetainedLockFree(id *location, id obj, SideTable *table, id *result)
+{
+    unsigned phase = table->beginWeakRead();
+
+    // Counted as a reader, a referrer that still holds obj means 
+    // obj cannot be freed until endWeakRead().
+    bool decided = false;
+    if (__c11_atomic_load((_Atomic(id) *)location, __ATOMIC_SEQ_CST) == obj) {
+        isa_t bits = obj->isa();
+        // Raw isa objects keep their deallocating bit in the side table, 
+        // which is erased before the weak lock is released.
+        if (bits.nonpointer  &&  !bits.getDecodedClass(false)->hasCustomRR()) {
+            *result = obj->rootTryRetain() ? obj : nil;
+            decided = true;
+        }
+    }
+
+    table->endWeakRead(phase);
+    return decided;
+}
+#endif
+
+
 id
 objc_loadWeakRetained(id *location)
 {
@@ -508,10 +639,16 @@ objc_loadWeakRetained(id *location)
     if (_objc_isTaggedPointerOrNil(obj)) return obj;
     
     table = &SideTables()[obj];
+
+#if SUPPORT_NONPOINTER_ISA
+    if (loadWeakRetainedLockFree(location, obj, table, &result)) {
+        return result;
+    }
+#endif
     
-    table->lock();
+    table->lockWeak();
     if (*location != obj) {
-        table->unlock();
+        table->unlockWeak();
         goto retry;
     }
     
@@ -543,13 +680,13 @@ objc_loadWeakRetained(id *location)
             }
         }
         else {
-            table->unlock();
+            table->unlockWeak();
             class_initialize(cls, obj);
             goto retry;
         }
     }
         
-    table->unlock();
+    table->unlockWeak();
     return result;
 }
 
@@ -616,9 +753,9 @@ retry:
     }
 
     table = &SideTables()[obj];
-    table->lock();
+    table->lockWeak();
     if (*src != obj) {
-        table->unlock();
+        table->unlockWeak();
         goto retry;
     }
 
@@ -626,7 +763,7 @@ retry:
     weak_register_no_lock(&table->weak_table, obj, dst, DontCheckDeallocating);
     *dst = obj;
     *src = nil;
-    table->unlock();
+    table->unlockWeak();
 }
 
 
@@ -684,7 +821,20 @@ private:
 
     // SIZE-sizeof(*this) bytes of contents follow
 
+    // Pages freed by popPage() are parked in a per-thread stash of up to
+    // objc::PoolPageStashLimit pages (OBJC_POOL_PAGE_STASH) and handed
+    // out again before asking malloc for a new one. Pool debugging
+    // bypasses the stash so heap debuggers see every page come and go.
     static void * operator new(size_t size) {
+        if (!DebugPoolAllocation) {
+            _objc_pthread_data *data = _objc_fetch_pthread_data(true);
+            if (data  &&  data->poolPageStash) {
+                void *result = data->poolPageStash;
+                data->poolPageStash = *(void **)result;
+                data->poolPageStashCount--;
+                return result;
+            }
+        }
 #if SUPPORT_ZONES
         return malloc_zone_memalign(malloc_default_zone(), SIZE, SIZE);
 #else
@@ -695,6 +845,21 @@ private:
 #endif
     }
     static void operator delete(void * p) {
+        // Don't create the thread data here. It is already gone if this
+        // thread is exiting and its pages are freed after it.
+        _objc_pthread_data *data;
+        if (!DebugPoolAllocation  &&
+            (data = _objc_fetch_pthread_data(false))  &&
+            data->poolPageStashCount < (unsigned)objc::PoolPageStashLimit)
+        {
+            *(void **)p = data->poolPageStash;
+            data->poolPageStash = p;
+            if (++data->poolPageStashCount > data->poolPageStashHiwat) {
+                data->poolPageStashHiwat = data->poolPageStashCount;
+                if (PrintPoolHiwat) printStashHiwat(data->poolPageStashHiwat);
+            }
+            return;
+        }
         return free(p);
     }
 
@@ -898,6 +1063,64 @@ private:
         releaseUntil(begin());
     }
 
+    // Entries taken off a page per pass of releaseUntil(), and how far
+    // ahead of the release the next objects are prefetched.
+    static size_t const RELEASE_SLICE = 128;
+    static size_t const RELEASE_PREFETCH = 8;
+
+    // The object in a pool slot, and how many more times it was autoreleased.
+    static inline id slotObject(id *slot, int *extra)
+    {
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+        AutoreleasePoolEntry *entry = (AutoreleasePoolEntry *)slot;
+        // create an obj with the zeroed out top byte
+        *extra = (int)entry->count;
+        return (id)entry->ptr;
+#else
+        *extra = 0;
+        return *slot;
+#endif
+    }
+
+    // Release a slice in pool order, top first, prefetching the objects
+    // that come after it.
+    static void releaseSlice(id *slice, size_t n)
+    {
+        for (size_t i = n; i-- > 0; ) {
+            int extra;
+            if (i >= RELEASE_PREFETCH) {
+                id ahead = slotObject(&slice[i - RELEASE_PREFETCH], &extra);
+                if (ahead != POOL_BOUNDARY) __builtin_prefetch(ahead, 1);
+            }
+            id obj = slotObject(&slice[i], &extra);
+            if (obj != POOL_BOUNDARY) {
+                // release count+1 times since it is count of the additional
+                // autoreleases beyond the first one
+                for (int j = 0; j < extra + 1; j++) {
+                    objc_release(obj);
+                }
+            }
+        }
+    }
+
+    // Release a slice through objc_object::releaseBatch(), which
+    // deallocates after every count in the slice is updated, grouped by
+    // class. Used with OBJC_BATCH_POOL_POP.
+    static void releaseSliceBatched(id *slice, size_t n)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < n; i++) {
+            int extra;
+            id obj = slotObject(&slice[i], &extra);
+            if (obj == POOL_BOUNDARY) continue;
+            // The pool still holds one more reference, so these
+            // releases never deallocate.
+            while (extra--) objc_release(obj);
+            slice[count++] = obj;
+        }
+        objc_object::releaseBatch(slice, count, true);
+    }
+
     void releaseUntil(id *stop) 
     {
         // Not recursive: we don't want to blow out the stack 
@@ -915,29 +1138,26 @@ private:
                     setHotPage(page);
                 }
 
-                page->unprotect();
-#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
-                AutoreleasePoolEntry* entry = (AutoreleasePoolEntry*) --page->next;
+                // Take a slice off the top of the page before releasing
+                // any of it. Objects autoreleased by those releases go
+                // above the slice and are found by the next pass.
+                id *low = (page == this) ? stop : page->begin();
+                if ((size_t)(page->next - low) > RELEASE_SLICE) {
+                    low = page->next - RELEASE_SLICE;
+                }
+                size_t n = page->next - low;
+                id slice[RELEASE_SLICE];
 
-                // create an obj with the zeroed out top byte and release that
-                id obj = (id)entry->ptr;
-                int count = (int)entry->count;  // grab these before memset
-#else
-                id obj = *--page->next;
-#endif
-                memset((void*)page->next, SCRIBBLE, sizeof(*page->next));
+                page->unprotect();
+                memcpy(slice, (void *)low, n * sizeof(id));
+                memset((void *)low, SCRIBBLE, n * sizeof(id));
+                page->next = low;
                 page->protect();
 
-                if (obj != POOL_BOUNDARY) {
-#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
-                    // release count+1 times since it is count of the additional
-                    // autoreleases beyond the first one
-                    for (int i = 0; i < count + 1; i++) {
-                        objc_release(obj);
-                    }
-#else
-                    objc_release(obj);
-#endif
+                if (slowpath(BatchPoolPop)) {
+                    releaseSliceBatched(slice, n);
+                } else {
+                    releaseSlice(slice, n);
                 }
             }
 
@@ -1135,6 +1355,82 @@ public:
         return obj;
     }
 
+    // Autorelease objs[0..count), which must already have been filtered
+    // by objc_object::autoreleaseBatch(). The first object goes through
+    // autoreleaseFast(), which also coalesces it with the top of the pool.
+    // Every page the rest need is allocated first, then each page is
+    // filled in one pass. When coalescing is enabled, adjacent duplicates
+    // in the batch become one entry.
+    static void autoreleaseBatch(id *objs, size_t count)
+    {
+        if (count == 0) return;
+        if (!autoreleaseFast(objs[0])) {
+            // No pool in place; autoreleaseNoPage() complains per object.
+            for (size_t i = 1; i < count; i++) autoreleaseFast(objs[i]);
+            return;
+        }
+        objs++;
+        count--;
+        if (count == 0) return;
+
+        bool coalesce = false;
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+        coalesce = !DisableAutoreleaseCoalescing || !DisableAutoreleaseCoalescingLRU;
+#endif
+        // Length of the run of identical objects starting at objs[i].
+        auto runLength = [&](size_t i) -> size_t {
+            size_t k = 1;
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+            if (coalesce) {
+                while (i + k < count  &&  objs[i + k] == objs[i]  &&
+                       k <= AutoreleasePoolEntry::maxCount) {
+                    k++;
+                }
+            }
+#endif
+            return k;
+        };
+
+        size_t entries = count;
+        if (coalesce) {
+            entries = 0;
+            for (size_t i = 0; i < count; i += runLength(i)) entries++;
+        }
+
+        AutoreleasePoolPage *page = hotPage();
+        size_t room = page->end() - page->next;
+        size_t perPage = page->end() - page->begin();
+        for (AutoreleasePoolPage *last = page; room < entries; room += perPage) {
+            last = last->child ? last->child : new AutoreleasePoolPage(last);
+        }
+
+        size_t i = 0;
+        while (true) {
+            page->unprotect();
+            if (coalesce) {
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+                while (i < count  &&  !page->full()) {
+                    size_t k = runLength(i);
+                    AutoreleasePoolEntry *entry = (AutoreleasePoolEntry *)page->next++;
+                    entry->ptr = (uintptr_t)objs[i];
+                    entry->count = k - 1;
+                    ASSERT(entry->ptr == (uintptr_t)objs[i]);
+                    i += k;
+                }
+#endif
+            } else {
+                size_t k = std::min(count - i, (size_t)(page->end() - page->next));
+                memcpy((void *)page->next, objs + i, k * sizeof(id));
+                page->next += k;
+                i += k;
+            }
+            page->protect();
+            if (i == count) break;
+            page = page->child;
+        }
+        setHotPage(page);
+    }
+
     static inline void moveTLSAutoreleaseToPool(ReturnAutoreleaseInfo info)
     {
         if (id obj = info.getReturnedObject()) {
@@ -1391,6 +1687,14 @@ public:
         }
     }
 
+    __attribute__((noinline, cold))
+    static void printStashHiwat(unsigned pages)
+    {
+        _objc_inform("POOL HIGHWATER: new high water mark of %u free "
+                     "pages (%zu bytes) stashed for thread %p",
+                     pages, pages * SIZE, objc_thread_self());
+    }
+
 #undef POOL_BOUNDARY
 
     friend struct ReturnAutoreleaseInfo::TlsDealloc;
@@ -1448,6 +1752,20 @@ public:
 tls_direct(AutoreleasePoolPage *, tls_key::autorelease_pool,
            AutoreleasePoolPage::HotPageDealloc) AutoreleasePoolPage::hotPage_;
 
+/***********************************************************************
+* _destroyPoolPageStash
+* Free the autorelease pool pages stashed by a thread that is exiting.
+* Called from the destructor of the thread's _objc_pthread_data.
+**********************************************************************/
+void _destroyPoolPageStash(void *stash)
+{
+    while (stash) {
+        void *next = *(void **)stash;
+        free(stash);
+        stash = next;
+    }
+}
+
 /***********************************************************************
 * Slow paths for inline control
 **********************************************************************/
@@ -1468,6 +1786,70 @@ objc_object::rootRelease_underflow(bool performDealloc)
 }
 
 
+// Batched retain for objc_retainBatch().
+// Retaining a deallocating object does nothing, as in rootRetain().
+bool
+objc_object::rootRetainBatch_fast(size_t count)
+{
+    if (count > RC_HALF) return false;
+
+    isa_t oldisa = LoadExclusive(&isa().bits);
+    isa_t newisa;
+    do {
+        newisa = oldisa;
+        if (slowpath(!newisa.nonpointer)) {
+            ClearExclusive(&isa().bits);
+            return false;
+        }
+        if (slowpath(newisa.isDeallocating())) {
+            ClearExclusive(&isa().bits);
+            return true;
+        }
+        uintptr_t carry;
+        newisa.bits = addc(newisa.bits, RC_ONE * count, 0, &carry);  // extra_rc += count
+        if (slowpath(carry)) {
+            ClearExclusive(&isa().bits);
+            return false;
+        }
+    } while (slowpath(!StoreExclusive(&isa().bits, &oldisa.bits, newisa.bits)));
+
+    return true;
+}
+
+
+// Batched release for objc_releaseBatch().
+// Only handles releases that leave the object alive without
+// borrowing from the side table.
+bool
+objc_object::rootReleaseBatch_fast(size_t count)
+{
+    if (count > RC_HALF) return false;
+
+    isa_t oldisa = LoadExclusive(&isa().bits);
+    isa_t newisa;
+    do {
+        newisa = oldisa;
+        if (slowpath(!newisa.nonpointer)) {
+            ClearExclusive(&isa().bits);
+            return false;
+        }
+        if (slowpath(newisa.isDeallocating())) {
+            ClearExclusive(&isa().bits);
+            return true;
+        }
+        uintptr_t carry;
+        newisa.bits = subc(newisa.bits, RC_ONE * count, 0, &carry);  // extra_rc -= count
+        if (slowpath(carry  ||  newisa.isDeallocating())) {
+            // Underflow, or the last release: rootRelease() handles both.
+            ClearExclusive(&isa().bits);
+            return false;
+        }
+    } while (slowpath(!StoreReleaseExclusive(&isa().bits, &oldisa.bits, newisa.bits)));
+
+    return true;
+}
+
+
 // Slow path of clearDeallocating() 
 // for objects with nonpointer isa
 // that were ever weakly referenced 
@@ -1478,16 +1860,501 @@ objc_object::clearDeallocating_slow()
     ASSERT(isa().nonpointer  &&  (isa().weakly_referenced || isa().has_sidetable_rc));
 
     SideTable& table = SideTables()[this];
-    table.lock();
     if (isa().weakly_referenced) {
+        table.lockWeak();
         weak_clear_no_lock(&table.weak_table, (id)this);
+        table.waitForWeakReaders();
+        table.unlockWeak();
     }
     if (isa().has_sidetable_rc) {
+        table.lock();
         table.refcnts.erase(this);
+        table.unlock();
     }
-    table.unlock();
 }
 
+#if ISA_HAS_BIASED_RC
+
+/***********************************************************************
+* Biased retain counts
+* With OBJC_BIASED_RC, a new object with a nonpointer isa is biased
+* toward the thread that allocated it. isa.biased_rc is set and the
+* owner keeps its share of the retain count in a table of its own.
+* The owner's retains and releases update that table and leave the
+* isa alone, so an object that other threads also retain and release
+* does not move its isa's cache line back and forth with the owner's.
+* Other threads retain and release the shared count in extra_rc and
+* the side table as usual.
+*
+* The object's side table records the owner. A release on another
+* thread that finds a zero shared count takes the reference from the
+* owner's share instead, with a compare-and-swap under the locks.
+* While an object is biased its retain count is
+*     shared count + owner's share
+* so retainCount reads the owner's share under the locks, and the
+* thread whose release brings both to zero ends the bias and
+* deallocates the object at once, whichever thread that is.
+*
+* A bias ends when the owner's share drops to zero, when the owner
+* exits, and when object_dispose() frees the object. Ending it folds
+* the owner's share into the shared count in one isa update and
+* erases the owner's entry and the side table record.
+*
+* Classes with custom retain/release are never biased.
+*
+* Locking: the side table lock protects the owner record and the end
+* of the bias, and is taken before the owner's table lock. The owner's
+* table lock protects changes to its entries and other threads' use
+* of them. The owner finds its own entries without the lock.
+**********************************************************************/
+
+namespace {
+
+struct BiasedRCTable {
+    enum : uintptr_t { InitialCapacity = 64, Tombstone = 1 };
+
+    struct Entry {
+        // Changed while lock is held. The owner reads it without.
+        std::atomic<objc_object *> obj;
+        // The owner's share of the retain count.
+        std::atomic<uintptr_t> count;
+    };
+
+    BiasedRCTable *next;        // in biasedRCTables; never changes
+    std::atomic<bool> active;   // owned by a running thread
+    spinlock_t lock;
+    Entry *entries;
+    uintptr_t mask;
+    size_t used;
+    size_t tombstones;
+
+    static BiasedRCTable *create() {
+        auto *table = (BiasedRCTable *)calloc(1, sizeof(BiasedRCTable));
+        new (&table->lock) spinlock_t(fork_unsafe);
+        table->entries = (Entry *)calloc(InitialCapacity, sizeof(Entry));
+        table->mask = InitialCapacity - 1;
+        return table;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    size_t indexFor(objc_object *obj) const {
+        return ptr_hash((uintptr_t)obj) & mask;
+    }
+
+    // Called by the owner, or with lock held.
+    // The table always has an empty entry.
+    Entry *find(objc_object *obj) {
+        for (size_t i = indexFor(obj); ; i = (i + 1) & mask) {
+            objc_object *o = entries[i].obj.load(std::memory_order_relaxed);
+            if (o == obj) return &entries[i];
+            if (o == nil) return nil;
+        }
+    }
+
+    // Rebuild with newCapacity entries, dropping tombstones.
+    // Only the owner resizes, so no reader is using the old entries.
+    // Locking: lock must be held.
+    void resize(size_t newCapacity) {
+        Entry *oldEntries = entries;
+        size_t oldCapacity = capacity();
+        entries = (Entry *)calloc(newCapacity, sizeof(Entry));
+        mask = newCapacity - 1;
+        tombstones = 0;
+        for (size_t i = 0; i < oldCapacity; i++) {
+            objc_object *o = oldEntries[i].obj.load(std::memory_order_relaxed);
+            if (o == nil  ||  o == (objc_object *)Tombstone) continue;
+            size_t j = indexFor(o);
+            while (entries[j].obj.load(std::memory_order_relaxed)) {
+                j = (j + 1) & mask;
+            }
+            entries[j].obj.store(o, std::memory_order_relaxed);
+            entries[j].count.store(oldEntries[i].count.load(std::memory_order_relaxed),
+                                   std::memory_order_relaxed);
+        }
+        free(oldEntries);
+    }
+
+    // Called by the owner. Locking: lock must be held.
+    void insert(objc_object *obj) {
+        // Keep the table at most 3/4 full, tombstones included.
+        // Grow when live entries alone fill half of it.
+        if (used + tombstones + 1 > capacity() * 3 / 4) {
+            resize(used + 1 > capacity() / 2 ? capacity() * 2 : capacity());
+        }
+        size_t i = indexFor(obj);
+        objc_object *o;
+        while ((o = entries[i].obj.load(std::memory_order_relaxed))  &&
+               o != (objc_object *)Tombstone)
+        {
+            i = (i + 1) & mask;
+        }
+        if (o) tombstones--;
+        entries[i].count.store(1, std::memory_order_relaxed);
+        entries[i].obj.store(obj, std::memory_order_relaxed);
+        used++;
+    }
+
+    // Locking: lock must be held.
+    void erase(Entry *e) {
+        e->obj.store((objc_object *)Tombstone, std::memory_order_relaxed);
+        e->count.store(0, std::memory_order_relaxed);
+        used--;
+        tombstones++;
+    }
+
+    // Empty the table for the next thread to use it.
+    // Locking: lock must be held.
+    void reset() {
+        if (capacity() > InitialCapacity) {
+            free(entries);
+            entries = (Entry *)calloc(InitialCapacity, sizeof(Entry));
+            mask = InitialCapacity - 1;
+        } else {
+            bzero(entries, capacity() * sizeof(Entry));
+        }
+        used = 0;
+        tombstones = 0;
+    }
+};
+
+// The table of the current thread.
+static tls_fast(BiasedRCTable *) biasedRCTable;
+
+// Unbiases the current thread's objects when it exits.
+struct BiasedRCExit {
+    void operator()(BiasedRCTable *table) {
+        objc_object::biasedRCThreadExit(table);
+    }
+};
+static objc::ExplicitInit<tls(BiasedRCTable *, BiasedRCExit)> biasedRCExit;
+static bool biasedRCReady;
+
+// Every table ever allocated. Tables are not freed: a new thread
+// reuses the table of one that exited, so there are as many as the
+// most threads ever running at once.
+static std::atomic<BiasedRCTable *> biasedRCTables;
+
+// Returns a table for a new thread.
+static BiasedRCTable *claimBiasedRCTable()
+{
+    for (auto *table = biasedRCTables.load(std::memory_order_acquire);
+         table;
+         table = table->next)
+    {
+        bool active = false;
+        if (!table->active.load(std::memory_order_relaxed)  &&
+            table->active.compare_exchange_strong(active, true,
+                                                  std::memory_order_acquire,
+                                                  std::memory_order_relaxed))
+        {
+            return table;
+        }
+    }
+
+    auto *table = BiasedRCTable::create();
+    table->active.store(true, std::memory_order_relaxed);
+    table->next = biasedRCTables.load(std::memory_order_relaxed);
+    while (!biasedRCTables.compare_exchange_weak(table->next, table,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed))
+        ;
+    return table;
+}
+
+// Erase obj's owner record and the owner's entry for it.
+// Returns false if obj is not biased. Otherwise sets *ownerCount
+// to the owner's share, which the caller must fold into the
+// shared count or drop.
+// Locking: the object's side table lock must be held.
+static bool takeBiasedOwnerShare(SideTable& sideTable, objc_object *obj,
+                                 uintptr_t *ownerCount)
+{
+    auto it = sideTable.aux().biasedOwners.find(obj);
+    if (it == sideTable.aux().biasedOwners.end()) return false;
+    BiasedRCTable *owner = it->second;
+    sideTable.aux().biasedOwners.erase(it);
+
+    owner->lock.lock();
+    BiasedRCTable::Entry *e = owner->find(obj);
+    ASSERT(e);
+    *ownerCount = e->count.load(std::memory_order_acquire);
+    owner->erase(e);
+    owner->lock.unlock();
+    return true;
+}
+
+}
+
+
+// Called by arr_init().
+static void biasedRCInit()
+{
+    if (!BiasedRC) return;
+    biasedRCExit.init();
+    biasedRCReady = true;
+}
+
+
+// Bias a new object toward the current thread.
+// Returns false if the object should use the shared count only.
+bool
+objc_object::biasedRCAdopt()
+{
+    if (!biasedRCReady) return false;
+
+    BiasedRCTable *table = biasedRCTable;
+    if (slowpath(!table)) {
+        table = claimBiasedRCTable();
+        biasedRCTable = table;
+        biasedRCExit.get() = table;
+    }
+
+    table->lock.lock();
+    table->insert(this);
+    table->lock.unlock();
+
+    SideTable& sideTable = SideTables()[this];
+    sideTable.lock();
+    ASSERT(sideTable.aux().biasedOwners.find(this) == sideTable.aux().biasedOwners.end());
+    sideTable.aux().biasedOwners[this] = table;
+    sideTable.unlock();
+    return true;
+}
+
+
+// Retain on the owner thread.
+// Returns false if this thread does not own the object.
+bool
+objc_object::rootRetain_biased()
+{
+    BiasedRCTable *table = biasedRCTable;
+    if (!table) return false;
+    BiasedRCTable::Entry *e = table->find(this);
+    if (!e) return false;
+    // Other threads only take from the owner's share, and only
+    // while the owner's count includes their reference.
+    e->count.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+
+// Release on the owner thread.
+// Returns false if this thread does not own the object. Otherwise
+// sets *deallocated as rootRelease() would return it.
+bool
+objc_object::rootRelease_biased(bool performDealloc, bool *deallocated)
+{
+    BiasedRCTable *table = biasedRCTable;
+    if (!table) return false;
+    BiasedRCTable::Entry *e = table->find(this);
+    if (!e) return false;
+
+    if (fastpath(e->count.fetch_sub(1, std::memory_order_release) > 1)) {
+        *deallocated = false;
+        return true;
+    }
+
+    // The owner's share is gone. Hand the object to the shared count.
+    SideTable& sideTable = SideTables()[this];
+    sideTable.lock();
+    bool dealloc = rootUnbias_nolock();
+    sideTable.unlock();
+    if (dealloc  &&  performDealloc) this->performDealloc();
+    *deallocated = dealloc;
+    return true;
+}
+
+
+// Release on another thread that found a zero shared count.
+// Takes the reference from the owner's share, and deallocates the
+// object if that was the last one. Retries if the bias has ended.
+NEVER_INLINE bool
+objc_object::rootRelease_ownerShare(bool performDealloc)
+{
+    SideTable& sideTable = SideTables()[this];
+    sideTable.lock();
+    isa_t bits = __c11_atomic_load((_Atomic uintptr_t *)&isa().bits, __ATOMIC_RELAXED);
+    if (!bits.nonpointer  ||  !bits.biased_rc  ||
+        bits.extra_rc != 0  ||  bits.has_sidetable_rc)
+    {
+        sideTable.unlock();
+        // Retained again or unbiased in the meantime.
+        return rootRelease(performDealloc, RRVariant::Full);
+    }
+
+    auto it = sideTable.aux().biasedOwners.find(this);
+    ASSERT(it != sideTable.aux().biasedOwners.end());
+    BiasedRCTable *owner = it->second;
+    owner->lock.lock();
+    BiasedRCTable::Entry *e = owner->find(this);
+    ASSERT(e);
+    uintptr_t count = e->count.load(std::memory_order_relaxed);
+    do {
+        if (count == 0) {
+            // Released more than retained. This does nothing,
+            // as it does for a deallocating object.
+            owner->lock.unlock();
+            sideTable.unlock();
+            return false;
+        }
+    } while (!e->count.compare_exchange_weak(count, count - 1,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+    owner->lock.unlock();
+
+    bool dealloc = false;
+    if (count == 1) {
+        // That was the last reference, unless a weak load has
+        // retained the object since.
+        dealloc = rootUnbias_nolock();
+    }
+    sideTable.unlock();
+
+    if (dealloc  &&  performDealloc) this->performDealloc();
+    return dealloc;
+}
+
+
+// End the bias, folding the owner's share into the shared count.
+// Returns true if the retain count is now zero; the caller
+// deallocates the object after unlocking.
+// Does nothing if the object is not biased.
+// Locking: the object's side table lock must be held.
+bool
+objc_object::rootUnbias_nolock()
+{
+    SideTable& table = SideTables()[this];
+    uintptr_t ownerCount;
+    if (!takeBiasedOwnerShare(table, this, &ownerCount)) return false;
+
+    // Other threads may still update extra_rc without the lock,
+    // but the side table count only changes while the lock is held.
+    isa_t oldisa = LoadExclusive(&isa().bits);
+    isa_t newisa;
+    size_t excess;
+    do {
+        ASSERT(oldisa.nonpointer  &&  oldisa.biased_rc);
+        newisa = oldisa;
+        size_t total = oldisa.extra_rc + ownerCount;
+        if (oldisa.has_sidetable_rc) total += sidetable_getExtraRC_nolock();
+
+        newisa.biased_rc = 0;
+        if (total <= RC_HALF * 2 - 1) {
+            newisa.extra_rc = total;
+            newisa.has_sidetable_rc = false;
+            excess = 0;
+        } else {
+            newisa.extra_rc = RC_HALF;
+            newisa.has_sidetable_rc = true;
+            excess = total - RC_HALF;
+        }
+    } while (slowpath(!StoreReleaseExclusive(&isa().bits, &oldisa.bits, newisa.bits)));
+
+    if (oldisa.has_sidetable_rc) sidetable_clearExtraRC_nolock();
+    if (excess) sidetable_addExtraRC_nolock(excess);
+
+    if (!newisa.isDeallocating()) return false;
+
+    __c11_atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return true;
+}
+
+
+// object_setClass() to a class that requires a raw isa.
+// The side table cannot hold the owner's share, so end the bias first.
+// Only the owner may do this: its retains and releases do not wait
+// for the side table lock.
+void
+objc_object::unbiasForRawIsa(Class newCls)
+{
+    BiasedRCTable *table = biasedRCTable;
+    if (!table  ||  !table->find(this)) {
+        _objc_fatal("OBJC_BIASED_RC: cannot change object %p to class %s, "
+                    "which requires a raw isa, on a thread that does not "
+                    "own the object's retain count",
+                    this, newCls->nameForLogging());
+    }
+    SideTable& sideTable = SideTables()[this];
+    sideTable.lock();
+    // The caller holds a reference, so this does not deallocate.
+    rootUnbias_nolock();
+    sideTable.unlock();
+}
+
+
+// retainCount of a biased object. The side table lock is held.
+uintptr_t
+objc_object::biasedRetainCount_nolock(uintptr_t sharedCount)
+{
+    SideTable& sideTable = SideTables()[this];
+    auto it = sideTable.aux().biasedOwners.find(this);
+    if (it == sideTable.aux().biasedOwners.end()) return sharedCount;
+
+    BiasedRCTable *owner = it->second;
+    owner->lock.lock();
+    BiasedRCTable::Entry *e = owner->find(this);
+    ASSERT(e);
+    uintptr_t rc = sharedCount + e->count.load(std::memory_order_relaxed);
+    owner->lock.unlock();
+    return rc;
+}
+
+
+// Drop the bias of an object that is freed without being released,
+// so no thread's table keeps an entry for memory that may be reused.
+// Called by object_dispose().
+void
+objc_object::biasedRCDispose()
+{
+    isa_t bits = __c11_atomic_load((_Atomic uintptr_t *)&isa().bits, __ATOMIC_RELAXED);
+    if (fastpath(!bits.nonpointer  ||  !bits.biased_rc)) return;
+
+    SideTable& sideTable = SideTables()[this];
+    sideTable.lock();
+    uintptr_t ownerCount;
+    takeBiasedOwnerShare(sideTable, this, &ownerCount);
+    sideTable.unlock();
+}
+
+
+// Unbias all of an exiting thread's objects.
+void
+objc_object::biasedRCThreadExit(void *tablePtr)
+{
+    auto *table = (BiasedRCTable *)tablePtr;
+
+    // Deallocations below may allocate, retain, and release;
+    // keep them away from the table. Nothing resizes it now.
+    biasedRCTable = nil;
+    for (size_t i = 0; i < table->capacity(); i++) {
+        objc_object *obj = table->entries[i].obj.load(std::memory_order_relaxed);
+        if (obj == nil  ||  obj == (objc_object *)BiasedRCTable::Tombstone) {
+            continue;
+        }
+
+        // Another thread may have ended the bias since, and the
+        // memory may hold an object biased to some other thread.
+        SideTable& sideTable = SideTables()[obj];
+        sideTable.lock();
+        bool dealloc = false;
+        auto it = sideTable.aux().biasedOwners.find(obj);
+        if (it != sideTable.aux().biasedOwners.end()  &&  it->second == table) {
+            dealloc = obj->rootUnbias_nolock();
+        }
+        sideTable.unlock();
+        if (dealloc) obj->performDealloc();
+    }
+
+    table->lock.lock();
+    table->reset();
+    table->lock.unlock();
+    table->active.store(false, std::memory_order_release);
+}
+
+// ISA_HAS_BIASED_RC
+#endif
+
 #endif
 
 void moveTLSAutoreleaseToPool(ReturnAutoreleaseInfo info) {
@@ -1516,6 +2383,7 @@ objc_object::sidetable_present()
     bool result = false;
     SideTable& table = SideTables()[this];
 
+    table.lockWeak();
     table.lock();
 
     RefcountMap::iterator it = table.refcnts.find(this);
@@ -1524,6 +2392,7 @@ objc_object::sidetable_present()
     if (weak_is_registered_no_lock(&table.weak_table, (id)this)) result = true;
 
     table.unlock();
+    table.unlockWeak();
 
     return result;
 }
@@ -1683,6 +2552,8 @@ objc_object::sidetable_retain(bool locked)
 }
 
 
+// Takes and releases the refcount lock. Unlike sidetable_retain(),
+// it never takes over a lock the caller holds.
 bool
 objc_object::sidetable_tryRetain()
 {
@@ -1691,14 +2562,10 @@ objc_object::sidetable_tryRetain()
 #endif
     SideTable& table = SideTables()[this];
 
-    // NO SPINLOCK HERE
     // _objc_rootTryRetain() is called exclusively by _objc_loadWeak(), 
-    // which already acquired the lock on our behalf.
-
-    // fixme can't do this efficiently with os_lock_handoff_s
-    // if (table.slock == 0) {
-    //     _objc_fatal("Do not call -_tryRetain.");
-    // }
+    // which holds the weak lock. That keeps the object from finishing 
+    // deallocation, but the retain count itself needs the refcount lock.
+    table.lock();
 
     bool result = true;
     auto it = table.refcnts.try_emplace(this, SIDE_TABLE_RC_ONE);
@@ -1710,6 +2577,7 @@ objc_object::sidetable_tryRetain()
     } else if (! (refcnt & SIDE_TABLE_RC_PINNED)) {
         refcnt += SIDE_TABLE_RC_ONE;
     }
+    table.unlock();
     
     return result;
 }
@@ -1738,18 +2606,14 @@ objc_object::sidetable_isDeallocating()
 {
     SideTable& table = SideTables()[this];
 
-    // NO SPINLOCK HERE
-    // _objc_rootIsDeallocating() is called exclusively by _objc_storeWeak(), 
-    // which already acquired the lock on our behalf.
-
-
-    // fixme can't do this efficiently with os_lock_handoff_s
-    // if (table.slock == 0) {
-    //     _objc_fatal("Do not call -_isDeallocating.");
-    // }
-
+    // _objc_storeWeak() calls this with the weak lock held. 
+    // The deallocating bit lives with the retain count.
+    table.lock();
     RefcountMap::iterator it = table.refcnts.find(this);
-    return (it != table.refcnts.end()) && (it->second & SIDE_TABLE_DEALLOCATING);
+    bool result = (it != table.refcnts.end()) && 
+        (it->second & SIDE_TABLE_DEALLOCATING);
+    table.unlock();
+    return result;
 }
 
 
@@ -1781,15 +2645,18 @@ static_assert(!SUPPORT_NONPOINTER_ISA, "If weak callout is not present then we m
 #endif
 
 void 
-objc_object::sidetable_setWeaklyReferenced_nolock()
+objc_object::sidetable_setWeaklyReferenced()
 {
 #if SUPPORT_NONPOINTER_ISA
     ASSERT(!isa().nonpointer);
 #endif
   
     SideTable& table = SideTables()[this];
-  
+
+    // The caller holds the weak lock, not the refcount lock.
+    table.lock();
     table.refcnts[this] |= SIDE_TABLE_WEAKLY_REFERENCED;
+    table.unlock();
 }
 
 
@@ -1826,6 +2693,56 @@ objc_object::sidetable_release(bool locked, bool performDealloc)
 }
 
 
+void
+objc_object::sidetable_retainBatch_nolock(size_t count)
+{
+#if SUPPORT_NONPOINTER_ISA
+    ASSERT(!isa().nonpointer);
+#endif
+    SideTable& table = SideTables()[this];
+
+    size_t& refcntStorage = table.refcnts[this];
+    if (refcntStorage & SIDE_TABLE_RC_PINNED) return;
+
+    uintptr_t carry;
+    size_t refcnt =
+        addc(refcntStorage, count << SIDE_TABLE_RC_SHIFT, 0, &carry);
+    if (carry) {
+        refcntStorage =
+            SIDE_TABLE_RC_PINNED | (refcntStorage & SIDE_TABLE_FLAG_MASK);
+    } else {
+        refcntStorage = refcnt;
+    }
+}
+
+
+// Returns true if the object should now be deallocated.
+bool
+objc_object::sidetable_releaseBatch_nolock(size_t count)
+{
+#if SUPPORT_NONPOINTER_ISA
+    ASSERT(!isa().nonpointer);
+#endif
+    SideTable& table = SideTables()[this];
+
+    auto it = table.refcnts.try_emplace(this, SIDE_TABLE_DEALLOCATING);
+    auto &refcnt = it.first->second;
+    if (it.second) {
+        return true;
+    }
+    if (refcnt & (SIDE_TABLE_RC_PINNED | SIDE_TABLE_DEALLOCATING)) {
+        return false;
+    }
+    if ((refcnt >> SIDE_TABLE_RC_SHIFT) >= count) {
+        refcnt -= count << SIDE_TABLE_RC_SHIFT;
+        return false;
+    }
+    // SIDE_TABLE_WEAKLY_REFERENCED may be set. Don't change it.
+    refcnt = (refcnt & SIDE_TABLE_FLAG_MASK) | SIDE_TABLE_DEALLOCATING;
+    return true;
+}
+
+
 void 
 objc_object::sidetable_clearDeallocating()
 {
@@ -1834,6 +2751,9 @@ objc_object::sidetable_clearDeallocating()
     // clear any weak table items
     // clear extra retain count and deallocating bit
     // (fixme warn or abort if extra retain count == 0 ?)
+    // Lock-free weak loads skip raw isa objects, 
+    // so there are no readers to wait for.
+    table.lockWeak();
     table.lock();
     RefcountMap::iterator it = table.refcnts.find(this);
     if (it != table.refcnts.end()) {
@@ -1843,6 +2763,7 @@ objc_object::sidetable_clearDeallocating()
         table.refcnts.erase(it);
     }
     table.unlock();
+    table.unlockWeak();
 }
 
 
@@ -1904,6 +2825,210 @@ objc_retain_x0(id obj)
 
 #endif
 
+
+/***********************************************************************
+* objc_retainBatch / objc_releaseBatch
+* The objects are sorted by side table stripe and address. Duplicates
+* become adjacent, so an object that appears k times gets one inline
+* update of k. Objects with side-table retain counts are updated one
+* stripe at a time, with that stripe's lock taken once.
+* Objects with RR overrides get k ordinary -retain/-release messages,
+* with no side table lock held.
+* objc_releaseBatch deallocates after all other updates are done.
+**********************************************************************/
+namespace {
+struct BatchEntry {
+    SideTable *table;
+    objc_object *obj;
+};
+}
+
+enum { BATCH_STACK_ENTRIES = 64 };
+
+// Fills entries with the non-nil, non-tagged objects of objs, sorted.
+// Uses stackEntries if they fit; otherwise the result must be freed.
+static BatchEntry *
+sortBatch(id *objs, size_t count, BatchEntry *stackEntries, size_t *outCount)
+{
+    BatchEntry *entries = stackEntries;
+    if (count > BATCH_STACK_ENTRIES) {
+        entries = (BatchEntry *)malloc(count * sizeof(BatchEntry));
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        id obj = objs[i];
+        if (_objc_isTaggedPointerOrNil(obj)) continue;
+        entries[n++] = { &SideTables()[obj], obj };
+    }
+
+    std::sort(entries, entries + n, [](const BatchEntry &a, const BatchEntry &b) {
+        if (a.table != b.table) return a.table < b.table;
+        return a.obj < b.obj;
+    });
+
+    *outCount = n;
+    return entries;
+}
+
+void
+objc_object::retainBatch(id *objs, size_t count)
+{
+    BatchEntry stackEntries[BATCH_STACK_ENTRIES];
+    size_t n;
+    BatchEntry *entries = sortBatch(objs, count, stackEntries, &n);
+    SideTable *locked = nil;
+
+    for (size_t i = 0; i < n; ) {
+        objc_object *obj = entries[i].obj;
+        SideTable *table = entries[i].table;
+        size_t k = 1;
+        while (i + k < n  &&  entries[i + k].obj == obj) k++;
+        i += k;
+
+        if (slowpath(obj->ISA()->hasCustomRR())) {
+            if (locked) { locked->unlock(); locked = nil; }
+            while (k--) obj->retain();
+            continue;
+        }
+#if SUPPORT_NONPOINTER_ISA
+        if (fastpath(obj->isa().nonpointer)) {
+            // rootRetain may need the side table lock for overflow.
+            if (locked) { locked->unlock(); locked = nil; }
+            if (!obj->rootRetainBatch_fast(k)) {
+                while (k--) obj->rootRetain();
+            }
+            continue;
+        }
+#endif
+        if (obj->isClass()) continue;
+        if (locked != table) {
+            if (locked) locked->unlock();
+            table->lock();
+            locked = table;
+        }
+        obj->sidetable_retainBatch_nolock(k);
+    }
+
+    if (locked) locked->unlock();
+    if (entries != stackEntries) free(entries);
+}
+
+void
+objc_object::releaseBatch(id *objs, size_t count, bool deallocByClass)
+{
+    BatchEntry stackEntries[BATCH_STACK_ENTRIES];
+    size_t n;
+    BatchEntry *entries = sortBatch(objs, count, stackEntries, &n);
+    SideTable *locked = nil;
+    // Objects to deallocate are collected at the front of entries,
+    // behind the objects that have been processed.
+    size_t deadCount = 0;
+
+    for (size_t i = 0; i < n; ) {
+        objc_object *obj = entries[i].obj;
+        SideTable *table = entries[i].table;
+        size_t k = 1;
+        while (i + k < n  &&  entries[i + k].obj == obj) k++;
+        i += k;
+
+        if (slowpath(obj->ISA()->hasCustomRR())) {
+            if (locked) { locked->unlock(); locked = nil; }
+            while (k--) obj->release();
+            continue;
+        }
+#if SUPPORT_NONPOINTER_ISA
+        if (fastpath(obj->isa().nonpointer)) {
+            // rootRelease may need the side table lock for underflow.
+            if (locked) { locked->unlock(); locked = nil; }
+            if (!obj->rootReleaseBatch_fast(k)) {
+                while (k--) {
+                    if (obj->rootReleaseShouldDealloc()) {
+                        entries[deadCount++].obj = obj;
+                        break;
+                    }
+                }
+            }
+            continue;
+        }
+#endif
+        if (obj->isClass()) continue;
+        if (locked != table) {
+            if (locked) locked->unlock();
+            table->lock();
+            locked = table;
+        }
+        if (obj->sidetable_releaseBatch_nolock(k)) {
+            entries[deadCount++].obj = obj;
+        }
+    }
+
+    if (locked) locked->unlock();
+
+    if (deallocByClass) {
+        // Run each class's -dealloc back to back.
+        std::stable_sort(entries, entries + deadCount,
+                         [](const BatchEntry &a, const BatchEntry &b) {
+            return a.obj->ISA() < b.obj->ISA();
+        });
+    }
+    for (size_t i = 0; i < deadCount; i++) {
+        entries[i].obj->performDealloc();
+    }
+    if (entries != stackEntries) free(entries);
+}
+
+/***********************************************************************
+* objc_autoreleaseBatch
+* Runs of objects that take the default autorelease path are handed to
+* the pool in one call each. nil and tagged pointers are skipped, as are
+* deallocating objects and classes, as in rootAutorelease(). Objects
+* with RR overrides get an ordinary -autorelease message between runs,
+* so the pool holds the objects in batch order.
+**********************************************************************/
+void
+objc_object::autoreleaseBatch(id *objs, size_t count)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < count; i++) {
+        id obj = objs[i];
+        bool isTaggedOrNil = _objc_isTaggedPointerOrNil(obj);
+        bool hasCustomRR = !isTaggedOrNil  &&  obj->ISA()->hasCustomRR();
+        if (!isTaggedOrNil  &&  !hasCustomRR  &&
+            !obj->rootAutoreleaseSkipsPool()
+#if SUPPORT_NONPOINTER_ISA
+            &&  !obj->isClass()
+#endif
+            )
+        {
+            continue;
+        }
+
+        AutoreleasePoolPage::autoreleaseBatch(objs + start, i - start);
+        start = i + 1;
+        if (slowpath(hasCustomRR)) obj->autorelease();
+    }
+    AutoreleasePoolPage::autoreleaseBatch(objs + start, count - start);
+}
+
+void
+objc_retainBatch(id *objs, size_t count)
+{
+    objc_object::retainBatch(objs, count);
+}
+
+void
+objc_releaseBatch(id *objs, size_t count)
+{
+    objc_object::releaseBatch(objs, count);
+}
+
+void
+objc_autoreleaseBatch(id *objs, size_t count)
+{
+    objc_object::autoreleaseBatch(objs, count);
+}
+
 __attribute__((aligned(16), flatten, noinline))
 id
 objc_autorelease(id obj)
@@ -2159,6 +3284,7 @@ void
 objc_autoreleasePoolPop(void *ctxt)
 {
     AutoreleasePoolPage::pop(ctxt);
+    cache_t::threadQuiescent();
 }
 
 
@@ -2295,12 +3421,13 @@ static void *weakTableScan(void *) {
         tables.forEach([&](SideTable &table) {
             nanosleep(&sleepInterval, NULL);
 
-            table.lock();
+            table.lockWeak();
 
-            auto mask = table.weak_table.mask;
-            if (mask) {
+            // Empty, deleted, and already moved slots are zeroed.
+            auto scan = [](weak_entry_t *entries, uintptr_t mask) {
+                if (!entries) return;
                 for (uintptr_t i = 0; i <= mask; i++) {
-                    auto &entry = table.weak_table.weak_entries[i];
+                    auto &entry = entries[i];
                     auto *referrers = entry.out_of_line() ? entry.referrers : entry.inline_referrers;
                     uintptr_t count = entry.out_of_line() ? entry.mask + 1 : WEAK_INLINE_COUNT;
                     objc_object *referent = entry.referent;
@@ -2315,8 +3442,10 @@ static void *weakTableScan(void *) {
                             _objc_fatal("Weak reference at %p contains %p, should contain %p", referrer, currentValue, referent);
                     }
                 }
-            }
-            table.unlock();
+            };
+            scan(table.weak_table.weak_entries, table.weak_table.mask);
+            scan(table.weak_table.old_entries, table.weak_table.old_mask);
+            table.unlockWeak();
         });
     }
 }
@@ -2332,8 +3461,11 @@ static void startWeakTableScan() {
 
 void arr_init(void) 
 {
-    SideTablesMap.init();
+    SideTablesInit();
     _objc_associations_init();
+#if ISA_HAS_BIASED_RC
+    biasedRCInit();
+#endif
 
     if (DebugScanWeakTables)
         startWeakTableScan();
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2022 Apple Inc.  All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+/***********************************************************************
+* adaptive.h
+* Adaptive spin-then-block recursive lock, built on the threading
+* package's objc_lock_base_t
+**********************************************************************/
+
+#ifndef _OBJC_THREAD_ADAPTIVE_H
+#define _OBJC_THREAD_ADAPTIVE_H
+
+// .. objc_adaptive_recursive_lock_t ...................................
+
+// Busy-wait hint for one spin iteration.
+static inline void objc_spin_pause() {
+#if __arm64__ || __arm__
+    __builtin_arm_yield();
+#elif __x86_64__ || __i386__
+    __builtin_ia32_pause();
+#endif
+}
+
+// A recursive lock for short critical sections, such as @synchronized.
+// When the lock is held by another thread, lock() spins with exponential
+// backoff for up to SpinRounds rounds (about 2^SpinRounds pauses in
+// total) before blocking on the underlying lock, so a waiter does not
+// pay for a block and wakeup when the owner is about to unlock.
+//
+// A waiter more urgent than the owner does not spin. Spinning would
+// keep it on a CPU the owner may need, while blocking on the
+// underlying lock lends the owner the waiter's priority.
+//
+// Each lock keeps its own hold-time and spin-round histograms. They are
+// only written by the owner while it holds the lock, so updating them
+// needs no atomic read-modify-write.
+class objc_adaptive_recursive_lock_base_t : nocopy_t {
+public:
+    static constexpr unsigned SpinRounds = CONFIG_ADAPTIVE_LOCK_SPIN_ROUNDS;
+    static constexpr unsigned HoldBuckets = 32;
+
+    // hold[i] counts outermost holds that lasted [2^i, 2^(i+1)) ns;
+    // hold[0] also counts shorter ones. spin[i] counts contended
+    // acquisitions that got the lock after i+1 spin rounds; the last
+    // bucket counts those that blocked.
+    struct statistics {
+        uint64_t hold[HoldBuckets];
+        uint64_t spin[SpinRounds + 1];
+    };
+
+private:
+    objc_lock_base_t lock_;
+    std::atomic<objc_thread_t> owner_;
+    std::atomic<unsigned> ownerPriority_;
+    uint32_t count_;      // recursion depth of the owner
+    uint64_t lockedAt_;
+    std::atomic<uint32_t> hold_[HoldBuckets];
+    std::atomic<uint32_t> spin_[SpinRounds + 1];
+
+    // Called with the lock held, so a plain load and store will do.
+    static void bump(std::atomic<uint32_t>& bucket) {
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+    }
+
+    bool isOwner(objc_thread_t self) const {
+        return objc_thread_equal(owner_.load(std::memory_order_relaxed), self);
+    }
+
+    void acquired(objc_thread_t self, unsigned priority) {
+        owner_.store(self, std::memory_order_relaxed);
+        ownerPriority_.store(priority, std::memory_order_relaxed);
+        count_ = 1;
+        lockedAt_ = nanoseconds();
+    }
+
+    __attribute__((noinline))
+    void lockSlow(unsigned priority) {
+        unsigned round = 0;
+        if (priority <= ownerPriority_.load(std::memory_order_relaxed)) {
+            for (; round < SpinRounds; round++) {
+                for (unsigned i = 0; i < (1u << round); i++) objc_spin_pause();
+                if (lock_.tryLock()) break;
+            }
+        } else {
+            round = SpinRounds;
+        }
+        if (round == SpinRounds) lock_.lock();
+        bump(spin_[round]);
+    }
+
+public:
+    objc_adaptive_recursive_lock_base_t()
+        : owner_(objc_thread_t()), ownerPriority_(0), count_(0), lockedAt_(0)
+    {
+        resetStatistics();
+    }
+
+    void lock() {
+        objc_thread_t self = objc_thread_self();
+        if (isOwner(self)) {
+            count_++;
+            return;
+        }
+        unsigned priority = objc_thread_priority();
+        if (slowpath(!lock_.tryLock())) lockSlow(priority);
+        acquired(self, priority);
+    }
+
+    bool tryLock() {
+        objc_thread_t self = objc_thread_self();
+        if (isOwner(self)) {
+            count_++;
+            return true;
+        }
+        if (!lock_.tryLock()) return false;
+        acquired(self, objc_thread_priority());
+        return true;
+    }
+
+    void unlock() {
+        if (--count_ == 0) {
+            uint64_t ns = nanoseconds() - lockedAt_;
+            unsigned bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+            if (bucket >= HoldBuckets) bucket = HoldBuckets - 1;
+            bump(hold_[bucket]);
+            owner_.store(objc_thread_t(), std::memory_order_relaxed);
+            lock_.unlock();
+        }
+    }
+
+    bool tryUnlock() {
+        if (!isOwner(objc_thread_self())) return false;
+        unlock();
+        return true;
+    }
+
+    void reset() {
+        lock_.reset();
+        owner_.store(objc_thread_t(), std::memory_order_relaxed);
+        count_ = 0;
+    }
+
+    // Statistics, read without locking.
+    void getStatistics(statistics *out) const {
+        for (unsigned i = 0; i < HoldBuckets; i++) {
+            out->hold[i] = hold_[i].load(std::memory_order_relaxed);
+        }
+        for (unsigned i = 0; i <= SpinRounds; i++) {
+            out->spin[i] = spin_[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Start the statistics over, for a lock that is not held.
+    void resetStatistics() {
+        for (auto& bucket : hold_) bucket.store(0, std::memory_order_relaxed);
+        for (auto& bucket : spin_) bucket.store(0, std::memory_order_relaxed);
+    }
+};
+
+#endif // _OBJC_THREAD_ADAPTIVE_H
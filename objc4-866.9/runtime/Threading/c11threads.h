@@ -51,6 +51,11 @@ static inline objc_thread_t objc_thread_self()
     return thrd_current();
 }
 
+static inline unsigned objc_thread_priority()
+{
+    return 0;
+}
+
 // .. objc_tls .........................................................
 
 template <class T, typename Destructor>
@@ -30,6 +30,7 @@
 #define _OBJC_DARWINTHREADS_H
 
 #include <os/lock.h>
+#include <pthread/qos.h>
 
 // Much of the implementation is inherited from the pthreads one
 #define _OBJC_PTHREAD_IS_DARWIN    1
@@ -68,6 +69,12 @@ static inline objc_thread_t objc_thread_self()
     return (pthread_t)_pthread_getspecific_direct(_PTHREAD_TSD_SLOT_PTHREAD_SELF);
 }
 
+// The current thread's QoS class. Higher values are more urgent.
+static inline unsigned objc_thread_priority()
+{
+    return qos_class_self();
+}
+
 // .. objc_tls_direct ..................................................
 
 template <class T, tls_key Key, typename Destructor>
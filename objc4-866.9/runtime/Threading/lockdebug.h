@@ -38,6 +38,8 @@
 #   endif
 #endif
 
+class objc_adaptive_recursive_lock_base_t;
+
 namespace lockdebug {
 
     // Internal functions
@@ -51,6 +53,10 @@ namespace lockdebug {
         void lock(objc_recursive_lock_base_t *lock);
         void unlock(objc_recursive_lock_base_t *lock);
 
+        void remember(objc_adaptive_recursive_lock_base_t *lock);
+        void lock(objc_adaptive_recursive_lock_base_t *lock);
+        void unlock(objc_adaptive_recursive_lock_base_t *lock);
+
         void remember(objc_monitor_base_t *monitor);
         void enter(objc_monitor_base_t *monitor);
         void leave(objc_monitor_base_t *monitor);
@@ -151,6 +157,9 @@ namespace lockdebug {
     void assert_locked(objc_recursive_lock_base_t *lock);
     void assert_unlocked(objc_recursive_lock_base_t *lock);
 
+    void assert_locked(objc_adaptive_recursive_lock_base_t *lock);
+    void assert_unlocked(objc_adaptive_recursive_lock_base_t *lock);
+
     void assert_locked(objc_monitor_base_t *monitor);
     void assert_unlocked(objc_monitor_base_t *monitor);
 
@@ -167,6 +176,9 @@ namespace lockdebug {
     static inline void assert_locked(objc_recursive_lock_base_t *) {}
     static inline void assert_unlocked(objc_recursive_lock_base_t *) {}
 
+    static inline void assert_locked(objc_adaptive_recursive_lock_base_t *) {}
+    static inline void assert_unlocked(objc_adaptive_recursive_lock_base_t *) {}
+
     static inline void assert_locked(objc_monitor_base_t *) {}
     static inline void assert_unlocked(objc_monitor_base_t *) {}
 
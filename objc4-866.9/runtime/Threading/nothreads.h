@@ -52,6 +52,11 @@ static inline objc_thread_t objc_thread_self()
     return nullptr;
 }
 
+static inline unsigned objc_thread_priority()
+{
+    return 0;
+}
+
 // .. objc_tls .........................................................
 
 template <class T, typename Destructor>
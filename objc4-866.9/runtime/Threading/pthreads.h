@@ -52,6 +52,11 @@ static inline objc_thread_t objc_thread_self()
 {
     return pthread_self();
 }
+
+static inline unsigned objc_thread_priority()
+{
+    return 0;
+}
 #endif
 
 // .. objc_tls .........................................................
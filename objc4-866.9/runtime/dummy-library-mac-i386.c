@@ -76,6 +76,9 @@ void _objc_atfork_parent(void) {}
 void _objc_atfork_prepare(void) {}
 void _objc_autoreleasePoolPop(void) {}
 void _objc_autoreleasePoolPrint(void) {}
+void _objc_cacheQuiescentState(void) {}
+void _objc_cacheThreadOffline(void) {}
+void _objc_cacheThreadOnline(void) {}
 void _objc_autoreleasePoolPush(void) {}
 void _objc_deallocOnMainThreadHelper(void) {}
 const char _objc_debug_class_hash;
@@ -83,6 +86,9 @@ const char _objc_empty_cache;
 void _objc_error(void) {}
 void _objc_flush_caches(void) {}
 void _objc_getFreedObjectClass(void) {}
+void _objc_getLazyCategoryStatistics(void) {}
+void _objc_getSyncLockHistograms(void) {}
+void _objc_getZoneStatistics(void) {}
 void _objc_init(void) {}
 void _objc_msgForward(void) {}
 void _objc_msgForward_stret(void) {}
@@ -193,6 +199,7 @@ void objc_atomicCompareAndSwapInstanceVariableBarrier(void) {}
 void objc_atomicCompareAndSwapPtr(void) {}
 void objc_atomicCompareAndSwapPtrBarrier(void) {}
 void objc_autorelease(void) {}
+void objc_autoreleaseBatch(void) {}
 void objc_autoreleasePoolPop(void) {}
 void objc_autoreleasePoolPush(void) {}
 void objc_autoreleaseReturnValue(void) {}
@@ -273,11 +280,13 @@ void objc_registerClassPair(void) {}
 void objc_registerProtocol(void) {}
 void objc_registerThreadWithCollector(void) {}
 void objc_release(void) {}
+void objc_releaseBatch(void) {}
 void objc_removeAssociatedObjects(void) {}
 void objc_retain(void) {}
 void objc_retainAutorelease(void) {}
 void objc_retainAutoreleaseReturnValue(void) {}
 void objc_retainAutoreleasedReturnValue(void) {}
+void objc_retainBatch(void) {}
 void objc_retainBlock(void) {}
 void objc_retain_autorelease(void) {}
 void objc_retainedObject(void) {}
@@ -352,5 +361,7 @@ void sel_registerName(void) {}
 void objc_cache_buckets(void) {}
 void objc_cache_bytesForCapacity(void) {}
 void objc_cache_capacity(void) {}
+void objc_cache_lookup(void) {}
 void objc_cache_occupied(void) {}
+void _class_getCache(void) {}
 void objc_copyClassesForImage(void) {}
@@ -48,6 +48,8 @@
     // shiftcls must occupy the same bits that a real class pointer would
     // bits + RC_ONE is equivalent to extra_rc + 1
     // RC_HALF is the high bit of extra_rc (i.e. half of its range)
+    // biased_rc means the allocating thread holds part of the retain count
+    //   outside the isa (see OBJC_BIASED_RC in NSObject.mm)
 
     // future expansion:
     // uintptr_t fast_rr : 1;     // no r/r overrides
@@ -86,10 +88,12 @@
         uintptr_t shiftcls          : 33; /*MACH_VM_MAX_ADDRESS 0x1000000000*/ \
         uintptr_t magic             : 6;                                       \
         uintptr_t weakly_referenced : 1;                                       \
-        uintptr_t unused            : 1;                                       \
+        uintptr_t biased_rc         : 1;                                       \
         uintptr_t has_sidetable_rc  : 1;                                       \
         uintptr_t extra_rc          : 19
 #     define ISA_HAS_INLINE_RC    1
+#     define ISA_HAS_BIASED_RC    1
+#     define ISA_BIASED_RC_BIT    43
 #     define RC_HAS_SIDETABLE_BIT 44
 #     define RC_ONE_BIT           (RC_HAS_SIDETABLE_BIT+1)
 #     define RC_ONE               (1ULL<<RC_ONE_BIT)
@@ -116,10 +120,12 @@
       uintptr_t shiftcls          : 44; /*MACH_VM_MAX_ADDRESS 0x7fffffe00000*/ \
       uintptr_t magic             : 6;                                         \
       uintptr_t weakly_referenced : 1;                                         \
-      uintptr_t unused            : 1;                                         \
+      uintptr_t biased_rc         : 1;                                         \
       uintptr_t has_sidetable_rc  : 1;                                         \
       uintptr_t extra_rc          : 8
 #   define ISA_HAS_INLINE_RC    1
+#   define ISA_HAS_BIASED_RC    1
+#   define ISA_BIASED_RC_BIT    54
 #   define RC_HAS_SIDETABLE_BIT 55
 #   define RC_ONE_BIT           (RC_HAS_SIDETABLE_BIT+1)
 #   define RC_ONE               (1ULL<<RC_ONE_BIT)
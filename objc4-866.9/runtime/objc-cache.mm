@@ -153,6 +153,11 @@ enum {
     MAX_CACHE_SIZE       = (1 << MAX_CACHE_SIZE_LOG2),
     FULL_UTILIZATION_CACHE_SIZE_LOG2 = 3,
     FULL_UTILIZATION_CACHE_SIZE = (1 << FULL_UTILIZATION_CACHE_SIZE_LOG2),
+#if CACHE_ROBIN_HOOD
+    // Inserts that would probe this many buckets or more rebuild the
+    // cache in Robin-Hood order, if that would place them closer.
+    ROBIN_HOOD_PROBE_LIMIT = 4,
+#endif
 };
 
 static int _collecting_in_critical(void);
@@ -195,6 +200,157 @@ static void recordDeadCache(mask_t capacity)
     }
 }
 
+
+/***********************************************************************
+* Cache sync points
+* cacheSyncPoint() returns a token for "now". cacheSyncedSince(token)
+* is true once every cache reader that was running at that point has
+* finished, as proven by a later garbage collection.
+**********************************************************************/
+
+// Number of collections that found no cache readers in progress.
+static uintptr_t cacheSyncCount;
+
+#if CONFIG_CACHE_EPOCHS
+// Quiescent-state epochs. See "Epoch-based cache reclamation" below.
+static std::atomic<uintptr_t> cacheEpoch{1};
+// Every thread has passed a quiescent state in this epoch.
+static uintptr_t cacheSafeEpoch;
+#endif
+
+static uintptr_t cacheSyncPoint()
+{
+#if CONFIG_CACHE_EPOCHS
+    return cacheEpoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+#else
+    return cacheSyncCount;
+#endif
+}
+
+static bool cacheSyncedSince(uintptr_t point)
+{
+#if CONFIG_CACHE_EPOCHS
+    return cacheSafeEpoch >= point;
+#else
+    return cacheSyncCount != point;
+#endif
+}
+
+
+/***********************************************************************
+* Adaptive cache sizing for OBJC_ADAPTIVE_CACHES
+* Caches normally only grow. With adaptive sizing, eraseNolock() shrinks
+* a cache to fit the entries it held before it was erased.
+*
+* objc_msgSend may still be using the old, larger mask, so the erased
+* cache keeps the old shared empty buckets with the new mask. Smaller
+* buckets are only allocated once collectNolock() has seen no cache
+* readers since the shrink. Until then the cache refills at its old size.
+*
+* Fills (cache misses) and the collisions they probe past are counted
+* per class in cache_t::insert, which is already off the fast path.
+* Hits are taken in objc_msgSend and are not counted.
+**********************************************************************/
+struct cache_stats_t {
+    uint32_t fills;             // fills since the last erase
+    uint32_t collisions;        // occupied buckets those fills skipped
+    uint32_t shrinkFrom;        // capacity before a pending shrink, or 0
+    uint32_t fillsBeforeShrink; // fills in the generation that shrank
+    uintptr_t shrinkSync;       // cacheSyncPoint() when the shrink was made
+    bool measuring;             // shrank; compare fills at the next erase
+};
+
+static objc::LazyInitDenseMap<Class, cache_stats_t> cacheStats;
+
+static size_t adaptive_shrinks;
+static size_t adaptive_bytes_saved;
+static size_t adaptive_fills_before;
+static size_t adaptive_fills_after;
+
+static void recordFill(Class cls, mask_t collisions)
+{
+    auto &stats = (*cacheStats.get(true))[cls];
+    stats.fills++;
+    stats.collisions += collisions;
+}
+
+// The smallest capacity that holds occupied entries without growing.
+static mask_t capacityToFit(mask_t occupied)
+{
+    mask_t capacity = INIT_CACHE_SIZE;
+    while (capacity < MAX_CACHE_SIZE  &&
+           occupied + 1 + CACHE_END_MARKER > cache_fill_ratio(capacity))
+    {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+// Returns the capacity an erased cache should advertise from now on.
+static mask_t adaptiveCapacityForErase(Class cls, mask_t occupied, mask_t capacity)
+{
+    auto &stats = (*cacheStats.get(true))[cls];
+
+    if (stats.measuring) {
+        adaptive_fills_before += stats.fillsBeforeShrink;
+        adaptive_fills_after += stats.fills;
+        stats.measuring = false;
+    }
+
+    // Don't squeeze a cache whose fills already collide a lot.
+    mask_t target = capacity;
+    if (stats.collisions <= stats.fills) {
+        target = capacityToFit(occupied);
+    }
+
+    if (target < capacity) {
+        stats.shrinkFrom = capacity;
+        stats.shrinkSync = cacheSyncPoint();
+        stats.fillsBeforeShrink = stats.fills;
+    } else {
+        target = capacity;
+    }
+
+    stats.fills = 0;
+    stats.collisions = 0;
+    return target;
+}
+
+// Returns the capacity an empty cache should be refilled at.
+static mask_t adaptiveCapacityForRefill(Class cls, mask_t capacity)
+{
+    auto *map = cacheStats.get(false);
+    if (!map) return capacity;
+
+    auto it = map->find(cls);
+    if (it == map->end()  ||  !it->second.shrinkFrom) return capacity;
+
+    auto &stats = it->second;
+    if (!cacheSyncedSince(stats.shrinkSync)) {
+        // Readers may still hold the old mask. Undo the shrink.
+        capacity = stats.shrinkFrom;
+    } else {
+        adaptive_shrinks++;
+        adaptive_bytes_saved += cache_t::bytesForCapacity(stats.shrinkFrom) -
+                                cache_t::bytesForCapacity(capacity);
+        stats.measuring = true;
+        if (PrintCaches) {
+            _objc_inform("CACHES: %sclass %s: shrinking cache from %u to %u slots",
+                         cls->isMetaClass() ? "meta" : "",
+                         cls->nameForLogging(), stats.shrinkFrom, capacity);
+        }
+    }
+    stats.shrinkFrom = 0;
+    return capacity;
+}
+
+static void forgetCacheStats(Class cls)
+{
+    if (auto *map = cacheStats.get(false)) {
+        map->erase(cls);
+    }
+}
+
 /***********************************************************************
 * Pointers used by compiled class objects
 * These use asm to avoid conflicts with the compiler's internal declarations
@@ -237,14 +393,21 @@ __attribute__((used, section("__DATA_CONST,__objc_scoffs")))
 const uintptr_t objc_opt_offsets[__OBJC_OPT_OFFSETS_COUNT] = {0};
 #endif
 
+// cache_distance() is the number of cache_next() steps from home to i.
 #if CACHE_END_MARKER
 static inline mask_t cache_next(mask_t i, mask_t mask) {
     return (i+1) & mask;
 }
+static inline mask_t cache_distance(mask_t home, mask_t i, mask_t mask) {
+    return (i - home) & mask;
+}
 #elif __arm64__
 static inline mask_t cache_next(mask_t i, mask_t mask) {
     return i ? i-1 : mask;
 }
+static inline mask_t cache_distance(mask_t home, mask_t i, mask_t mask) {
+    return (home - i) & mask;
+}
 #else
 #error unexpected configuration
 #endif
@@ -334,6 +497,18 @@ void bucket_t::set(bucket_t *base, SEL newSel, IMP newImp, Class cls)
     stp(encodedImp, (uintptr_t)newSel, this);
 }
 
+// Swap this bucket's entry with imp/sel, both encoded for these buckets.
+// Observers see either entry, never a mix of the two.
+// Cache locks: cacheUpdateLock must be held by the caller.
+void bucket_t::exchange(uintptr_t &imp, SEL &sel)
+{
+    uintptr_t oldImp, oldSel;
+    ldp(oldImp, oldSel, this);
+    stp(imp, (uintptr_t)sel, this);
+    imp = oldImp;
+    sel = (SEL)oldSel;
+}
+
 #else
 
 template<Atomicity atomicity, IMPEncoding impEncoding>
@@ -648,6 +823,11 @@ void cache_t::incrementOccupied()
     _occupied++;
 }
 
+void cache_t::addOccupied(mask_t count)
+{
+    _occupied += count;
+}
+
 unsigned cache_t::capacity() const
 {
     return mask() ? mask()+1 : 0; 
@@ -708,6 +888,10 @@ struct bucket_t *cache_t::emptyBuckets()
     return (bucket_t *)((uintptr_t)&_objc_empty_cache & bucketsMask);
 }
 
+// Shared empty buckets too big for _objc_empty_cache, indexed by log2(capacity).
+static bucket_t **emptyBucketsList = nil;
+static mask_t emptyBucketsListCount = 0;
+
 bucket_t *cache_t::emptyBucketsForCapacity(mask_t capacity, bool allocate)
 {
 #if CONFIG_USE_CACHE_LOCK
@@ -724,9 +908,6 @@ bucket_t *cache_t::emptyBucketsForCapacity(mask_t capacity, bool allocate)
     }
 
     // Use shared empty buckets allocated on the heap.
-    static bucket_t **emptyBucketsList = nil;
-    static mask_t emptyBucketsListCount = 0;
-    
     mask_t index = log2u(capacity);
 
     if (index >= emptyBucketsListCount) {
@@ -752,11 +933,23 @@ bucket_t *cache_t::emptyBucketsForCapacity(mask_t capacity, bool allocate)
     return emptyBucketsList[index];
 }
 
+// With OBJC_ADAPTIVE_CACHES, a shrunk cache may still use
+// the shared empty buckets of a larger capacity.
+static bool isSharedEmptyBuckets(bucket_t *b, bucket_t *emptyBuckets)
+{
+    if (b == emptyBuckets) return true;
+    for (mask_t i = 0; i < emptyBucketsListCount; i++) {
+        if (b == emptyBucketsList[i]) return true;
+    }
+    return false;
+}
+
 bool cache_t::isConstantEmptyCache() const
 {
     return
         occupied() == 0  &&
-        buckets() == emptyBucketsForCapacity(capacity(), false);
+        (buckets() == emptyBucketsForCapacity(capacity(), false)  ||
+         (slowpath(AdaptiveCaches)  &&  isSharedEmptyBuckets(buckets(), emptyBuckets())));
 }
 
 bool cache_t::canBeFreed() const
@@ -858,6 +1051,9 @@ void cache_t::insert(SEL sel, IMP imp, id receiver)
     if (slowpath(isConstantEmptyCache())) {
         // Cache is read-only. Replace it.
         if (!capacity) capacity = INIT_CACHE_SIZE;
+        if (slowpath(AdaptiveCaches)) {
+            capacity = adaptiveCapacityForRefill(cls(), capacity);
+        }
         reallocate(oldCapacity, capacity, /* freeOld */false);
     }
     else if (fastpath(newOccupied + CACHE_END_MARKER <= cache_fill_ratio(capacity))) {
@@ -880,13 +1076,25 @@ void cache_t::insert(SEL sel, IMP imp, id receiver)
     mask_t m = capacity - 1;
     mask_t begin = cache_hash(sel, m);
     mask_t i = begin;
+    mask_t collisions = 0;
+#if CACHE_ROBIN_HOOD
+    bool canDisplace = false;
+#endif
 
     // Scan for the first unused slot and insert there.
     // There is guaranteed to be an empty slot.
     do {
         if (fastpath(b[i].sel() == 0)) {
+#if CACHE_ROBIN_HOOD
+            if (slowpath(canDisplace  &&  collisions >= ROBIN_HOOD_PROBE_LIMIT)) {
+                insertRobinHood(capacity, sel, imp);
+                if (slowpath(AdaptiveCaches)) recordFill(cls(), collisions);
+                return;
+            }
+#endif
             incrementOccupied();
             b[i].set<Atomic, Encoded>(b, sel, imp, cls());
+            if (slowpath(AdaptiveCaches)) recordFill(cls(), collisions);
             return;
         }
         if (b[i].sel() == sel) {
@@ -894,12 +1102,168 @@ void cache_t::insert(SEL sel, IMP imp, id receiver)
             // before we grabbed the cacheUpdateLock.
             return;
         }
+#if CACHE_ROBIN_HOOD
+        // Robin-Hood order would put sel here, ahead of an entry
+        // that is closer to its own home bucket.
+        if (slowpath(RobinHoodCaches)  &&  !canDisplace  &&
+            b[i].sel() != (SEL)(uintptr_t)1  &&
+            cache_distance(cache_hash(b[i].sel(), m), i, m) < collisions)
+        {
+            canDisplace = true;
+        }
+#endif
+        collisions++;
     } while (fastpath((i = cache_next(i, m)) != begin));
 
     bad_cache(receiver, (SEL)sel);
 #endif // !DEBUG_TASK_THREADS
 }
 
+#if CACHE_ROBIN_HOOD
+static size_t robin_hood_reorders;
+
+/***********************************************************************
+* cache_t::insertRobinHood
+* Insert sel/imp, which is not in the cache, in Robin-Hood order: an
+* entry may take the bucket of one that is closer to its own home
+* bucket. This bounds the longest probe in a dense cache. It does not
+* change the average probe, and objc_msgSend still scans linearly.
+*
+* On arm64 a bucket is written with one STP, so entries move in place.
+* A moving entry is briefly in no bucket, and a lock-free reader that
+* misses it takes the slow path. Elsewhere a bucket's SEL and IMP are
+* separate stores, so the buckets are never rewritten: they are copied
+* in Robin-Hood order and the old ones go to the garbage.
+* Cache locks: cacheUpdateLock must be held by the caller.
+**********************************************************************/
+#if __arm64__
+
+void cache_t::insertRobinHood(mask_t capacity, SEL sel, IMP imp)
+{
+    static_assert(!CACHE_END_MARKER, "arm64 method caches have no end marker");
+
+    bucket_t *b = buckets();
+    mask_t m = capacity - 1;
+    uintptr_t carryImp = b->encodedImpFor(b, sel, imp, cls());
+    SEL carrySel = sel;
+
+    // There is guaranteed to be an empty bucket.
+    mask_t i = cache_hash(carrySel, m);
+    mask_t distance = 0;
+    while (b[i].sel()) {
+        mask_t other = cache_distance(cache_hash(b[i].sel(), m), i, m);
+        if (other < distance) {
+            b[i].exchange(carryImp, carrySel);
+            distance = other;
+        }
+        i = cache_next(i, m);
+        distance++;
+    }
+    b[i].exchange(carryImp, carrySel);
+    incrementOccupied();
+
+    robin_hood_reorders++;
+}
+
+#else
+
+void cache_t::insertRobinHood(mask_t capacity, SEL sel, IMP imp)
+{
+    struct entry_t { SEL sel; IMP imp; };
+    static const SEL endMarkerSel = (SEL)(uintptr_t)1;
+
+    bucket_t *oldBuckets = buckets();
+    mask_t m = capacity - 1;
+    entry_t *entries = (entry_t *)calloc(capacity, sizeof(entry_t));
+#if CACHE_END_MARKER
+    entries[capacity - 1].sel = endMarkerSel;
+#endif
+
+    auto place = [&](entry_t e) {
+        mask_t i = cache_hash(e.sel, m);
+        mask_t distance = 0;
+        while (entries[i].sel) {
+            if (entries[i].sel != endMarkerSel) {
+                mask_t other = cache_distance(cache_hash(entries[i].sel, m), i, m);
+                if (other < distance) {
+                    std::swap(entries[i], e);
+                    distance = other;
+                }
+            }
+            i = cache_next(i, m);
+            distance++;
+        }
+        entries[i] = e;
+    };
+
+    for (mask_t i = 0; i < capacity; i++) {
+        SEL s = oldBuckets[i].sel();
+        if (s  &&  s != endMarkerSel) {
+            place({s, oldBuckets[i].imp(oldBuckets, cls())});
+        }
+    }
+    place({sel, imp});
+
+    bucket_t *newBuckets = allocateBuckets(capacity);
+    mask_t count = 0;
+    for (mask_t i = 0; i < capacity; i++) {
+        if (entries[i].sel  &&  entries[i].sel != endMarkerSel) {
+            newBuckets[i].set<NotAtomic, Encoded>(newBuckets, entries[i].sel,
+                                                  entries[i].imp, cls());
+            count++;
+        }
+    }
+    free(entries);
+
+    setBucketsAndMask(newBuckets, m); // also clears occupied
+    addOccupied(count);
+    collect_free(oldBuckets, capacity);
+
+    robin_hood_reorders++;
+}
+
+#endif
+#endif
+
+
+/***********************************************************************
+* cache_t::lookup
+* Portable version of the cache scan in objc_msgSend and cache_getImp.
+* Returns the cached IMP for sel, or nil if it is not cached.
+* outProbes, if set, receives the number of buckets examined.
+* This is a reference for tests and benchmarks of the bucket layout;
+* the runtime itself uses the assembly versions. Preoptimized caches
+* are not searched.
+* Cache locks: none. Unlike objc_msgSend this is not protected from
+* the garbage collector, so the caller must keep the buckets alive.
+**********************************************************************/
+IMP cache_t::lookup(SEL sel, mask_t *outProbes) const
+{
+    if (outProbes) *outProbes = 0;
+    if (isConstantOptimizedCache(/*strict*/true)) return nil;
+
+    // Read the mask before the buckets, as objc_msgSend does.
+    mask_t m = mask();
+    bucket_t *b = buckets();
+    if (!m) return nil;
+
+    mask_t begin = cache_hash(sel, m);
+    mask_t i = begin;
+    mask_t probes = 0;
+    do {
+        probes++;
+        SEL s = b[i].sel();
+        if (s == sel) {
+            if (outProbes) *outProbes = probes;
+            return b[i].imp(b, cls());
+        }
+        if (s == 0) break;
+    } while ((i = cache_next(i, m)) != begin);
+
+    if (outProbes) *outProbes = probes;
+    return nil;
+}
+
 void cache_t::copyCacheNolock(objc_imp_cache_entry *buffer, int len)
 {
 #if CONFIG_USE_CACHE_LOCK
@@ -942,7 +1306,8 @@ void cache_t::copyCacheNolock(objc_imp_cache_entry *buffer, int len)
 }
 
 // Reset this entire cache to the uncached lookup by reallocating it.
-// This must not shrink the cache - that breaks the lock-free scheme.
+// This must not shrink the buckets - that breaks the lock-free scheme.
+// OBJC_ADAPTIVE_CACHES may shrink the mask over the old empty buckets.
 void cache_t::eraseNolock(const char *func)
 {
 #if CONFIG_USE_CACHE_LOCK
@@ -964,8 +1329,13 @@ void cache_t::eraseNolock(const char *func)
         auto capacity = this->capacity();
         auto oldBuckets = buckets();
         auto buckets = emptyBucketsForCapacity(capacity);
+        auto newCapacity = capacity;
 
-        setBucketsAndMask(buckets, capacity - 1); // also clears occupied
+        if (slowpath(AdaptiveCaches)) {
+            newCapacity = adaptiveCapacityForErase(cls(), occupied(), capacity);
+        }
+
+        setBucketsAndMask(buckets, newCapacity - 1); // also clears occupied
         collect_free(oldBuckets, capacity);
     }
 }
@@ -982,6 +1352,7 @@ void cache_t::destroy()
         if (PrintCaches) recordDeadCache(capacity());
         free(buckets());
     }
+    if (slowpath(AdaptiveCaches)) forgetCacheStats(cls());
 }
 
 
@@ -1211,12 +1582,9 @@ enum {
 
 static void _garbage_make_room(void)
 {
-    static int first = 1;
-
     // Create the collection table the first time it is needed
-    if (first)
+    if (!garbage_refs)
     {
-        first = 0;
         garbage_refs = (bucket_t**)
             malloc(INIT_GARBAGE_COUNT * sizeof(void *));
         garbage_max = INIT_GARBAGE_COUNT;
@@ -1257,73 +1625,37 @@ void cache_t::collect_free(bucket_t *data, mask_t capacity)
 
 
 /***********************************************************************
-* cache_collect.  Try to free accumulated dead caches.
-* collectALot tries harder to free memory.
+* disposeGarbage.  Free dead caches that no reader can be using.
 * Cache locks: cacheUpdateLock must be held by the caller.
 **********************************************************************/
-void cache_t::collectNolock(bool collectALot)
+static void disposeGarbage(bucket_t **refs, size_t count, size_t bytes)
 {
-#if CONFIG_USE_CACHE_LOCK
-    lockdebug::assert_locked(&cacheUpdateLock);
-#else
-    lockdebug::assert_locked(&runtimeLock);
-#endif
-
-    // Done if the garbage is not full
-    if (garbage_byte_size < garbage_threshold  &&  !collectALot) {
-        return;
-    }
-
-    // Synchronize collection with objc_msgSend and other cache readers
-    if (!collectALot) {
-        if (_collecting_in_critical ()) {
-            // objc_msgSend (or other cache reader) is currently looking in
-            // the cache and might still be using some garbage.
-            if (PrintCaches) {
-                _objc_inform ("CACHES: not collecting; "
-                              "objc_msgSend in progress");
-            }
-            return;
-        }
-    } 
-    else {
-        // No excuses.
-        while (_collecting_in_critical()) 
-            ;
-    }
-
-    // No cache readers in progress - garbage is now deletable
-
     // Log our progress
     if (PrintCaches) {
         cache_collections++;
-        _objc_inform ("CACHES: COLLECTING %zu bytes (%zu allocations, %zu collections)", garbage_byte_size, cache_allocations, cache_collections);
+        _objc_inform ("CACHES: COLLECTING %zu bytes (%zu allocations, %zu collections)", bytes, cache_allocations, cache_collections);
     }
     
     if (DebugScribbleCaches) {
         // The most recently added garbage is at the end. Scribble
         // those first to maximize the chances of hitting a race.
-        size_t count = garbage_count;
-        while (count--) {
-            bucket_t *ptr = garbage_refs[count];
+        size_t i = count;
+        while (i--) {
+            bucket_t *ptr = refs[i];
             size_t bucketCount = malloc_size(ptr) / sizeof(bucket_t);
-            for (size_t i = 0; i < bucketCount; i++)
-                ptr[i].scribbleIMP((uintptr_t)ptr);
+            for (size_t j = 0; j < bucketCount; j++)
+                ptr[j].scribbleIMP((uintptr_t)ptr);
 
         }
     }
 
     // Dispose all refs now in the garbage
     // Erase each entry so debugging tools don't see stale pointers.
-    while (garbage_count--) {
-        auto dead = garbage_refs[garbage_count];
-        garbage_refs[garbage_count] = nil;
+    while (count--) {
+        auto dead = refs[count];
+        refs[count] = nil;
         free(dead);
     }
-    
-    // Clear the garbage count and total size indicator
-    garbage_count = 0;
-    garbage_byte_size = 0;
 
     if (PrintCaches) {
         size_t i;
@@ -1346,7 +1678,361 @@ void cache_t::collectNolock(bool collectALot)
 
         _objc_inform("CACHES:      total: %4zu caches, %6zu bytes", 
                      total_count, total_size);
+
+#if CACHE_ROBIN_HOOD
+        _objc_inform("CACHES: robin hood: %4zu reorders", robin_hood_reorders);
+#endif
+
+        if (AdaptiveCaches) {
+            _objc_inform("CACHES:   adaptive: %4zu shrinks, %6zu bytes saved, "
+                         "%zu fills before shrinking, %zu after",
+                         adaptive_shrinks, adaptive_bytes_saved,
+                         adaptive_fills_before, adaptive_fills_after);
+        }
+    }
+}
+
+
+#if CONFIG_CACHE_EPOCHS
+/***********************************************************************
+* Epoch-based cache reclamation
+* Instead of stopping to look at every thread's PC, dead caches wait
+* in batches until every thread has passed a quiescent state: a point
+* where it cannot be in the middle of a cache scan, such as an
+* autorelease pool pop or a run loop turn.
+*
+* collectNolock() moves the garbage into a batch tagged with a new
+* epoch. A thread records the current epoch at each quiescent state.
+* A thread may also go offline while it blocks or runs code that sends
+* no messages; until it comes back online it counts as quiescent in
+* every epoch. A batch is freed once every online reader has recorded
+* its epoch or a later one.
+*
+* Threads register as readers the first time they pass a quiescent
+* state or go offline, and unregister when their _objc_pthread_data
+* is destroyed. Registering is itself a quiescent state, so a thread
+* that registers late cannot be holding older garbage. A thread that
+* never registered may be in a cache scan, so while the process has
+* more threads than registered readers, or its thread count is unknown,
+* _collecting_in_critical() decides instead.
+*
+* A thread that stays online without passing a quiescent state holds
+* back every batch. When the batches grow past
+* EPOCH_GARBAGE_FALLBACK_FACTOR times garbage_threshold,
+* _collecting_in_critical() frees them all.
+**********************************************************************/
+
+// One per registered thread. Records are never freed. A thread that
+// registers reuses the record of one that exited, so there are as many
+// as the most readers ever registered at once.
+struct CacheReaderThread {
+    // 0 while the thread is offline.
+    std::atomic<uintptr_t> seenEpoch;
+    std::atomic<bool> inUse;
+    CacheReaderThread *next;  // never changes once the record is listed
+};
+
+namespace objc {
+
+struct garbage_batch_t {
+    bucket_t **refs;
+    size_t count;
+    size_t bytes;
+    uintptr_t epoch;
+};
+
+enum { EPOCH_GARBAGE_FALLBACK_FACTOR = 32 };
+
+static std::atomic<CacheReaderThread *> cacheReaderThreads;
+static std::atomic<size_t> cacheReaderCount;
+static std::atomic<size_t> cacheReaderExits;
+static tls_fast(CacheReaderThread *) currentCacheReader;
+
+static garbage_batch_t *garbageBatches;
+static size_t garbageBatchCount;
+static size_t garbageBatchMax;
+static size_t garbageBatchBytes;
+
+// Put the current thread online in the current epoch. The fence keeps
+// its next cache reads from moving above the store, where a collector
+// could miss them.
+static void cacheReaderOnline(CacheReaderThread *reader)
+{
+    reader->seenEpoch.store(cacheEpoch.load(std::memory_order_acquire),
+                            std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+static CacheReaderThread *registerCacheReader()
+{
+    CacheReaderThread *reader;
+    for (reader = cacheReaderThreads.load(std::memory_order_acquire);
+         reader;
+         reader = reader->next)
+    {
+        bool inUse = false;
+        if (!reader->inUse.load(std::memory_order_relaxed)  &&
+            reader->inUse.compare_exchange_strong(inUse, true,
+                                                  std::memory_order_acquire,
+                                                  std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    if (!reader) {
+        reader = (CacheReaderThread *)calloc(1, sizeof(CacheReaderThread));
+        reader->inUse.store(true, std::memory_order_relaxed);
+        auto *head = cacheReaderThreads.load(std::memory_order_relaxed);
+        do {
+            reader->next = head;
+        } while (!cacheReaderThreads.compare_exchange_weak(head, reader,
+                                                           std::memory_order_release,
+                                                           std::memory_order_relaxed));
+    }
+    cacheReaderOnline(reader);
+    cacheReaderCount.fetch_add(1, std::memory_order_seq_cst);
+
+    _objc_fetch_pthread_data(true)->cacheReader = reader;
+    currentCacheReader = reader;
+    return reader;
+}
+
+// Whether every thread in the process is a registered reader.
+static bool allThreadsAreCacheReaders()
+{
+    size_t exits = cacheReaderExits.load(std::memory_order_seq_cst);
+    size_t readers = cacheReaderCount.load(std::memory_order_seq_cst);
+    unsigned threads = liveThreadCount();
+    // A reader that exited during the count may have hidden
+    // a thread that never registered.
+    return threads != 0  &&  threads <= readers  &&
+        exits == cacheReaderExits.load(std::memory_order_seq_cst);
+}
+
+// Returns the oldest epoch that some online reader has not passed.
+static uintptr_t oldestActiveEpoch()
+{
+    uintptr_t oldest = cacheEpoch.load(std::memory_order_seq_cst);
+
+    auto *reader = cacheReaderThreads.load(std::memory_order_acquire);
+    for ( ; reader; reader = reader->next) {
+        if (!reader->inUse.load(std::memory_order_acquire)) continue;
+        uintptr_t seen = reader->seenEpoch.load(std::memory_order_seq_cst);
+        if (seen) oldest = std::min(oldest, seen);
+    }
+    return oldest;
+}
+
+static void freeGarbageBatchesThrough(uintptr_t epoch)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < garbageBatchCount; i++) {
+        auto &batch = garbageBatches[i];
+        if (batch.epoch <= epoch) {
+            disposeGarbage(batch.refs, batch.count, batch.bytes);
+            free(batch.refs);
+            garbageBatchBytes -= batch.bytes;
+        } else {
+            garbageBatches[kept++] = batch;
+        }
+    }
+    garbageBatchCount = kept;
+}
+
+static void collectEpochsNolock(bool collectALot)
+{
+    // Retire the current garbage under a new epoch.
+    if (garbage_count) {
+        if (garbageBatchCount == garbageBatchMax) {
+            garbageBatchMax = garbageBatchMax ? garbageBatchMax * 2 : 4;
+            garbageBatches = (garbage_batch_t *)
+                realloc(garbageBatches, garbageBatchMax * sizeof(garbage_batch_t));
+        }
+        garbageBatches[garbageBatchCount++] = {
+            garbage_refs, garbage_count, garbage_byte_size,
+            cacheEpoch.fetch_add(1, std::memory_order_seq_cst) + 1,
+        };
+        garbageBatchBytes += garbage_byte_size;
+        garbage_refs = nil;
+        garbage_count = 0;
+        garbage_max = 0;
+        garbage_byte_size = 0;
+    }
+
+    // This thread is not in a cache scan.
+    cache_t::threadQuiescent();
+
+    bool tracked = allThreadsAreCacheReaders();
+    if (tracked) {
+        cacheSafeEpoch = oldestActiveEpoch();
+        freeGarbageBatchesThrough(cacheSafeEpoch);
+    }
+
+    // Some thread is not registered or not reaching quiescent states.
+    // Check the PCs instead.
+    if (garbageBatchCount  &&
+        (collectALot  ||  !tracked  ||
+         garbageBatchBytes > garbage_threshold * EPOCH_GARBAGE_FALLBACK_FACTOR))
+    {
+        if (collectALot) {
+            while (_collecting_in_critical())
+                ;
+        } else if (_collecting_in_critical()) {
+            return;
+        }
+        cacheSafeEpoch = cacheEpoch.load(std::memory_order_seq_cst);
+        freeGarbageBatchesThrough(cacheSafeEpoch);
+    }
+
+    if (PrintCaches  &&  garbageBatchCount) {
+        _objc_inform("CACHES: %zu bytes waiting for %zu epochs%s",
+                     garbageBatchBytes, garbageBatchCount,
+                     tracked ? "" : " (unregistered threads)");
+    }
+}
+
+} // namespace objc
+
+
+/***********************************************************************
+* _destroyCacheReader.  Unregister an exiting thread's reader record.
+* Called from the thread's _objc_pthread_data destructor.
+* Cache locks: none
+**********************************************************************/
+void _destroyCacheReader(CacheReaderThread *reader)
+{
+    if (!reader) return;
+    reader->seenEpoch.store(0, std::memory_order_release);
+    reader->inUse.store(false, std::memory_order_release);
+    objc::cacheReaderExits.fetch_add(1, std::memory_order_seq_cst);
+    objc::cacheReaderCount.fetch_sub(1, std::memory_order_seq_cst);
+    // The record may be reused by the next thread to register.
+    objc::currentCacheReader = nil;
+}
+#endif // CONFIG_CACHE_EPOCHS
+
+
+/***********************************************************************
+* cache_t::threadQuiescent.  Called at points where the current thread
+* cannot be in the middle of a cache scan.
+* Cache locks: none
+**********************************************************************/
+void cache_t::threadQuiescent()
+{
+#if CONFIG_CACHE_EPOCHS
+    auto *reader = objc::currentCacheReader;
+    if (slowpath(!reader)) {
+        objc::registerCacheReader();
+        return;
     }
+    // An offline thread stays offline until threadOnline().
+    if (reader->seenEpoch.load(std::memory_order_relaxed) == 0) return;
+    reader->seenEpoch.store(objc::cacheEpoch.load(std::memory_order_acquire),
+                            std::memory_order_release);
+#endif
+}
+
+
+/***********************************************************************
+* cache_t::threadOffline.  Called before the current thread blocks or
+* runs code that reads no method caches, until threadOnline().
+* Cache locks: none
+**********************************************************************/
+void cache_t::threadOffline()
+{
+#if CONFIG_CACHE_EPOCHS
+    auto *reader = objc::currentCacheReader;
+    if (slowpath(!reader)) reader = objc::registerCacheReader();
+    reader->seenEpoch.store(0, std::memory_order_release);
+#endif
+}
+
+
+/***********************************************************************
+* cache_t::threadOnline.  Called before the current thread reads method
+* caches again after threadOffline().
+* Cache locks: none
+**********************************************************************/
+void cache_t::threadOnline()
+{
+#if CONFIG_CACHE_EPOCHS
+    auto *reader = objc::currentCacheReader;
+    if (slowpath(!reader)) {
+        objc::registerCacheReader();
+        return;
+    }
+    objc::cacheReaderOnline(reader);
+#endif
+}
+
+
+void _objc_cacheQuiescentState(void)
+{
+    cache_t::threadQuiescent();
+}
+
+void _objc_cacheThreadOffline(void)
+{
+    cache_t::threadOffline();
+}
+
+void _objc_cacheThreadOnline(void)
+{
+    cache_t::threadOnline();
+}
+
+
+/***********************************************************************
+* cache_collect.  Try to free accumulated dead caches.
+* collectALot tries harder to free memory.
+* Cache locks: cacheUpdateLock must be held by the caller.
+**********************************************************************/
+void cache_t::collectNolock(bool collectALot)
+{
+#if CONFIG_USE_CACHE_LOCK
+    lockdebug::assert_locked(&cacheUpdateLock);
+#else
+    lockdebug::assert_locked(&runtimeLock);
+#endif
+
+    // Done if the garbage is not full
+    if (garbage_byte_size < garbage_threshold  &&  !collectALot) {
+        return;
+    }
+
+#if CONFIG_CACHE_EPOCHS
+    objc::collectEpochsNolock(collectALot);
+    return;
+#endif
+
+    // Synchronize collection with objc_msgSend and other cache readers
+    if (!collectALot) {
+        if (_collecting_in_critical ()) {
+            // objc_msgSend (or other cache reader) is currently looking in
+            // the cache and might still be using some garbage.
+            if (PrintCaches) {
+                _objc_inform ("CACHES: not collecting; "
+                              "objc_msgSend in progress");
+            }
+            return;
+        }
+    } 
+    else {
+        // No excuses.
+        while (_collecting_in_critical()) 
+            ;
+    }
+
+    // No cache readers in progress - garbage is now deletable.
+    // This also ends the wait of any shrinks made so far.
+    cacheSyncCount++;
+
+    disposeGarbage(garbage_refs, garbage_count, garbage_byte_size);
+    
+    // Clear the garbage count and total size indicator
+    garbage_count = 0;
+    garbage_byte_size = 0;
 }
 
 
@@ -1606,3 +2292,14 @@ OBJC_EXPORT uint32_t objc_cache_occupied(const cache_t * _Nonnull cache) {
 OBJC_EXPORT unsigned objc_cache_capacity(const struct cache_t * _Nonnull cache) {
     return cache->capacity();
 }
+
+OBJC_EXPORT IMP _Nullable objc_cache_lookup(const struct cache_t * _Nonnull cache, SEL _Nonnull sel, unsigned * _Nullable outProbes) {
+    mask_t probes;
+    IMP imp = cache->lookup(sel, &probes);
+    if (outProbes) *outProbes = probes;
+    return imp;
+}
+
+OBJC_EXPORT const struct cache_t * _Nonnull _class_getCache(Class _Nonnull cls) {
+    return &cls->cache;
+}
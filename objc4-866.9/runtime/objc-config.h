@@ -185,6 +185,79 @@
 // the cache lock would need to be used again
 #define CONFIG_USE_CACHE_LOCK 0
 
+// Define CONFIG_LOCKFREE_METHOD_LOOKUP=1 to let lookUpImpOrForward search
+// the method lists of initialized classes without holding runtimeLock.
+// The lock is then only taken to validate the result and fill the cache.
+#define CONFIG_LOCKFREE_METHOD_LOOKUP 1
+
+// Define CONFIG_CACHE_EPOCHS=1 to free dead method caches once every
+// online thread has passed a quiescent state, instead of stopping to
+// inspect the PC of every thread. Threads register from their
+// _objc_pthread_data. While some threads are not registered, or the
+// OS cannot count the process's threads, the PC check is still used.
+#define CONFIG_CACHE_EPOCHS 1
+
+// CONFIG_ASSOCIATIONS_INLINE is the number of associated object keys,
+// 1 to 4, stored inline with an object's associations before they
+// move to a hash map of their own. Every bucket of the association
+// table has room for them, so each one more costs objects with one key
+// a key and an association. Most objects have one key, so the default
+// is 1. OBJC_DISABLE_INLINE_ASSOCIATIONS turns them off at run time,
+// to compare with a hash map for every object.
+#define CONFIG_ASSOCIATIONS_INLINE 1
+
+// CONFIG_ASSOCIATIONS_READ_CACHE is the number of recently read 
+// associations per stripe that objc_getAssociatedObject() can find 
+// without a lock, for policies whose getter does not retain. 
+// It must be a power of two. 0 disables the cache.
+#define CONFIG_ASSOCIATIONS_READ_CACHE 8
+
+// CONFIG_ADAPTIVE_LOCK_SPIN_ROUNDS is how many rounds of spinning a
+// contended @synchronized lock does before blocking. Round i pauses
+// 2^i times, so the total spin is about 2^rounds pauses. A thread
+// with a higher QoS than the lock's owner blocks without spinning.
+#define CONFIG_ADAPTIVE_LOCK_SPIN_ROUNDS 10
+
+// CONFIG_ZONE_MAGAZINE_SIZE is how many free elements of a packed 
+// objc::zalloc zone each thread caches before it gives them back to 
+// the zone's shared depot.
+#define CONFIG_ZONE_MAGAZINE_SIZE 16
+
+// CONFIG_METHOD_INDEX_MIN_LISTS is how many method lists a class needs,
+// usually from categories, before method searches use a merged index
+// of all of its methods instead of searching each list. 0 disables
+// the index.
+#define CONFIG_METHOD_INDEX_MIN_LISTS 8
+
+// CONFIG_PARALLEL_SELREF_MIN is how many selector references a batch of
+// images needs before map_images() fixes them up with dispatch_apply()
+// ahead of taking runtimeLock. CONFIG_PARALLEL_SELREF_CHUNK is how many
+// references each iteration resolves. CONFIG_PARALLEL_SELREF_MIN 0
+// disables the parallel fixup.
+#define CONFIG_PARALLEL_SELREF_MIN 16384
+#define CONFIG_PARALLEL_SELREF_CHUNK 2048
+
+// CONFIG_CLASS_MISS_MEMO_SIZE is how many class names that were not found
+// are remembered, so looking them up again skips the shared cache and
+// Swift-mangled probes until classes or images are added or removed.
+#define CONFIG_CLASS_MISS_MEMO_SIZE 32
+
+// CONFIG_PROTOCOL_CLOSURE_CACHE_SIZE is how many classes' protocol
+// conformance closures are cached for class_conformsToProtocol().
+// CONFIG_PROTOCOL_CLOSURE_CACHE_WAYS is how many classes whose pointers
+// hash alike can be cached at once. 0 disables the cache.
+#define CONFIG_PROTOCOL_CLOSURE_CACHE_SIZE 1024
+#define CONFIG_PROTOCOL_CLOSURE_CACHE_WAYS 4
+
+// Define CACHE_ROBIN_HOOD=1 to support Robin-Hood inserts into method
+// caches, turned on at run time with OBJC_ROBIN_HOOD_CACHES. An insert
+// that would land far from its home bucket takes the bucket of an entry
+// closer to its own. The buckets stay a linear-probed table, so
+// objc_msgSend is unchanged.
+#ifndef CACHE_ROBIN_HOOD
+#define CACHE_ROBIN_HOOD 1
+#endif
+
 // Determine how the method cache stores IMPs.
 #define CACHE_IMP_ENCODING_NONE 1 // Method cache contains raw IMP.
 #define CACHE_IMP_ENCODING_ISA_XOR 2 // Method cache contains ISA ^ IMP.
@@ -302,6 +375,12 @@
 #define HAVE_ASPRINTF   0
 #endif
 
+#if   TARGET_OS_MAC
+#define HAVE_PROC_PIDINFO 1
+#else
+#define HAVE_PROC_PIDINFO 0
+#endif
+
 // Threading package support
 #define OBJC_THREADING_NONE         0   // single threaded
 #define OBJC_THREADING_DARWIN       1   // pthreads + os_unfair_lock + direct TSD
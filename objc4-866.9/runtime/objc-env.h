@@ -35,11 +35,16 @@ OPTION( DebugNonFragileIvars,     OBJC_DEBUG_NONFRAGILE_IVARS,     "capriciously
 OPTION( DebugAltHandlers,         OBJC_DEBUG_ALT_HANDLERS,         "record more info about bad alt handler use")
 OPTION( DebugMissingPools,        OBJC_DEBUG_MISSING_POOLS,        "warn about autorelease with no pool in place, which may be a leak")
 OPTION( DebugPoolAllocation,      OBJC_DEBUG_POOL_ALLOCATION,      "halt when autorelease pools are popped out of order, and allow heap debuggers to track autorelease pools")
+OPTION( PoolPageStash,            OBJC_POOL_PAGE_STASH,            "keep up to a set number of free autorelease pool pages per thread for reuse (default 4, 0 frees every page); ignored when OBJC_DEBUG_POOL_ALLOCATION is set")
+OPTION( BatchPoolPop,             OBJC_BATCH_POOL_POP,             "release autorelease pool contents in batches, deallocating the objects of each batch grouped by class instead of in pool order")
 OPTION( DebugDuplicateClasses,    OBJC_DEBUG_DUPLICATE_CLASSES,    "halt when multiple classes with the same name are present")
 OPTION( DebugDontCrash,           OBJC_DEBUG_DONT_CRASH,           "halt the process by exiting instead of crashing")
 OPTION( DebugPoolDepth,           OBJC_DEBUG_POOL_DEPTH,           "log fault when at least a set number of autorelease pages has been allocated")
 OPTION( DebugScribbleCaches,      OBJC_DEBUG_SCRIBBLE_CACHES,      "scribble the IMPs in freed method caches")
 OPTION( DebugScanWeakTables,      OBJC_DEBUG_SCAN_WEAK_TABLES,     "scan the weak references table continuously in the background - set OBJC_DEBUG_SCAN_WEAK_TABLES_INTERVAL_NANOSECONDS to set scanning interval (default 1000000)")
+OPTION( AdaptiveCaches,           OBJC_ADAPTIVE_CACHES,            "shrink method caches to fit their contents when they are flushed; OBJC_PRINT_CACHE_SETUP reports the effect")
+OPTION( RobinHoodCaches,          OBJC_ROBIN_HOOD_CACHES,          "insert into dense method caches in Robin-Hood order to shorten the longest probes; OBJC_PRINT_CACHE_SETUP reports the number of reorders")
+OPTION( BiasedRC,                 OBJC_BIASED_RC,                  "keep the allocating thread's retains of new objects in a table of its own instead of the object's isa; the thread that releases the last reference deallocates, whichever it is")
 OPTION( DisableVtables,           OBJC_DISABLE_VTABLES,            "disable vtable dispatch")
 OPTION( DisablePreopt,            OBJC_DISABLE_PREOPTIMIZATION,    "disable preoptimization courtesy of dyld shared cache")
 OPTION( DisableTaggedPointers,    OBJC_DISABLE_TAGGED_POINTERS,    "disable tagged pointer optimization of NSNumber et al.") 
@@ -50,6 +55,11 @@ OPTION( DisableFaults,            OBJC_DISABLE_FAULTS,             "disable os f
 OPTION( DisablePreoptCaches,      OBJC_DISABLE_PREOPTIMIZED_CACHES, "disable preoptimized caches")
 OPTION( DisableAutoreleaseCoalescing, OBJC_DISABLE_AUTORELEASE_COALESCING, "disable coalescing of autorelease pool pointers")
 OPTION( DisableAutoreleaseCoalescingLRU, OBJC_DISABLE_AUTORELEASE_COALESCING_LRU, "disable coalescing of autorelease pool pointers using look back N strategy")
+OPTION( DisableLockFreeLookup,    OBJC_DISABLE_LOCKFREE_LOOKUP,    "disable method list searches that do not hold the runtime lock")
+OPTION( DisableMethodIndex,       OBJC_DISABLE_METHOD_INDEX,       "disable merged method indexes for classes with many category method lists")
+OPTION( DisableLazyCategories,    OBJC_DISABLE_LAZY_CATEGORIES,    "attach categories to realized classes when they load instead of when the class is first used")
+OPTION( DisableParallelImageReading, OBJC_DISABLE_PARALLEL_IMAGE_READING, "disable fixing up selector references of many images in parallel")
+OPTION( DisableInlineAssociations, OBJC_DISABLE_INLINE_ASSOCIATIONS, "keep every object's associated objects in a hash map of its own, without inline keys")
 
 INTERNAL_OPTION( DisableClassRXSigningEnforcement, OBJC_DISABLE_CLASSRX_SIGNING_ENFORCEMENT, "disable class_rx_t pointer signing enforcement")
 INTERNAL_OPTION( DebugClassRXSigning,              OBJC_DEBUG_CLASS_RX_SIGNING,     "warn about class_rx_t pointer signing mismatches")
@@ -271,9 +271,17 @@ OBJC_EXTERN const uint32_t objc_debug_autoreleasepoolpage_depth_offset  OBJC_AVA
 OBJC_EXTERN const uint32_t objc_debug_autoreleasepoolpage_hiwat_offset  OBJC_AVAILABLE(10.15, 13.0, 13.0, 6.0, 5.0);
 OBJC_EXTERN const uintptr_t objc_debug_autoreleasepoolpage_ptr_mask     OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
 
+// Points to the statically allocated side table stripes, laid out as
+// before. They are the stripes in use unless the array pointer at
+// objc_debug_side_table_stripes points elsewhere.
 OBJC_EXPORT void *const _Nonnull objc_debug_side_tables_map
     OBJC_AVAILABLE(12.0, 15.0, 15.0, 8.0, 7.0);
 
+// Points to a pointer to the first side table stripe, then the index
+// mask. The stripe count depends on the CPU count.
+OBJC_EXPORT void *const _Nonnull objc_debug_side_table_stripes
+    OBJC_AVAILABLE(14.0, 17.0, 17.0, 10.0, 8.0);
+
 OBJC_EXPORT void *const _Nonnull objc_debug_future_named_class_map
     OBJC_AVAILABLE(13.0, 16.0, 16.0, 9.0, 8.0);
 
@@ -373,7 +373,9 @@ void waitForInitializeToComplete(Class cls)
 
     monitor_locker_t lock(classInitLock);
     while (!cls->isInitialized()) {
+        cache_t::threadOffline();
         classInitLock.wait();
+        cache_t::threadOnline();
     }
     asm("");
 }
@@ -1087,11 +1087,32 @@ objc_release(id _Nullable obj)
     __asm__("_objc_release")
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
 
+// Retain or release every object in objs[0..count). nil and duplicate
+// pointers are allowed; an object that appears k times is retained or
+// released k times. objc_releaseBatch deallocates objects only after
+// every count in the batch has been updated, except for objects whose
+// classes override -release.
+OBJC_EXPORT void
+objc_retainBatch(id _Nullable * _Nonnull objs, size_t count)
+    OBJC_AVAILABLE(14.0, 17.0, 17.0, 10.0, 8.0);
+
+OBJC_EXPORT void
+objc_releaseBatch(id _Nullable * _Nonnull objs, size_t count)
+    OBJC_AVAILABLE(14.0, 17.0, 17.0, 10.0, 8.0);
+
 OBJC_EXPORT id _Nullable
 objc_autorelease(id _Nullable obj)
     __asm__("_objc_autorelease")
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
 
+// Autorelease every object in objs[0..count), in order, as if by
+// objc_autorelease(). nil and duplicate pointers are allowed. Objects
+// are stored into the current pool page by page; the pool is popped
+// as usual.
+OBJC_EXPORT void
+objc_autoreleaseBatch(id _Nullable * _Nonnull objs, size_t count)
+    OBJC_AVAILABLE(14.0, 17.0, 17.0, 10.0, 8.0);
+
 // Prepare a value at +1 for return through a +0 autoreleasing convention.
 OBJC_EXPORT id _Nullable
 objc_autoreleaseReturnValue(id _Nullable obj)
@@ -1175,6 +1196,79 @@ OBJC_EXPORT void
 _objc_autoreleasePoolPrint(void)
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
 
+// Tell the runtime that the current thread is not inside a method cache
+// lookup, so dead method caches it might have seen can be freed.
+// Autorelease pool pops do this already. Long-running threads that never
+// pop a pool, such as event loops, should call this once per iteration.
+OBJC_EXPORT void
+_objc_cacheQuiescentState(void)
+    OBJC_AVAILABLE(14.0, 17.0, 17.0, 10.0, 8.0);
+
+// Tell the runtime that the current thread will send no messages until
+// it calls _objc_cacheThreadOnline(), for example while it waits for
+// an event. Dead method caches are not held back by offline threads.
+OBJC_EXPORT void
+_objc_cacheThreadOffline(void)
+    OBJC_AVAILABLE(14.0, 17.0, 17.0, 10.0, 8.0);
+
+OBJC_EXPORT void
+_objc_cacheThreadOnline(void)
+    OBJC_AVAILABLE(14.0, 17.0, 17.0, 10.0, 8.0);
+
+// Hold-time and contention histograms of the @synchronized lock of obj,
+// counted since the lock was last assigned to obj. hold[i] counts
+// outermost holds that lasted [2^i, 2^(i+1)) ns. spin[i] counts
+// contended locks taken after i+1 rounds of spinning; spin[spinRounds]
+// counts those that blocked instead. Returns NO if obj has no lock.
+// The lock only surely stays with obj while a thread is synchronized
+// on obj.
+struct objc_sync_lock_histograms {
+    uint64_t hold[32];
+    uint64_t spin[16];
+    unsigned spinRounds;
+};
+
+OBJC_EXPORT BOOL
+_objc_getSyncLockHistograms(id _Nonnull obj,
+                            struct objc_sync_lock_histograms * _Nonnull out)
+    OBJC_AVAILABLE(14.0, 17.0, 17.0, 10.0, 8.0);
+
+// Statistics for one of the runtime's packed metadata allocators,
+// counted since launch. Each thread adds its allocations and frees in
+// batches, so the counts can lag by a few per running thread.
+// refills and spills count the per-thread magazines of free elements
+// taken from and given back to the allocator's shared depot.
+struct objc_zone_statistics {
+    const char * _Nonnull name;
+    size_t elementSize;
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t refills;
+    uint64_t spills;
+    uint64_t slabs;
+};
+
+// Copy the statistics of up to count packed allocators into stats.
+// Returns the number of packed allocators.
+OBJC_EXPORT unsigned
+_objc_getZoneStatistics(struct objc_zone_statistics * _Nullable stats,
+                        unsigned count)
+    OBJC_AVAILABLE(14.0, 17.0, 17.0, 10.0, 8.0);
+
+// Counts of categories on realized classes whose attachment was deferred
+// until the class was first used. avoidedExtAllocations is how many
+// classes still have no class_rw_ext_t because of that.
+struct objc_lazy_category_statistics {
+    size_t deferredCategories;
+    size_t attachedCategories;
+    size_t pendingClasses;
+    size_t avoidedExtAllocations;
+};
+
+OBJC_EXPORT void
+_objc_getLazyCategoryStatistics(struct objc_lazy_category_statistics * _Nonnull stats)
+    OBJC_AVAILABLE(14.0, 17.0, 17.0, 10.0, 8.0);
+
 OBJC_EXPORT BOOL
 objc_should_deallocate(id _Nonnull object)
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
@@ -1403,6 +1497,8 @@ OBJC_EXPORT struct bucket_t * _Nonnull objc_cache_buckets(const struct cache_t *
 OBJC_EXPORT size_t objc_cache_bytesForCapacity(uint32_t cap);
 OBJC_EXPORT uint32_t objc_cache_occupied(const struct cache_t * _Nonnull cache);
 OBJC_EXPORT unsigned objc_cache_capacity(const struct cache_t * _Nonnull cache);
+OBJC_EXPORT IMP _Nullable objc_cache_lookup(const struct cache_t * _Nonnull cache, SEL _Nonnull sel, unsigned * _Nullable outProbes);
+OBJC_EXPORT const struct cache_t * _Nonnull _class_getCache(Class _Nonnull cls);
 
 #if CONFIG_USE_PREOPT_CACHES
 
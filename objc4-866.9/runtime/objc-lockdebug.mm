@@ -287,6 +287,12 @@ lockdebug::notify::remember(objc_recursive_lock_base_t *lock)
     setLock(AllLocks(), lock, RECURSIVE);
 }
 
+void
+lockdebug::notify::remember(objc_adaptive_recursive_lock_base_t *lock)
+{
+    setLock(AllLocks(), lock, RECURSIVE);
+}
+
 void
 lockdebug::notify::remember(objc_monitor_base_t *lock)
 {
@@ -420,6 +426,50 @@ lockdebug::assert_unlocked(objc_recursive_lock_base_t *lock)
 }
 
 
+/***********************************************************************
+* Adaptive recursive mutex checking
+**********************************************************************/
+
+void
+lockdebug::notify::lock(objc_adaptive_recursive_lock_base_t *lock)
+{
+    auto& locks = ownedLocks();
+    setLock(locks, lock, RECURSIVE);
+}
+
+void
+lockdebug::notify::unlock(objc_adaptive_recursive_lock_base_t *lock)
+{
+    auto& locks = ownedLocks();
+
+    if (!hasLock(locks, lock, RECURSIVE)) {
+        _objc_fatal("unlocking unowned recursive mutex");
+    }
+    clearLock(locks, lock, RECURSIVE);
+}
+
+
+void
+lockdebug::assert_locked(objc_adaptive_recursive_lock_base_t *lock)
+{
+    auto& locks = ownedLocks();
+
+    if (!hasLock(locks, lock, RECURSIVE)) {
+        _objc_fatal("recursive mutex incorrectly not locked");
+    }
+}
+
+void
+lockdebug::assert_unlocked(objc_adaptive_recursive_lock_base_t *lock)
+{
+    auto& locks = ownedLocks();
+
+    if (hasLock(locks, lock, RECURSIVE)) {
+        _objc_fatal("recursive mutex incorrectly locked");
+    }
+}
+
+
 /***********************************************************************
 * Monitor checking
 **********************************************************************/
@@ -353,6 +353,15 @@ objc_object::initIsa(Class cls, bool nonpointer, UNUSED_WITHOUT_INDEXED_ISA_AND_
         newisa.setClass(cls, this);
 #endif
         newisa.extra_rc = 1;
+#if ISA_HAS_BIASED_RC
+        if (slowpath(BiasedRC)  &&  !cls->isMetaClass()  &&
+            !cls->hasCustomRR()  &&  biasedRCAdopt())
+        {
+            // The allocating thread holds the first retain in its table.
+            newisa.extra_rc = 0;
+            newisa.biased_rc = 1;
+        }
+#endif
     }
 
     // This write must be performed in a single store in some cases
@@ -382,6 +391,16 @@ objc_object::changeIsa(Class newCls)
 
     oldisa = LoadExclusive(&isa().bits);
 
+#if ISA_HAS_BIASED_RC
+    if (slowpath(oldisa.nonpointer  &&  oldisa.biased_rc)  &&
+        (newCls->isFuture()  ||  !newCls->canAllocNonpointer()))
+    {
+        ClearExclusive(&isa().bits);
+        unbiasForRawIsa(newCls);
+        oldisa = LoadExclusive(&isa().bits);
+    }
+#endif
+
     do {
         transcribeToSideTable = false;
         if ((oldisa.bits == 0  ||  oldisa.nonpointer)  &&
@@ -497,7 +516,7 @@ objc_object::setWeaklyReferenced_nolock()
         newisa = oldisa;
         if (slowpath(!newisa.nonpointer)) {
             ClearExclusive(&isa().bits);
-            sidetable_setWeaklyReferenced_nolock();
+            sidetable_setWeaklyReferenced();
             return;
         }
         if (newisa.weakly_referenced) {
@@ -571,6 +590,9 @@ objc_object::rootDealloc()
                  !isa().has_cxx_dtor                  &&
 #else
                  !isa().getClass(false)->hasCxxDtor() &&
+#endif
+#if ISA_HAS_BIASED_RC
+                 !isa().biased_rc                     &&
 #endif
                  !isa().has_sidetable_rc))
     {
@@ -649,12 +671,25 @@ objc_object::rootRetain(bool tryRetain, objc_object::RRVariant variant)
         }
     }
 
+#if ISA_HAS_BIASED_RC
+    if (slowpath(oldisa.nonpointer  &&  oldisa.biased_rc)  &&  !tryRetain) {
+        ClearExclusive(&isa().bits);
+        if (rootRetain_biased()) return (id)this;
+        // Not the owner. Use the shared count.
+        oldisa = LoadExclusive(&isa().bits);
+    }
+#endif
+
     do {
         transcribeToSideTable = false;
         newisa = oldisa;
         if (slowpath(!newisa.nonpointer)) {
             ClearExclusive(&isa().bits);
-            if (tryRetain) return sidetable_tryRetain() ? (id)this : nil;
+            if (tryRetain) {
+                // sidetable_tryRetain() takes the lock itself.
+                if (sideTableLocked) sidetable_unlock();
+                return sidetable_tryRetain() ? (id)this : nil;
+            }
             else return sidetable_retain(sideTableLocked);
         }
         // don't check newisa.fast_rr; we already called any RR overrides
@@ -681,7 +716,7 @@ objc_object::rootRetain(bool tryRetain, objc_object::RRVariant variant)
             }
             // Leave half of the retain counts inline and 
             // prepare to copy the other half to the side table.
-            if (!tryRetain && !sideTableLocked) sidetable_lock();
+            if (!sideTableLocked) sidetable_lock();
             sideTableLocked = true;
             transcribeToSideTable = true;
             newisa.extra_rc = RC_HALF;
@@ -695,7 +730,7 @@ objc_object::rootRetain(bool tryRetain, objc_object::RRVariant variant)
             sidetable_addExtraRC_nolock(RC_HALF);
         }
 
-        if (slowpath(!tryRetain && sideTableLocked)) sidetable_unlock();
+        if (slowpath(sideTableLocked)) sidetable_unlock();
     } else {
         ASSERT(!transcribeToSideTable);
         ASSERT(!sideTableLocked);
@@ -771,6 +806,16 @@ objc_object::rootRelease(bool performDealloc, objc_object::RRVariant variant)
         }
     }
 
+#if ISA_HAS_BIASED_RC
+    if (slowpath(oldisa.nonpointer  &&  oldisa.biased_rc)) {
+        ClearExclusive(&isa().bits);
+        bool deallocated;
+        if (rootRelease_biased(performDealloc, &deallocated)) return deallocated;
+        // Not the owner. Use the shared count.
+        oldisa = LoadExclusive(&isa().bits);
+    }
+#endif
+
 retry:
     do {
         newisa = oldisa;
@@ -885,6 +930,16 @@ retry:
     }
 
 deallocate:
+#if ISA_HAS_BIASED_RC
+    if (slowpath(newisa.biased_rc)) {
+        // The shared count is zero but the owner may still hold some.
+        // Take this release from the owner's share.
+        ClearExclusive(&isa().bits);
+        if (slowpath(sideTableLocked)) sidetable_unlock();
+        return rootRelease_ownerShare(performDealloc);
+    }
+#endif
+
     // Really deallocate.
 
     ASSERT(newisa.isDeallocating());
@@ -914,11 +969,10 @@ objc_object::autorelease()
 }
 
 
-// Base autorelease implementation, ignoring overrides.
-inline id 
-objc_object::rootAutorelease()
+// True if a deallocating object should be left out of the pool.
+inline bool
+objc_object::rootAutoreleaseSkipsPool()
 {
-    if (isTaggedPointer()) return (id)this;
     bool nonpointerIsa = false;
 #if ISA_HAS_INLINE_RC
     nonpointerIsa = isa().nonpointer;
@@ -926,14 +980,25 @@ objc_object::rootAutorelease()
     // When we can cheaply determine if the object is deallocating, avoid
     // putting it in the pool. Refcounting doesn't work on a deallocating object
     // so it's pointless to put it in the pool, and potentially dangerous.
-    if (nonpointerIsa && isa().isDeallocating()) return (id)this;
+    if (nonpointerIsa && isa().isDeallocating()) return true;
 #endif
 
     // If the class has custom dealloc initiation, we also want to avoid putting
     // deallocating instances in the pool even if it's expensive to check. (UIView
     // and UIViewController need this. rdar://97186669)
     if (!nonpointerIsa && ISA()->hasCustomDeallocInitiation() && rootIsDeallocating())
-        return (id)this;
+        return true;
+
+    return false;
+}
+
+
+// Base autorelease implementation, ignoring overrides.
+inline id 
+objc_object::rootAutorelease()
+{
+    if (isTaggedPointer()) return (id)this;
+    if (rootAutoreleaseSkipsPool()) return (id)this;
 
     if (prepareOptimizedReturn((id)this, true, ReturnAtPlus1)) return (id)this;
     if (slowpath(isClass())) return (id)this;
@@ -954,6 +1019,11 @@ objc_object::rootRetainCount()
         if (bits.has_sidetable_rc) {
             rc += sidetable_getExtraRC_nolock();
         }
+#if ISA_HAS_BIASED_RC
+        if (bits.biased_rc) {
+            rc = biasedRetainCount_nolock(rc);
+        }
+#endif
         sidetable_unlock();
         return rc;
     }
@@ -1092,7 +1162,7 @@ objc_object::setWeaklyReferenced_nolock()
 {
     ASSERT(!isTaggedPointer());
 
-    sidetable_setWeaklyReferenced_nolock();
+    sidetable_setWeaklyReferenced();
 }
 
 
@@ -1209,17 +1279,23 @@ objc_object::autorelease()
 }
 
 
+// True if a deallocating object should be left out of the pool.
+inline bool
+objc_object::rootAutoreleaseSkipsPool()
+{
+    // If the class has custom dealloc initiation, we also want to avoid putting
+    // deallocating instances in the pool even if it's expensive to check. (UIView
+    // and UIViewController need this. rdar://97186669)
+    return ISA()->hasCustomDeallocInitiation() && rootIsDeallocating();
+}
+
+
 // Base autorelease implementation, ignoring overrides.
 inline id 
 objc_object::rootAutorelease()
 {
     if (isTaggedPointer()) return (id)this;
-
-    // If the class has custom dealloc initiation, we also want to avoid putting
-    // deallocating instances in the pool even if it's expensive to check. (UIView
-    // and UIViewController need this. rdar://97186669)
-    if (ISA()->hasCustomDeallocInitiation() && rootIsDeallocating())
-        return (id)this;
+    if (rootAutoreleaseSkipsPool()) return (id)this;
 
     if (prepareOptimizedReturn((id)this, true, ReturnAtPlus1)) return (id)this;
 
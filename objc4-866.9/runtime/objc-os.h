@@ -150,6 +150,10 @@ static inline uintptr_t mask16ShiftBits(uint16_t mask)
 #   include <malloc/malloc.h>
 #endif
 
+#if HAVE_PROC_PIDINFO
+#   include <libproc.h>
+#endif
+
 #   include <mach-o/ldsyms.h>
 #   include <os/lock_private.h>
 #   include <libkern/OSCacheControl.h>
@@ -395,6 +399,19 @@ static inline uint64_t nanoseconds() {
 #endif
 }
 
+// The number of threads in the process, or 0 if it is not known.
+static inline unsigned liveThreadCount() {
+#if HAVE_PROC_PIDINFO
+    struct proc_taskinfo info;
+    if (proc_pidinfo(getpid(), PROC_PIDTASKINFO, 0, &info, sizeof(info))
+        == (int)sizeof(info))
+    {
+        return (unsigned)info.pti_threadnum;
+    }
+#endif
+    return 0;
+}
+
 // Threading
 #include "Threading/threading.h"
 
@@ -403,6 +420,7 @@ using spinlock_t = objc_lock_t;
 using mutex_t = objc_lock_t;
 using monitor_t = objc_monitor_t;
 using recursive_mutex_t = objc_recursive_lock_t;
+using adaptive_recursive_mutex_t = objc_adaptive_recursive_lock_t;
 
 using mutex_locker_t = mutex_t::locker;
 using conditional_mutex_locker_t = mutex_t::conditional_locker;
@@ -275,6 +275,7 @@ void objc_addLoadImageFunc(objc_func_loadImage _Nonnull func) {
 void 
 map_images_nolock(unsigned mhCount, const char * const mhPaths[],
                   const struct mach_header * const mhdrs[],
+                  size_t earlySelrefs,
                   bool *disabledClassROEnforcement)
 {
     static bool firstTime = YES;
@@ -467,7 +468,7 @@ map_images_nolock(unsigned mhCount, const char * const mhPaths[],
     }
 
     if (hCount > 0) {
-        _read_images(hList, hCount, totalClasses, unoptimizedTotalClasses);
+        _read_images(hList, hCount, totalClasses, unoptimizedTotalClasses, earlySelrefs);
     }
 
     firstTime = NO;
@@ -629,11 +630,11 @@ static void defineLockOrder()
 #endif
     lockdebug::lock_precedes_lock(&objcMsgLogLock, &crashlog_lock);
     lockdebug::lock_precedes_lock(&AltHandlerDebugLock, &crashlog_lock);
-    lockdebug::lock_precedes_lock(&AssociationsManagerLock, &crashlog_lock);
     SideTableLocksPrecedeLock(&crashlog_lock);
     PropertyLocks.precedeLock(&crashlog_lock);
     StructLocks.precedeLock(&crashlog_lock);
     CppObjectLocks.precedeLock(&crashlog_lock);
+    AssociationsLocks.precedeLock(&crashlog_lock);
 
     // loadMethodLock precedes everything
     // because it is held while +load methods run
@@ -646,20 +647,20 @@ static void defineLockOrder()
 #endif
     lockdebug::lock_precedes_lock(&loadMethodLock, &objcMsgLogLock);
     lockdebug::lock_precedes_lock(&loadMethodLock, &AltHandlerDebugLock);
-    lockdebug::lock_precedes_lock(&loadMethodLock, &AssociationsManagerLock);
     SideTableLocksSucceedLock(&loadMethodLock);
     PropertyLocks.succeedLock(&loadMethodLock);
     StructLocks.succeedLock(&loadMethodLock);
     CppObjectLocks.succeedLock(&loadMethodLock);
+    AssociationsLocks.succeedLock(&loadMethodLock);
 
-    // PropertyLocks and CppObjectLocks and AssociationManagerLock 
+    // PropertyLocks and CppObjectLocks and AssociationsLocks 
     // precede everything because they are held while objc_retain() 
     // or C++ copy are called.
     // (StructLocks do not precede everything because it calls memmove only.)
     auto PropertyAndCppObjectAndAssocLocksPrecedeLock = [&](const void *lock) {
         PropertyLocks.precedeLock(lock);
         CppObjectLocks.precedeLock(lock);
-        lockdebug::lock_precedes_lock(&AssociationsManagerLock, lock);
+        AssociationsLocks.precedeLock(lock);
     };
     PropertyAndCppObjectAndAssocLocksPrecedeLock(&runtimeLock);
     PropertyAndCppObjectAndAssocLocksPrecedeLock(&DemangleCacheLock);
@@ -673,10 +674,11 @@ static void defineLockOrder()
 
     SideTableLocksSucceedLocks(PropertyLocks);
     SideTableLocksSucceedLocks(CppObjectLocks);
-    SideTableLocksSucceedLock(&AssociationsManagerLock);
+    SideTableLocksSucceedLocks(AssociationsLocks);
 
-    PropertyLocks.precedeLock(&AssociationsManagerLock);
-    CppObjectLocks.precedeLock(&AssociationsManagerLock);
+    // AssociationsLocks are ordered among themselves below.
+    PropertyLocks.precedeLock(AssociationsLocks.getLock(0));
+    CppObjectLocks.precedeLock(AssociationsLocks.getLock(0));
 
     lockdebug::lock_precedes_lock(&classInitLock, &runtimeLock);
 
@@ -696,6 +698,7 @@ static void defineLockOrder()
     PropertyLocks.defineLockOrder();
     StructLocks.defineLockOrder();
     CppObjectLocks.defineLockOrder();
+    AssociationsLocks.defineLockOrder();
 }
 // LOCKDEBUG
 #endif
@@ -712,7 +715,7 @@ void _objc_atfork_prepare()
     loadMethodLock.lock();
     PropertyLocks.lockAll();
     CppObjectLocks.lockAll();
-    AssociationsManagerLock.lock();
+    AssociationsLocks.lockAll();
     SideTableLockAll();
     classInitLock.enter();
     runtimeLock.lock();
@@ -737,7 +740,7 @@ void _objc_atfork_parent()
     CppObjectLocks.unlockAll();
     StructLocks.unlockAll();
     PropertyLocks.unlockAll();
-    AssociationsManagerLock.unlock();
+    AssociationsLocks.unlockAll();
     AltHandlerDebugLock.unlock();
     objcMsgLogLock.unlock();
     crashlog_lock.unlock();
@@ -766,7 +769,7 @@ void _objc_atfork_child()
     CppObjectLocks.forceResetAll();
     StructLocks.forceResetAll();
     PropertyLocks.forceResetAll();
-    AssociationsManagerLock.reset();
+    AssociationsLocks.forceResetAll();
     AltHandlerDebugLock.reset();
     objcMsgLogLock.reset();
     crashlog_lock.reset();
@@ -96,7 +96,12 @@ public:
     };
 
     bool isDeallocating() {
+#if ISA_HAS_BIASED_RC
+        // A biased object's owner holds part of its count elsewhere.
+        return extra_rc == 0 && has_sidetable_rc == 0 && biased_rc == 0;
+#else
         return extra_rc == 0 && has_sidetable_rc == 0;
+#endif
     }
     void setDeallocating() {
         extra_rc = 0;
@@ -178,6 +183,18 @@ public:
     bool rootReleaseShouldDealloc();
     uintptr_t rootRetainCount();
 
+    // Implementations of objc_retainBatch/objc_releaseBatch/objc_autoreleaseBatch
+    static void retainBatch(id *objs, size_t count);
+    static void releaseBatch(id *objs, size_t count, bool deallocByClass = false);
+    static void autoreleaseBatch(id *objs, size_t count);
+
+#if ISA_HAS_BIASED_RC
+    // Unbias the objects of an exiting thread
+    static void biasedRCThreadExit(void *table);
+    // Forget the bias of an object freed by object_dispose()
+    void biasedRCDispose();
+#endif
+
     // Implementation of dealloc methods
     bool rootIsDeallocating();
     void clearDeallocating();
@@ -188,6 +205,7 @@ private:
 
     // Slow paths for inline control
     id rootAutorelease2();
+    bool rootAutoreleaseSkipsPool();
 
 #if SUPPORT_NONPOINTER_ISA
     // Controls what parts of root{Retain,Release} to emit/inline
@@ -207,6 +225,22 @@ private:
     id rootRetain_overflow(bool tryRetain);
     uintptr_t rootRelease_underflow(bool performDealloc);
 
+    // Add or remove count retains with one inline update.
+    // Return false if the caller must use rootRetain/rootRelease instead.
+    bool rootRetainBatch_fast(size_t count);
+    bool rootReleaseBatch_fast(size_t count);
+
+#if ISA_HAS_BIASED_RC
+    // Biased retain counts for OBJC_BIASED_RC
+    bool biasedRCAdopt();
+    bool rootRetain_biased();
+    bool rootRelease_biased(bool performDealloc, bool *deallocated);
+    bool rootRelease_ownerShare(bool performDealloc);
+    bool rootUnbias_nolock();
+    void unbiasForRawIsa(Class newCls);
+    uintptr_t biasedRetainCount_nolock(uintptr_t sharedCount);
+#endif
+
     void clearDeallocating_slow();
 
     // Side table retain count overflow for nonpointer isa
@@ -227,7 +261,7 @@ private:
     void sidetable_clearDeallocating();
 
     bool sidetable_isWeaklyReferenced();
-    void sidetable_setWeaklyReferenced_nolock();
+    void sidetable_setWeaklyReferenced();
 
     id sidetable_retain(bool locked = false);
     id sidetable_retain_slow(SideTable& table);
@@ -237,6 +271,9 @@ private:
 
     bool sidetable_tryRetain();
 
+    void sidetable_retainBatch_nolock(size_t count);
+    bool sidetable_releaseBatch_nolock(size_t count);
+
     uintptr_t sidetable_retainCount();
 #if DEBUG
     bool sidetable_present();
@@ -555,6 +592,16 @@ extern bool didCallDyldNotifyRegister;
 extern void sel_init(size_t selrefCount);
 extern SEL sel_registerNameNoLock(const char *str, bool copy);
 
+// Sharded selector registration for the parallel selector fixup.
+#define SEL_SHARD_BITS 4
+#define SEL_SHARDS (1 << SEL_SHARD_BITS)
+static inline unsigned sel_shard(uint32_t hash) {
+    return hash >> (32 - SEL_SHARD_BITS);
+}
+extern uint32_t sel_namehash(const char *name);
+extern SEL sel_lookUpByNameAndHash(const char *name, uint32_t hash);
+extern SEL sel_registerNameInShard(const char *name, uint32_t hash, bool copy);
+
 extern SEL SEL_cxx_construct;
 extern SEL SEL_cxx_destruct;
 
@@ -691,6 +738,11 @@ struct _objc_pthread_data {
     const char **classNameLookups;  // for objc_getClass() hooks
     unsigned classNameLookupsAllocated;
     unsigned classNameLookupsUsed;
+    void *poolPageStash;  // free autorelease pool pages, linked through their first word
+    unsigned poolPageStashCount;
+    unsigned poolPageStashHiwat;
+    struct ZoneMagazines *zoneMagazines;  // for objc::zalloc
+    struct CacheReaderThread *cacheReader;  // for method cache epochs
 
     // If you add new fields here, don't forget to update the destructor
     ~_objc_pthread_data();
@@ -710,8 +762,17 @@ extern char *encoding_copyArgumentType(const char *t, unsigned int index);
 // sync.h
 extern void _destroySyncCache(struct SyncCache *cache);
 
+// zalloc
+extern void _destroyZoneMagazines(struct ZoneMagazines *mags);
+
+// cache
+#if CONFIG_CACHE_EPOCHS
+extern void _destroyCacheReader(struct CacheReaderThread *reader);
+#endif
+
 // arr
 extern void arr_init(void);
+extern void _destroyPoolPageStash(void *stash);
 extern id objc_autoreleaseReturnValue(id obj);
 
 // block trampolines
@@ -748,11 +809,12 @@ extern "C" void map_images(unsigned count, const char * const paths[],
                            const struct mach_header * const mhdrs[]);
 extern void map_images_nolock(unsigned count, const char * const paths[],
                               const struct mach_header * const mhdrs[],
+                              size_t earlySelrefs,
                               bool *disabledClassROEnforcement);
 extern void load_images(const char *path, const struct mach_header *mh);
 extern void unmap_image(const char *path, const struct mach_header *mh);
 extern void unmap_image_nolock(const struct mach_header *mh);
-extern void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int unoptimizedTotalClass);
+extern void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int unoptimizedTotalClass, size_t earlySelrefs);
 extern void _unload_image(header_info *hi);
 
 extern const header_info *_headerForClass(Class cls);
@@ -124,6 +124,10 @@ public:
 
     T *get() const { return auth(ptr, &ptr); }
 
+    // Authenticate a value that was loaded from the WrappedPtr at addr
+    // by other means, such as a single racy load of an enclosing union.
+    static T *getLoaded(T *p, const void *addr) { return auth(p, addr); }
+
     // When asserts are enabled, ensure that we can read a byte from
     // the underlying pointer. This can be used to catch ptrauth
     // errors early for easier debugging.
@@ -42,7 +42,7 @@ enum {
     OBJC_ASSOCIATION_SYSTEM_OBJECT      = _OBJC_ASSOCIATION_SYSTEM_OBJECT, // 1 << 16
 };
 
-spinlock_t AssociationsManagerLock;
+StripedMap<spinlock_t> AssociationsLocks;
 
 namespace objc {
 
@@ -99,23 +99,287 @@ public:
     }
 };
 
-typedef DenseMap<const void *, ObjcAssociation> ObjectAssociationMap;
+// The associations of one object. The first CONFIG_ASSOCIATIONS_INLINE 
+// keys are kept in a small array searched linearly. When more are 
+// added, all of them move to a DenseMap allocated for this object. 
+// With OBJC_DISABLE_INLINE_ASSOCIATIONS every key goes to the DenseMap.
+class ObjectAssociationMap {
+    using Map = DenseMap<const void *, ObjcAssociation>;
+    enum { InlineCount = CONFIG_ASSOCIATIONS_INLINE };
+    static_assert(InlineCount >= 1  &&  InlineCount <= 4,
+                  "CONFIG_ASSOCIATIONS_INLINE must be 1 to 4");
+
+    struct Entry {
+        const void *key;
+        ObjcAssociation association;
+    };
+
+    Map *_map;
+    uint32_t _count;  // inline entries in use, when _map is nil
+    Entry _inline[InlineCount];
+
+    int inlineIndex(const void *key) const {
+        for (uint32_t i = 0; i < _count; i++) {
+            if (_inline[i].key == key) return (int)i;
+        }
+        return -1;
+    }
+
+    void moveToMap() {
+        _map = new Map();
+        for (uint32_t i = 0; i < _count; i++) {
+            _map->try_emplace(_inline[i].key, std::move(_inline[i].association));
+        }
+        _count = 0;
+    }
+
+public:
+    ObjectAssociationMap() : _map(nil), _count(0), _inline{} {}
+    ObjectAssociationMap(const ObjectAssociationMap &other) = delete;
+    ObjectAssociationMap(ObjectAssociationMap &&other) : ObjectAssociationMap() {
+        swap(other);
+    }
+    ObjectAssociationMap &operator=(ObjectAssociationMap &&other) {
+        swap(other);
+        return *this;
+    }
+    ~ObjectAssociationMap() { delete _map; }
+
+    void swap(ObjectAssociationMap &other) {
+        std::swap(_map, other._map);
+        std::swap(_count, other._count);
+        for (int i = 0; i < InlineCount; i++) {
+            std::swap(_inline[i].key, other._inline[i].key);
+            _inline[i].association.swap(other._inline[i].association);
+        }
+    }
+
+    size_t size() const { return _map ? _map->size() : _count; }
+
+    ObjcAssociation *find(const void *key) {
+        if (_map) {
+            auto it = _map->find(key);
+            return it != _map->end() ? &it->second : nil;
+        }
+        int i = inlineIndex(key);
+        return i >= 0 ? &_inline[i].association : nil;
+    }
+
+    // Adds association for key, leaving association empty, and returns 
+    // {the stored association, true}. If key is already present, 
+    // returns {the existing association, false} and changes nothing.
+    std::pair<ObjcAssociation *, bool>
+    try_emplace(const void *key, ObjcAssociation &&association) {
+        if (ObjcAssociation *existing = find(key)) return {existing, false};
+        if (!_map  &&  _count < InlineCount  &&  !DisableInlineAssociations) {
+            Entry &entry = _inline[_count++];
+            entry.key = key;
+            entry.association.swap(association);
+            return {&entry.association, true};
+        }
+        if (!_map) moveToMap();
+        auto result = _map->try_emplace(key, std::move(association));
+        return {&result.first->second, true};
+    }
+
+    // Removes key, swapping its association into association.
+    // Returns false if key is not present.
+    bool take(const void *key, ObjcAssociation &association) {
+        if (_map) {
+            auto it = _map->find(key);
+            if (it == _map->end()) return false;
+            association.swap(it->second);
+            _map->erase(it);
+            return true;
+        }
+        int i = inlineIndex(key);
+        if (i < 0) return false;
+        association.swap(_inline[i].association);
+        Entry &last = _inline[--_count];
+        if (&last != &_inline[i]) {
+            _inline[i].key = last.key;
+            _inline[i].association.swap(last.association);
+        }
+        last.key = nil;
+        last.association = ObjcAssociation{};
+        return true;
+    }
+
+    template<typename F>
+    void forEach(F f) {
+        if (_map) {
+            for (auto &pair : *_map) f(pair.first, pair.second);
+        } else {
+            for (uint32_t i = 0; i < _count; i++) {
+                f(_inline[i].key, _inline[i].association);
+            }
+        }
+    }
+};
+
 typedef DenseMap<DisguisedPtr<objc_object>, ObjectAssociationMap> AssociationsHashMap;
 
-// class AssociationsManager manages a lock / hash table singleton pair.
-// Allocating an instance acquires the lock
+#if CONFIG_ASSOCIATIONS_READ_CACHE
+
+/***********************************************************************
+* AssociationsReadCache
+* Recently read associations whose getter neither retains nor 
+* autoreleases, readable without the stripe lock. 
+* Writers hold the stripe lock and make seq odd while they change an 
+* entry. Readers copy an entry and use it only if seq was even and 
+* unchanged around the copy. The entries are never freed, unlike the 
+* buckets of AssociationsHashMap, so a reader racing with a writer 
+* reads stale words at worst.
+* Entries are filled by locked gets, updated or cleared by sets, and 
+* cleared for an object when its associations are removed, so a 
+* deallocated object's address never finds its old values.
+**********************************************************************/
+class AssociationsReadCache {
+    enum { EntryCount = CONFIG_ASSOCIATIONS_READ_CACHE };
+    static_assert((EntryCount & (EntryCount - 1)) == 0, 
+                  "CONFIG_ASSOCIATIONS_READ_CACHE must be a power of two");
+
+    struct Entry {
+        std::atomic<uintptr_t> object;
+        std::atomic<uintptr_t> key;
+        std::atomic<uintptr_t> value;
+    };
+
+    std::atomic<uintptr_t> _seq;
+    Entry _entries[EntryCount];
+
+    static unsigned indexFor(const void *object, const void *key) {
+        return ptr_hash((uintptr_t)object ^ ((uintptr_t)key << 1)) & (EntryCount - 1);
+    }
+
+    void beginWrite() {
+        _seq.store(_seq.load(std::memory_order_relaxed) + 1, 
+                   std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void endWrite() {
+        _seq.store(_seq.load(std::memory_order_relaxed) + 1, 
+                   std::memory_order_release);
+    }
+
+    void write(Entry &entry, const void *object, const void *key, id value) {
+        entry.object.store((uintptr_t)object, std::memory_order_relaxed);
+        entry.key.store((uintptr_t)key, std::memory_order_relaxed);
+        entry.value.store((uintptr_t)value, std::memory_order_relaxed);
+    }
+
+public:
+    AssociationsReadCache() : _seq(0), _entries{} {}
+
+    static bool cacheable(uintptr_t policy) {
+        return (policy & (OBJC_ASSOCIATION_GETTER_RETAIN | 
+                          OBJC_ASSOCIATION_GETTER_AUTORELEASE)) == 0;
+    }
+
+    // Returns true and sets *value if object and key are cached.
+    // The stripe lock need not be held.
+    bool read(const void *object, const void *key, id *value) {
+        uintptr_t seq = _seq.load(std::memory_order_acquire);
+        if (seq & 1) return false;
+
+        Entry &entry = _entries[indexFor(object, key)];
+        uintptr_t cachedObject = entry.object.load(std::memory_order_relaxed);
+        uintptr_t cachedKey = entry.key.load(std::memory_order_relaxed);
+        uintptr_t cachedValue = entry.value.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_seq.load(std::memory_order_relaxed) != seq) return false;
+
+        if (cachedObject != (uintptr_t)object  ||  cachedKey != (uintptr_t)key) {
+            return false;
+        }
+        *value = (id)cachedValue;
+        return true;
+    }
+
+    // Locking: the stripe lock must be held by the writing functions.
+
+    void fill(const void *object, const void *key, const ObjcAssociation &association) {
+        if (!cacheable(association.policy())) return;
+        beginWrite();
+        write(_entries[indexFor(object, key)], object, key, association.value());
+        endWrite();
+    }
+
+    // Forget object/key if cached, after a set or a removal.
+    void clear(const void *object, const void *key) {
+        Entry &entry = _entries[indexFor(object, key)];
+        if (entry.object.load(std::memory_order_relaxed) != (uintptr_t)object  ||
+            entry.key.load(std::memory_order_relaxed) != (uintptr_t)key) 
+        {
+            return;
+        }
+        beginWrite();
+        write(entry, nil, nil, nil);
+        endWrite();
+    }
+
+    // Forget every key of object.
+    void clear(const void *object) {
+        bool writing = false;
+        for (auto &entry : _entries) {
+            if (entry.object.load(std::memory_order_relaxed) != (uintptr_t)object) {
+                continue;
+            }
+            if (!writing) {
+                beginWrite();
+                writing = true;
+            }
+            write(entry, nil, nil, nil);
+        }
+        if (writing) endWrite();
+    }
+};
+
+#endif
+
+// The associations of the objects in one stripe.
+struct AssociationsStripe {
+    AssociationsHashMap map;
+#if CONFIG_ASSOCIATIONS_READ_CACHE
+    AssociationsReadCache cache;
+#endif
+};
+
+// class AssociationsManager manages the lock / hash table pair 
+// of one stripe. Allocating an instance acquires the lock of the 
+// stripe that holds the object's associations.
 
 class AssociationsManager {
-    using Storage = ExplicitInitDenseMap<DisguisedPtr<objc_object>, ObjectAssociationMap>;
+    using Storage = ExplicitInit<StripedMap<AssociationsStripe>>;
     static Storage _mapStorage;
 
+    spinlock_t &_lock;
+    AssociationsStripe &_stripe;
+
 public:
-    AssociationsManager()   { AssociationsManagerLock.lock(); }
-    ~AssociationsManager()  { AssociationsManagerLock.unlock(); }
+    AssociationsManager(const void *object)
+        : _lock(AssociationsLocks[object]), _stripe(_mapStorage.get()[object])
+    {
+        _lock.lock();
+    }
+    ~AssociationsManager()  { _lock.unlock(); }
 
     AssociationsHashMap &get() {
-        return _mapStorage.get();
+        return _stripe.map;
+    }
+
+#if CONFIG_ASSOCIATIONS_READ_CACHE
+    AssociationsReadCache &cache() {
+        return _stripe.cache;
+    }
+
+    // Reads without the lock.
+    static AssociationsReadCache &cacheFor(const void *object) {
+        return _mapStorage.get()[object].cache;
     }
+#endif
 
     static void init() {
         _mapStorage.init();
@@ -139,16 +403,27 @@ _object_get_associative_reference(id object, const void *key)
 {
     ObjcAssociation association{};
 
+#if CONFIG_ASSOCIATIONS_READ_CACHE
+    // Associations whose getter does not retain are often read 
+    // in loops. Try the stripe's read cache before taking the lock.
+    id cachedValue;
+    if (AssociationsManager::cacheFor(object).read(object, key, &cachedValue)) {
+        return cachedValue;
+    }
+#endif
+
     {
-        AssociationsManager manager;
+        AssociationsManager manager{object};
         AssociationsHashMap &associations(manager.get());
         AssociationsHashMap::iterator i = associations.find((objc_object *)object);
         if (i != associations.end()) {
             ObjectAssociationMap &refs = i->second;
-            ObjectAssociationMap::iterator j = refs.find(key);
-            if (j != refs.end()) {
-                association = j->second;
+            if (ObjcAssociation *found = refs.find(key)) {
+                association = *found;
                 association.retainReturnedValue();
+#if CONFIG_ASSOCIATIONS_READ_CACHE
+                manager.cache().fill(object, key, association);
+#endif
             }
         }
     }
@@ -175,8 +450,11 @@ _object_set_associative_reference(id object, const void *key, id value, uintptr_
 
     bool isFirstAssociation = false;
     {
-        AssociationsManager manager;
+        AssociationsManager manager{object};
         AssociationsHashMap &associations(manager.get());
+#if CONFIG_ASSOCIATIONS_READ_CACHE
+        manager.cache().clear(object, key);
+#endif
 
         if (value) {
             auto refs_result = associations.try_emplace(disguised, ObjectAssociationMap{});
@@ -189,16 +467,13 @@ _object_set_associative_reference(id object, const void *key, id value, uintptr_
             auto &refs = refs_result.first->second;
             auto result = refs.try_emplace(key, std::move(association));
             if (!result.second) {
-                association.swap(result.first->second);
+                association.swap(*result.first);
             }
         } else {
             auto refs_it = associations.find(disguised);
             if (refs_it != associations.end()) {
                 auto &refs = refs_it->second;
-                auto it = refs.find(key);
-                if (it != refs.end()) {
-                    association.swap(it->second);
-                    refs.erase(it);
+                if (refs.take(key, association)) {
                     if (refs.size() == 0) {
                         associations.erase(refs_it);
 
@@ -229,8 +504,12 @@ _object_remove_associations(id object, bool deallocating)
     ObjectAssociationMap refs{};
 
     {
-        AssociationsManager manager;
+        // Only the stripe that holds this object's associations is locked.
+        AssociationsManager manager{object};
         AssociationsHashMap &associations(manager.get());
+#if CONFIG_ASSOCIATIONS_READ_CACHE
+        manager.cache().clear(object);
+#endif
         AssociationsHashMap::iterator i = associations.find((objc_object *)object);
         if (i != associations.end()) {
             refs.swap(i->second);
@@ -238,12 +517,12 @@ _object_remove_associations(id object, bool deallocating)
             // If we are not deallocating, then SYSTEM_OBJECT associations are preserved.
             bool didReInsert = false;
             if (!deallocating) {
-                for (auto &ref: refs) {
-                    if (ref.second.policy() & OBJC_ASSOCIATION_SYSTEM_OBJECT) {
-                        i->second.insert(ref);
+                refs.forEach([&](const void *key, ObjcAssociation &association) {
+                    if (association.policy() & OBJC_ASSOCIATION_SYSTEM_OBJECT) {
+                        i->second.try_emplace(key, ObjcAssociation{association});
                         didReInsert = true;
                     }
-                }
+                });
             }
             if (!didReInsert)
                 associations.erase(i);
@@ -254,15 +533,15 @@ _object_remove_associations(id object, bool deallocating)
     SmallVector<ObjcAssociation *, 4> laterRefs;
 
     // release everything (outside of the lock).
-    for (auto &i: refs) {
-        if (i.second.policy() & OBJC_ASSOCIATION_SYSTEM_OBJECT) {
+    refs.forEach([&](const void *, ObjcAssociation &association) {
+        if (association.policy() & OBJC_ASSOCIATION_SYSTEM_OBJECT) {
             // If we are not deallocating, then RELEASE_LATER associations don't get released.
             if (deallocating)
-                laterRefs.append(&i.second);
+                laterRefs.append(&association);
         } else {
-            i.second.releaseHeldValue();
+            association.releaseHeldValue();
         }
-    }
+    });
     for (auto *later: laterRefs) {
         later->releaseHeldValue();
     }
@@ -80,8 +80,9 @@
 #define RW_CONSTRUCTING       (1<<26)
 // class allocated and registered
 #define RW_CONSTRUCTED        (1<<25)
-// available for use; was RW_FINALIZE_ON_MAIN_THREAD
-// #define RW_24 (1<<24)
+// class's method lists were searched once since they last changed
+// (was RW_FINALIZE_ON_MAIN_THREAD)
+#define RW_METHOD_INDEX_PENDING (1<<24)
 // class +load has been called
 #define RW_LOADED             (1<<23)
 #if !SUPPORT_NONPOINTER_ISA
@@ -95,6 +96,9 @@
 // class has started realizing but not yet completed it
 #define RW_REALIZING          (1<<19)
 
+// class has categories in lazyCategories not yet attached to it
+#define RW_LAZY_CATEGORIES    (1<<12)
+
 #if CONFIG_USE_PREOPT_CACHES
 // this class and its descendants can't have preopt caches with inlined sels
 #define RW_NOPREOPT_SELS      (1<<2)
@@ -283,6 +287,16 @@ public:
 
     template <Atomicity, IMPEncoding>
     void set(bucket_t *base, SEL newSel, IMP newImp, Class cls);
+
+#if __arm64__
+    // Robin-Hood inserts move entries within one set of buckets. The
+    // IMP encoding depends on the buckets but not on the bucket, so an
+    // entry moves with its encoded IMP.
+    uintptr_t encodedImpFor(bucket_t *base, SEL newSel, IMP newImp, Class cls) const {
+        return encodeImp(base, newImp, newSel, cls);
+    }
+    void exchange(uintptr_t &imp, SEL &sel);
+#endif
 };
 
 /* dyld_shared_cache_builder and obj-C agree on these definitions */
@@ -451,9 +465,13 @@ private:
 #endif
 
     void incrementOccupied();
+    void addOccupied(mask_t count);
     void setBucketsAndMask(struct bucket_t *newBuckets, mask_t newMask);
 
     void reallocate(mask_t oldCapacity, mask_t newCapacity, bool freeOld);
+#if CACHE_ROBIN_HOOD
+    void insertRobinHood(mask_t capacity, SEL sel, IMP imp);
+#endif
     void collect_free(bucket_t *oldBuckets, mask_t oldCapacity);
 
     static bucket_t *emptyBuckets();
@@ -495,12 +513,16 @@ public:
 #endif
 
     void insert(SEL sel, IMP imp, id receiver);
+    IMP lookup(SEL sel, mask_t *outProbes = nil) const;
     void copyCacheNolock(objc_imp_cache_entry *buffer, int len);
     void destroy();
     void eraseNolock(const char *func);
 
     static void init();
     static void collectNolock(bool collectALot);
+    static void threadQuiescent();
+    static void threadOffline();
+    static void threadOnline();
     static size_t bytesForCapacity(uint32_t cap);
 
 #if CACHE_T_HAS_FLAGS
@@ -1457,6 +1479,12 @@ struct class_ro_t {
 };
 
 
+// Frees an array replaced by list_array_tt::attachLists().
+// Lock-free method lookups may still be walking it, so the free
+// is deferred until none of them is in flight.
+// Locking: runtimeLock must be held by the caller.
+extern void retireListArray(void *array);
+
 /***********************************************************************
 * list_array_tt<Element, List, Ptr>
 * Generic implementation for metadata that can be augmented by categories.
@@ -1564,7 +1592,8 @@ class list_array_tt {
     }
 
     void setArray(array_t *array) {
-        arrayAndFlag = (uintptr_t)array | 1;
+        // Release so lock-free readers see the array's contents.
+        __atomic_store_n(&arrayAndFlag, (uintptr_t)array | 1, __ATOMIC_RELEASE);
     }
 
     void validate() {
@@ -1588,6 +1617,18 @@ class list_array_tt {
         return *this;
     }
 
+    // Copy other without holding the lock that protects it.
+    // The list-or-array word is read exactly once, so a concurrent
+    // attachLists() is seen either completely or not at all.
+    void loadUnlocked(const list_array_tt &other) {
+        uintptr_t bits = __atomic_load_n(&other.arrayAndFlag, __ATOMIC_ACQUIRE);
+        if (bits & 1) {
+            arrayAndFlag = bits;
+        } else {
+            list = Ptr<List>::getLoaded((List *)bits, &other.list);
+        }
+    }
+
     uint32_t count() const {
         uint32_t result = 0;
         for (auto lists = beginLists(), end = endLists();
@@ -1654,35 +1695,39 @@ class list_array_tt {
 
         if (hasArray()) {
             // many lists -> many lists
-            uint32_t oldCount = array()->count;
+            // The old array is left intact for lock-free readers.
+            array_t *oldArray = array();
+            uint32_t oldCount = oldArray->count;
             uint32_t newCount = oldCount + addedCount;
             array_t *newArray = (array_t *)malloc(array_t::byteSize(newCount));
             newArray->count = newCount;
-            array()->count = newCount;
 
             for (int i = oldCount - 1; i >= 0; i--)
-                newArray->lists[i + addedCount] = array()->lists[i];
+                newArray->lists[i + addedCount] = oldArray->lists[i];
             for (unsigned i = 0; i < addedCount; i++)
                 newArray->lists[i] = addedLists[i];
-            free(array());
             setArray(newArray);
+            retireListArray(oldArray);
             validate();
         }
         else if (!list  &&  addedCount == 1) {
             // 0 lists -> 1 list
+            std::atomic_thread_fence(std::memory_order_release);
             list = addedLists[0];
             validate();
         }
         else {
             // 1 list -> many lists
+            // Fill the new array before publishing it.
             Ptr<List> oldList = list;
             uint32_t oldCount = oldList ? 1 : 0;
             uint32_t newCount = oldCount + addedCount;
-            setArray((array_t *)malloc(array_t::byteSize(newCount)));
-            array()->count = newCount;
-            if (oldList) array()->lists[addedCount] = oldList;
+            array_t *newArray = (array_t *)malloc(array_t::byteSize(newCount));
+            newArray->count = newCount;
+            if (oldList) newArray->lists[addedCount] = oldList;
             for (unsigned i = 0; i < addedCount; i++)
-                array()->lists[i] = addedLists[i];
+                newArray->lists[i] = addedLists[i];
+            setArray(newArray);
             validate();
         }
     }
@@ -1756,6 +1801,77 @@ class protocol_array_t :
     protocol_array_t(protocol_list_t *l) : Super(l) { }
 };
 
+// A small direct-mapped set of selectors that a class is known not to
+// implement. LOOKUP_NIL lookups record their misses here instead of
+// caching _objc_msgForward_impcache, so respondsToSelector: probes do
+// not grow the method cache.
+// Written under runtimeLock and read without it. flushCaches() clears it.
+struct negative_sel_cache_t {
+    static constexpr unsigned count = 16;
+    std::atomic<SEL> sels[count];
+
+    static unsigned indexFor(SEL sel) {
+        uintptr_t value = (uintptr_t)sel;
+        return (unsigned)(value ^ (value >> 7)) & (count - 1);
+    }
+
+    bool contains(SEL sel) const {
+        return sels[indexFor(sel)].load(std::memory_order_relaxed) == sel;
+    }
+
+    void insert(SEL sel) {
+        sels[indexFor(sel)].store(sel, std::memory_order_relaxed);
+    }
+
+    void clear() {
+        for (unsigned i = 0; i < count; i++) {
+            sels[i].store(nil, std::memory_order_relaxed);
+        }
+    }
+};
+
+// All methods of a class with many method lists, sorted by selector
+// address. Each selector maps to the method that a search of the
+// method lists in order would find first, so category overrides win.
+// Built under runtimeLock on the second search after the method lists
+// change, and read without it. Discarded when a list is attached.
+struct method_index_t {
+    struct entry_t {
+        SEL sel;
+        method_t *meth;
+    };
+    uint32_t count;
+    uint32_t listCount;              // method lists merged into this index
+    std::atomic<uintptr_t> lookups;  // counted only with PrintConnecting
+    entry_t entries[0];
+
+    static size_t byteSize(uint32_t count) {
+        return sizeof(method_index_t) + count * sizeof(entry_t);
+    }
+
+    method_t *find(SEL sel) const {
+        uintptr_t key = (uintptr_t)sel;
+        const entry_t *base = entries;
+        for (uint32_t n = count; n != 0; n >>= 1) {
+            const entry_t *probe = base + (n >> 1);
+            uintptr_t value = (uintptr_t)probe->sel;
+            if (key == value) return probe->meth;
+            if (key > value) {
+                base = probe + 1;
+                n--;
+            }
+        }
+        return nil;
+    }
+};
+
+// Lookup caches of a class with a class_rw_ext_t. They live out of
+// line so that class_rw_ext_t stays small enough for a packed zone.
+// Allocated on first use and freed with the class.
+struct class_rw_ext_caches_t {
+    std::atomic<method_index_t *> methodIndex;
+};
+
 struct class_rw_ext_t {
     DECLARE_AUTHED_PTR_TEMPLATE(class_ro_t)
     class_ro_t_authed_ptr<const class_ro_t> ro;
@@ -1764,6 +1880,22 @@ struct class_rw_ext_t {
     protocol_array_t protocols;
     const char *demangledName;
     uint32_t version;
+    // Set once with runtimeLock held, read without it.
+    std::atomic<class_rw_ext_caches_t *> caches;
+
+    class_rw_ext_caches_t *getCaches() const {
+        return caches.load(std::memory_order_acquire);
+    }
+
+    // Locking: runtimeLock must be held by the caller.
+    class_rw_ext_caches_t *cachesAllocIfNeeded() {
+        auto result = caches.load(std::memory_order_relaxed);
+        if (!result) {
+            result = (class_rw_ext_caches_t *)calloc(1, sizeof(*result));
+            caches.store(result, std::memory_order_release);
+        }
+        return result;
+    }
 };
 
 struct class_rw_t {
@@ -1865,6 +1997,18 @@ public:
         }
     }
 
+    // Like methods(), for readers that do not hold runtimeLock.
+    const method_array_t methodsUnlocked() const {
+        auto v = get_ro_or_rwe();
+        if (v.is<class_rw_ext_t *>()) {
+            method_array_t result;
+            result.loadUnlocked(v.get<class_rw_ext_t *>(&ro_or_rw_ext)->methods);
+            return result;
+        } else {
+            return method_array_t{v.get<const class_ro_t *>(&ro_or_rw_ext)->baseMethods};
+        }
+    }
+
     const property_array_t properties() const {
         auto v = get_ro_or_rwe();
         if (v.is<class_rw_ext_t *>()) {
@@ -34,6 +34,7 @@
 #include "objc-file.h"
 #include "objc-zalloc.h"
 #include <Block.h>
+#include <dispatch/dispatch.h>
 #include <objc/message.h>
 
 #include <mach/shared_region.h>
@@ -61,6 +62,9 @@ static void fixupMessageRef(message_ref_t *msg);
 #endif
 static Class realizeClassMaybeSwiftAndUnlock(Class cls, mutex_t& lock);
 static Class readClass(Class cls, bool headerIsBundle, bool headerIsPreoptimized);
+#if CONFIG_PARALLEL_SELREF_MIN
+static size_t fixupSelectorRefsInParallel(unsigned mhCount, const struct mach_header * const mhdrs[]);
+#endif
 
 struct locstamped_category_t {
     category_t *cat;
@@ -85,6 +89,415 @@ mutex_t cacheUpdateLock;
 #endif
 recursive_mutex_t loadMethodLock;
 
+
+/***********************************************************************
+* Lock-free method lookup
+* lookUpImpOrForward searches the method lists of initialized classes
+* without holding runtimeLock. Every change that can alter the result
+* of such a search bumps methodLookupGeneration under runtimeLock.
+* The searcher then takes runtimeLock to fill the cache, and redoes the
+* search with the lock held if the generation moved in the meantime.
+*
+* Method list arrays replaced by attachLists() may still be walked by
+* lock-free searchers, so they are kept on a garbage list until the
+* per-stripe reader counts show that no search is in flight.
+**********************************************************************/
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+namespace objc {
+
+static std::atomic<uintptr_t> methodLookupGeneration;
+
+struct LockFreeLookupReaders {
+    std::atomic<uintptr_t> count;
+};
+static ExplicitInit<StripedMap<LockFreeLookupReaders>> lockFreeLookupReadersMap;
+
+// Marks the current thread as searching method lists without the lock.
+class LockFreeLookupScope {
+    std::atomic<uintptr_t> &count;
+
+public:
+    LockFreeLookupScope()
+        : count(lockFreeLookupReadersMap.get()[(const void *)objc_thread_self()].count)
+    {
+        // seq_cst pairs with the load in lockFreeLookupInFlight():
+        // either the writer sees this reader, or this reader sees
+        // the writer's new method list array.
+        count.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    ~LockFreeLookupScope() {
+        count.fetch_sub(1, std::memory_order_release);
+    }
+};
+
+static bool lockFreeLookupInFlight()
+{
+    // The caller unpublished a method list array with a release store,
+    // which may still be buffered when the counts below are loaded.
+    // Without a full fence this thread could see a zero count while a
+    // reader that has just counted itself still loads the old array.
+    // The fence pairs with the seq_cst increment in LockFreeLookupScope.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool inFlight = false;
+    lockFreeLookupReadersMap.get().forEach([&](LockFreeLookupReaders &readers) {
+        if (readers.count.load(std::memory_order_seq_cst) != 0) inFlight = true;
+    });
+    return inFlight;
+}
+
+// Retired method list arrays. Protected by runtimeLock.
+static void **retiredListArrays;
+static size_t retiredListArrayCount;
+static size_t retiredListArrayCapacity;
+
+static void reclaimRetiredListArrays()
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+    if (retiredListArrayCount == 0  ||  lockFreeLookupInFlight()) return;
+
+    for (size_t i = 0; i < retiredListArrayCount; i++) {
+        free(retiredListArrays[i]);
+    }
+    retiredListArrayCount = 0;
+}
+
+// Called after any change that can alter the result of a method search.
+static void methodLookupChanged()
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+    methodLookupGeneration.fetch_add(1, std::memory_order_release);
+    reclaimRetiredListArrays();
+}
+
+} // namespace objc
+#endif
+
+void retireListArray(void *array)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+    using namespace objc;
+
+    if (!DisableLockFreeLookup) {
+        if (retiredListArrayCount == retiredListArrayCapacity) {
+            retiredListArrayCapacity = retiredListArrayCapacity ? retiredListArrayCapacity * 2 : 16;
+            retiredListArrays = (void **)
+                realloc(retiredListArrays, retiredListArrayCapacity * sizeof(void *));
+        }
+        retiredListArrays[retiredListArrayCount++] = array;
+        reclaimRetiredListArrays();
+        return;
+    }
+#endif
+
+    free(array);
+}
+
+
+/***********************************************************************
+* discardMethodIndex
+* Forget cls's merged method index after its method lists changed.
+* The index may still be read by lock-free searches, so it is retired
+* like a method list array.
+* Locking: runtimeLock must be held by the caller.
+**********************************************************************/
+static void discardMethodIndex(Class cls, class_rw_ext_t *rwe)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+#if CONFIG_METHOD_INDEX_MIN_LISTS
+    cls->data()->clearFlags(RW_METHOD_INDEX_PENDING);
+
+    auto caches = rwe->getCaches();
+    if (!caches) return;
+    method_index_t *index = caches->methodIndex.load(std::memory_order_relaxed);
+    if (!index) return;
+
+    if (slowpath(PrintConnecting)) {
+        _objc_inform("METHOD INDEX: discarding index of class '%s'%s after "
+                     "%lu lookups, each instead of a search of %u method lists",
+                     cls->nameForLogging(), cls->isMetaClass() ? " (meta)" : "",
+                     (unsigned long)index->lookups.load(std::memory_order_relaxed),
+                     index->listCount);
+    }
+    caches->methodIndex.store(nil, std::memory_order_release);
+    retireListArray(index);
+#endif
+}
+
+
+/***********************************************************************
+* Protocol conformance closures
+* class_conformsToProtocol() answers from a cached closure of the
+* protocols a class adopts, directly or through other protocols.
+* Closures live in a set-associative table indexed by class and are
+* read without runtimeLock. A closure that is discarded or evicted may
+* still be read, so it is retired like a method list array.
+*
+* Readers mark the closures they use. A class that misses in a full set
+* evicts the first closure not used since the set was last searched for
+* a victim, and clears the marks it passes. If every closure in the set
+* was used, nothing is evicted and the class is searched without a
+* closure. Hot classes that hash alike therefore keep their closures
+* instead of rebuilding each other's on every call.
+**********************************************************************/
+struct protocol_closure_t {
+    struct name_t {
+        uint64_t hash;
+        const char *mangledName;
+    };
+
+    Class cls;
+    uint32_t count;
+    std::atomic<bool> used;  // read since the set was searched for a victim
+    uint64_t bloom;  // two bits for each name hash
+
+    // count canonical protocols sorted by address,
+    // followed by their names sorted by hash
+    protocol_t *protocols[0];
+
+    name_t *names() { return (name_t *)(protocols + count); }
+    const name_t *names() const { return (const name_t *)(protocols + count); }
+
+    static size_t byteSize(uint32_t count) {
+        return sizeof(protocol_closure_t)
+            + count * (sizeof(protocol_t *) + sizeof(name_t));
+    }
+
+    static uint64_t bloomBits(uint64_t hash) {
+        return (1ULL << (hash & 63)) | (1ULL << ((hash >> 6) & 63));
+    }
+};
+
+#if CONFIG_PROTOCOL_CLOSURE_CACHE_SIZE
+struct protocol_closure_set_t {
+    enum { ways = CONFIG_PROTOCOL_CLOSURE_CACHE_WAYS };
+    std::atomic<protocol_closure_t *> slots[ways];
+    uint32_t hand;  // next slot to consider for eviction; runtimeLock
+
+    // Lock-free if order is acquire.
+    protocol_closure_t *find(Class cls, std::memory_order order) {
+        for (unsigned i = 0; i < ways; i++) {
+            protocol_closure_t *closure = slots[i].load(order);
+            if (closure  &&  closure->cls == cls) return closure;
+        }
+        return nil;
+    }
+};
+
+static_assert(CONFIG_PROTOCOL_CLOSURE_CACHE_SIZE % CONFIG_PROTOCOL_CLOSURE_CACHE_WAYS == 0,
+              "protocol closure cache size must be a multiple of its ways");
+
+static protocol_closure_set_t
+    protocolClosures[CONFIG_PROTOCOL_CLOSURE_CACHE_SIZE / CONFIG_PROTOCOL_CLOSURE_CACHE_WAYS];
+
+static protocol_closure_set_t &protocolClosureSet(Class cls)
+{
+    return protocolClosures[ptr_hash((uintptr_t)cls) % countof(protocolClosures)];
+}
+
+// Marks closure used. Most calls only read the mark.
+static ALWAYS_INLINE void useProtocolClosure(protocol_closure_t *closure)
+{
+    if (!closure->used.load(std::memory_order_relaxed)) {
+        closure->used.store(true, std::memory_order_relaxed);
+    }
+}
+#endif
+
+/***********************************************************************
+* discardProtocolClosure
+* Forget cls's protocol closure after its protocols changed or
+* the class was freed.
+* Locking: runtimeLock must be held by the caller.
+**********************************************************************/
+static void discardProtocolClosure(Class cls)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+#if CONFIG_PROTOCOL_CLOSURE_CACHE_SIZE
+    for (auto &slot : protocolClosureSet(cls).slots) {
+        protocol_closure_t *closure = slot.load(std::memory_order_relaxed);
+        if (closure  &&  closure->cls == cls) {
+            slot.store(nil, std::memory_order_release);
+            retireListArray(closure);
+        }
+    }
+#endif
+}
+
+/***********************************************************************
+* discardAllProtocolClosures
+* Forget every protocol closure, because protocols were added or
+* removed and any closure may name the wrong ones.
+* Locking: runtimeLock must be held by the caller.
+**********************************************************************/
+static void discardAllProtocolClosures()
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+#if CONFIG_PROTOCOL_CLOSURE_CACHE_SIZE
+    for (auto &set : protocolClosures) {
+        for (auto &slot : set.slots) {
+            protocol_closure_t *closure = slot.load(std::memory_order_relaxed);
+            if (closure) {
+                slot.store(nil, std::memory_order_release);
+                retireListArray(closure);
+            }
+        }
+    }
+#endif
+}
+
+/***********************************************************************
+* Negative selector caches
+* The negative_sel_cache_t of every class that has one is found through
+* a linear-probed table keyed by class, so any realized class can have
+* one without a class_rw_ext_t. Entries are added and erased under
+* runtimeLock and read without it. An erased entry stays as a tombstone
+* until the table is rebuilt, so a reader never misses a live entry.
+* A table replaced by a rebuild, and the cache of an erased entry, may
+* still be read, so they are retired like method list arrays.
+**********************************************************************/
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+struct negative_sel_table_t {
+    enum : uintptr_t { Tombstone = 1 };
+    enum : uint32_t { InitialCapacity = 64 };
+
+    struct entry_t {
+        std::atomic<Class> cls;      // nil if empty, Tombstone if erased
+        negative_sel_cache_t *sels;  // set before cls is published
+    };
+
+    uint32_t mask;
+    uint32_t used;  // live entries and tombstones
+    uint32_t live;
+    entry_t entries[0];
+
+    static negative_sel_table_t *create(uint32_t capacity) {
+        auto table = (negative_sel_table_t *)
+            calloc(1, sizeof(negative_sel_table_t) + capacity * sizeof(entry_t));
+        table->mask = capacity - 1;
+        return table;
+    }
+
+    uint32_t capacity() const { return mask + 1; }
+
+    entry_t *slotFor(Class cls) {
+        uint32_t i = ptr_hash((uintptr_t)cls) & mask;
+        while (true) {
+            Class c = entries[i].cls.load(std::memory_order_relaxed);
+            if (c == nil  ||  c == cls) return &entries[i];
+            i = (i + 1) & mask;
+        }
+    }
+
+    // Lock-free if order is acquire.
+    negative_sel_cache_t *find(Class cls, std::memory_order order) const {
+        uint32_t i = ptr_hash((uintptr_t)cls) & mask;
+        while (true) {
+            Class c = entries[i].cls.load(order);
+            if (c == cls) return entries[i].sels;
+            if (c == nil) return nil;
+            i = (i + 1) & mask;
+        }
+    }
+};
+
+static std::atomic<negative_sel_table_t *> negativeSelTable;
+
+/***********************************************************************
+* negativeSelCacheForInsert
+* Returns cls's negative selector cache, adding one if it has none.
+* Locking: runtimeLock must be held by the caller.
+**********************************************************************/
+static negative_sel_cache_t *negativeSelCacheForInsert(Class cls)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+    auto table = negativeSelTable.load(std::memory_order_relaxed);
+    if (table) {
+        if (auto sels = table->find(cls, std::memory_order_relaxed)) return sels;
+    }
+
+    // Keep the table at most 3/4 full, tombstones included. Rebuild it
+    // at twice the size, or at the same size if tombstones filled it.
+    if (!table  ||  (table->used + 1) * 4 > table->capacity() * 3) {
+        uint32_t capacity = negative_sel_table_t::InitialCapacity;
+        if (table) {
+            capacity = table->capacity();
+            if ((table->live + 1) * 2 > capacity) capacity *= 2;
+        }
+        auto newTable = negative_sel_table_t::create(capacity);
+        if (table) {
+            for (uint32_t i = 0; i < table->capacity(); i++) {
+                auto &entry = table->entries[i];
+                Class c = entry.cls.load(std::memory_order_relaxed);
+                if (c == nil  ||  c == (Class)negative_sel_table_t::Tombstone) continue;
+                auto slot = newTable->slotFor(c);
+                slot->sels = entry.sels;
+                slot->cls.store(c, std::memory_order_relaxed);
+                newTable->used++;
+                newTable->live++;
+            }
+        }
+        negativeSelTable.store(newTable, std::memory_order_release);
+        if (table) retireListArray(table);
+        table = newTable;
+    }
+
+    auto sels = (negative_sel_cache_t *)calloc(1, sizeof(negative_sel_cache_t));
+    auto slot = table->slotFor(cls);
+    slot->sels = sels;
+    slot->cls.store(cls, std::memory_order_release);
+    table->used++;
+    table->live++;
+    return sels;
+}
+#endif
+
+/***********************************************************************
+* forgetMissingSels
+* Empties cls's negative selector cache after a method search result
+* may have changed.
+* Locking: runtimeLock must be held by the caller.
+**********************************************************************/
+static void forgetMissingSels(Class cls)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+    auto table = negativeSelTable.load(std::memory_order_relaxed);
+    if (!table) return;
+    if (auto sels = table->find(cls, std::memory_order_relaxed)) sels->clear();
+#endif
+}
+
+/***********************************************************************
+* discardMissingSels
+* Forget cls's negative selector cache because the class is freed.
+* Locking: runtimeLock must be held by the caller.
+**********************************************************************/
+static void discardMissingSels(Class cls)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+    auto table = negativeSelTable.load(std::memory_order_relaxed);
+    if (!table) return;
+    auto slot = table->slotFor(cls);
+    if (slot->cls.load(std::memory_order_relaxed) != cls) return;
+    slot->cls.store((Class)negative_sel_table_t::Tombstone, std::memory_order_release);
+    retireListArray(slot->sels);
+    table->live--;
+#endif
+}
+
 /***********************************************************************
 * Class structure decoding
 **********************************************************************/
@@ -674,7 +1087,7 @@ static unsigned unreasonableClassCount()
 {
     lockdebug::assert_locked(&runtimeLock);
 
-    int base = NXCountMapTable(gdb_objc_realized_classes) +
+    int base = namedClasses.count +
     getPreoptimizedClassUnreasonableCount();
 
     // Provide lots of slack here. Some iterations touch metaclasses too.
@@ -1282,8 +1695,107 @@ public:
 
 static UnattachedCategories unattachedCategories;
 
+// Categories loaded for classes that were realized but not yet used.
+// They are attached by attachLazyCategories().
+static UnattachedCategories lazyCategories;
+
 } // namespace objc
 
+// Protected by runtimeLock.
+static size_t lazyCategoriesDeferred;
+static size_t lazyCategoriesAttached;
+
+
+/***********************************************************************
+* deferCategory
+* Records category lc for realized class or metaclass cls, to be attached
+* when the class is first used instead of now. nonmeta is the class whose
+* +initialize marks it as used.
+* Returns false if the category must be attached now.
+* Locking: runtimeLock must be held by the caller
+**********************************************************************/
+static bool
+deferCategory(locstamped_category_t lc, Class cls, Class nonmeta)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+    if (DisableLazyCategories) return false;
+    // Initialized classes are searched without the lock, and
+    // setInitialized() is where their deferred categories are attached.
+    if (!nonmeta->isRealized()  ||  !nonmeta->ISA()->isRealized()) return false;
+    if (nonmeta->isInitialized()  ||  nonmeta->isInitializing()) return false;
+
+    objc::lazyCategories.addForClass(lc, cls);
+    cls->data()->setFlags(RW_LAZY_CATEGORIES);
+    lazyCategoriesDeferred++;
+    discardProtocolClosure(cls);
+    return true;
+}
+
+
+/***********************************************************************
+* attachLazyCategories
+* Attaches the categories deferred for cls, if any. Call before reading
+* cls's method, property, or protocol lists.
+* Locking: runtimeLock must be held by the caller
+**********************************************************************/
+static NEVER_INLINE void
+attachLazyCategories_slow(Class cls)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+    cls->data()->clearFlags(RW_LAZY_CATEGORIES);
+
+    auto &map = objc::lazyCategories.get();
+    auto it = map.find(cls);
+    if (it == map.end()) return;
+    if (it->second.count() == 0) {
+        map.erase(it);
+        return;
+    }
+
+    if (PrintConnecting) {
+        _objc_inform("CLASS: attaching %u deferred categories to %s%s",
+                     (unsigned)it->second.count(), cls->nameForLogging(),
+                     cls->isMetaClass() ? " (meta)" : "");
+    }
+    lazyCategoriesAttached += it->second.count();
+    objc::lazyCategories.attachToClass(cls, cls, ATTACH_EXISTING |
+                                       (cls->isMetaClass() ? ATTACH_METACLASS
+                                                           : ATTACH_CLASS));
+}
+
+static ALWAYS_INLINE void
+attachLazyCategories(Class cls)
+{
+    if (slowpath(cls->data()->flags & RW_LAZY_CATEGORIES)) {
+        attachLazyCategories_slow(cls);
+    }
+}
+
+
+/***********************************************************************
+* _objc_getLazyCategoryStatistics
+* Reports how many categories were deferred and later attached, and
+* how many classes are still waiting for theirs.
+* Locking: acquires runtimeLock
+**********************************************************************/
+void
+_objc_getLazyCategoryStatistics(struct objc_lazy_category_statistics *stats)
+{
+    mutex_locker_t lock(runtimeLock);
+
+    stats->deferredCategories = lazyCategoriesDeferred;
+    stats->attachedCategories = lazyCategoriesAttached;
+    stats->pendingClasses = 0;
+    stats->avoidedExtAllocations = 0;
+    for (auto &entry : objc::lazyCategories.get()) {
+        if (entry.second.count() == 0) continue;
+        stats->pendingClasses++;
+        if (!entry.first->data()->ext()) stats->avoidedExtAllocations++;
+    }
+}
+
 static bool isBundleClass(Class cls)
 {
     return cls->data()->ro()->flags & RO_FROM_BUNDLE;
@@ -1453,6 +1965,7 @@ attachCategories(Class cls, const locstamped_category_t *cats_list, uint32_t cat
             if (mcount == ATTACH_BUFSIZ) {
                 prepareMethodLists(cls, mlists, mcount, NO, fromBundle, __func__);
                 rwe->methods.attachLists(mlists, mcount);
+                discardMethodIndex(cls, rwe);
                 mcount = 0;
             }
             mlists[ATTACH_BUFSIZ - ++mcount] = mlist;
@@ -1483,6 +1996,7 @@ attachCategories(Class cls, const locstamped_category_t *cats_list, uint32_t cat
         prepareMethodLists(cls, mlists + ATTACH_BUFSIZ - mcount, mcount,
                            NO, fromBundle, __func__);
         rwe->methods.attachLists(mlists + ATTACH_BUFSIZ - mcount, mcount);
+        discardMethodIndex(cls, rwe);
         if (flags & ATTACH_EXISTING) {
             flushCaches(cls, __func__, [](Class c){
                 // constant caches have been dealt with in prepareMethodLists
@@ -1495,6 +2009,7 @@ attachCategories(Class cls, const locstamped_category_t *cats_list, uint32_t cat
     rwe->properties.attachLists(proplists + ATTACH_BUFSIZ - propcount, propcount);
 
     rwe->protocols.attachLists(protolists + ATTACH_BUFSIZ - protocount, protocount);
+    discardProtocolClosure(cls);
 }
 
 
@@ -1523,7 +2038,10 @@ static void methodizeClass(Class cls, Class previously)
     method_list_t *list = ro->baseMethods;
     if (list) {
         prepareMethodLists(cls, &list, 1, YES, isBundleClass(cls), nullptr);
-        if (rwe) rwe->methods.attachLists(&list, 1);
+        if (rwe) {
+            rwe->methods.attachLists(&list, 1);
+            discardMethodIndex(cls, rwe);
+        }
     }
 
     property_list_t *proplist = ro->baseProperties;
@@ -1696,14 +2214,16 @@ static char *copySwiftV1DemangledName(const char *string, bool isProtocol = fals
 
 
 /***********************************************************************
-* copySwiftV1MangledName
-* Returns the Swift 1.0 mangled form of the given class or protocol name.
-* Returns nil if the string doesn't look like an unmangled Swift name.
-* The result must be freed with free().
+* formatSwiftV1MangledName
+* Writes the Swift 1.0 mangled form of the given class or protocol name
+* into buf, truncated to size bytes including the terminator.
+* Returns the length of the full mangled name, like snprintf(),
+* or -1 if the string doesn't look like an unmangled Swift name.
 **********************************************************************/
-static char *copySwiftV1MangledName(const char *string, bool isProtocol = false)
+static int formatSwiftV1MangledName(const char *string, bool isProtocol,
+                                    char *buf, size_t size)
 {
-    if (!string) return nil;
+    if (!string) return -1;
 
     size_t dotCount = 0;
     size_t dotIndex;
@@ -1717,7 +2237,7 @@ static char *copySwiftV1MangledName(const char *string, bool isProtocol = false)
     size_t stringLength = s - string;
 
     if (dotCount != 1  ||  dotIndex == 0  ||  dotIndex >= stringLength-1) {
-        return nil;
+        return -1;
     }
 
     const char *prefix = string;
@@ -1725,20 +2245,34 @@ static char *copySwiftV1MangledName(const char *string, bool isProtocol = false)
     const char *suffix = string + dotIndex + 1;
     size_t suffixLength = stringLength - (dotIndex + 1);
 
-    char *name;
-
     if (prefixLength == 5  &&  memcmp(prefix, "Swift", 5) == 0) {
-        _objc_asprintf(&name, "_Tt%cs%zu%.*s%s",
-                       isProtocol ? 'P' : 'C',
-                       suffixLength, (int)suffixLength, suffix,
-                       isProtocol ? "_" : "");
+        return snprintf(buf, size, "_Tt%cs%zu%.*s%s",
+                        isProtocol ? 'P' : 'C',
+                        suffixLength, (int)suffixLength, suffix,
+                        isProtocol ? "_" : "");
     } else {
-        _objc_asprintf(&name, "_Tt%c%zu%.*s%zu%.*s%s",
-                       isProtocol ? 'P' : 'C',
-                       prefixLength, (int)prefixLength, prefix,
-                       suffixLength, (int)suffixLength, suffix,
-                       isProtocol ? "_" : "");
+        return snprintf(buf, size, "_Tt%c%zu%.*s%zu%.*s%s",
+                        isProtocol ? 'P' : 'C',
+                        prefixLength, (int)prefixLength, prefix,
+                        suffixLength, (int)suffixLength, suffix,
+                        isProtocol ? "_" : "");
     }
+}
+
+
+/***********************************************************************
+* copySwiftV1MangledName
+* Returns the Swift 1.0 mangled form of the given class or protocol name.
+* Returns nil if the string doesn't look like an unmangled Swift name.
+* The result must be freed with free().
+**********************************************************************/
+static char *copySwiftV1MangledName(const char *string, bool isProtocol = false)
+{
+    int length = formatSwiftV1MangledName(string, isProtocol, nil, 0);
+    if (length < 0) return nil;
+
+    char *name = (char *)malloc(length + 1);
+    formatSwiftV1MangledName(string, isProtocol, name, length + 1);
     return name;
 }
 
@@ -1757,19 +2291,147 @@ static char *copySwiftV1MangledName(const char *string, bool isProtocol = false)
 // named classes not in the dyld shared cache, whether realized or not.
 // This list excludes lazily named classes, which have to be looked up
 // using a getClass hook.
+// The runtime looks names up in namedClasses below. This table is kept
+// in step with it only for debuggers, which read it directly.
 NXMapTable *gdb_objc_realized_classes;  // exported for debuggers in objc-gdb.h
 uintptr_t objc_debug_realized_class_generation_count;
 
-static Class getClass_impl(const char *name)
+/***********************************************************************
+* nameHash64
+* 64-bit FNV-1a hash of a class or protocol name.
+**********************************************************************/
+static uint64_t nameHash64(const char *name)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const uint8_t *s = (const uint8_t *)name; *s; s++) {
+        hash = (hash ^ *s) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+namespace {
+
+/***********************************************************************
+* NamedClassTable
+* name => class map of the classes in gdb_objc_realized_classes.
+* Open addressing with linear probing. Each entry keeps its name's
+* 64-bit hash, so a probe compares hashes before any string, and a
+* name that is the entry's own pointer needs no strcmp().
+* Removal shifts later entries of the run back, leaving no tombstones.
+* Locking: runtimeLock must be held by the caller
+**********************************************************************/
+struct NamedClassTable {
+    struct Entry {
+        const char *name;  // nil if the entry is empty
+        Class cls;
+        uint64_t hash;
+    };
+
+    Entry *entries;
+    uint32_t mask;
+    uint32_t count;
+
+    static bool matches(const Entry &entry, const char *name, uint64_t hash) {
+        return entry.hash == hash  &&
+            (entry.name == name  ||  0 == strcmp(entry.name, name));
+    }
+
+    void init(uint32_t capacity) {
+        uint32_t size = 16;
+        while (size * 3 / 4 < capacity) size *= 2;
+        entries = (Entry *)calloc(size, sizeof(Entry));
+        mask = size - 1;
+        count = 0;
+    }
+
+    Entry *find(const char *name, uint64_t hash) const {
+        for (uint32_t i = (uint32_t)hash & mask; ; i = (i + 1) & mask) {
+            Entry &entry = entries[i];
+            if (!entry.name) return nil;
+            if (matches(entry, name, hash)) return &entry;
+        }
+    }
+
+    void grow() {
+        Entry *oldEntries = entries;
+        uint32_t oldSize = mask + 1;
+        entries = (Entry *)calloc(oldSize * 2, sizeof(Entry));
+        mask = oldSize * 2 - 1;
+        for (uint32_t i = 0; i < oldSize; i++) {
+            if (!oldEntries[i].name) continue;
+            uint32_t j = (uint32_t)oldEntries[i].hash & mask;
+            while (entries[j].name) j = (j + 1) & mask;
+            entries[j] = oldEntries[i];
+        }
+        free(oldEntries);
+    }
+
+    // Maps name to cls, replacing any class already mapped from name.
+    void insert(const char *name, Class cls) {
+        uint64_t hash = nameHash64(name);
+        if (Entry *entry = find(name, hash)) {
+            entry->name = name;
+            entry->cls = cls;
+            return;
+        }
+        if ((count + 1) * 4 > (mask + 1) * 3) grow();
+        uint32_t i = (uint32_t)hash & mask;
+        while (entries[i].name) i = (i + 1) & mask;
+        entries[i] = { name, cls, hash };
+        count++;
+    }
+
+    void remove(const char *name) {
+        Entry *entry = find(name, nameHash64(name));
+        if (!entry) return;
+        count--;
+
+        // Move back later entries of the run that may not stay
+        // behind the hole, so lookups never stop at it early.
+        uint32_t hole = (uint32_t)(entry - entries);
+        for (uint32_t i = (hole + 1) & mask; entries[i].name; i = (i + 1) & mask) {
+            uint32_t home = (uint32_t)entries[i].hash & mask;
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                entries[hole] = entries[i];
+                hole = i;
+            }
+        }
+        entries[hole] = {};
+    }
+};
+
+// A name that was recently looked up and not found.
+struct ClassMiss {
+    uintptr_t generation;  // namedClassesGeneration when recorded
+    uint64_t hash;
+    char name[48];
+};
+
+}
+
+static NamedClassTable namedClasses;
+
+// Incremented whenever a lookup by name might find something new: a named
+// class was added or removed, or images were loaded or unloaded.
+// Starts at 1 so zeroed ClassMiss entries never match.
+static uintptr_t namedClassesGeneration = 1;
+static ClassMiss classMisses[CONFIG_CLASS_MISS_MEMO_SIZE];
+
+static void namedClassesChanged()
+{
+    lockdebug::assert_locked(&runtimeLock);
+    namedClassesGeneration++;
+}
+
+static Class getClass_impl(const char *name, uint64_t hash)
 {
     lockdebug::assert_locked(&runtimeLock);
 
     // allocated in _read_images
-    ASSERT(gdb_objc_realized_classes);
+    ASSERT(namedClasses.entries);
 
     // Try runtime-allocated table
-    Class result = (Class)NXMapGet(gdb_objc_realized_classes, name);
-    if (result) return result;
+    if (auto entry = namedClasses.find(name, hash)) return entry->cls;
 
     // Try table from dyld shared cache.
     // Note we do this last to handle the case where we dlopen'ed a shared cache
@@ -1784,17 +2446,39 @@ static Class getClassExceptSomeSwift(const char *name)
 {
     lockdebug::assert_locked(&runtimeLock);
 
+    uint64_t hash = nameHash64(name);
+    ClassMiss &miss = classMisses[hash % CONFIG_CLASS_MISS_MEMO_SIZE];
+    if (miss.generation == namedClassesGeneration  &&  miss.hash == hash  &&
+        0 == strcmp(miss.name, name))
+    {
+        return nil;
+    }
+
     // Try name as-is
-    Class result = getClass_impl(name);
+    Class result = getClass_impl(name, hash);
     if (result) return result;
 
     // Try Swift-mangled equivalent of the given name.
-    if (char *swName = copySwiftV1MangledName(name)) {
-        result = getClass_impl(swName);
+    // Most names fit in the buffer, which saves a malloc per miss.
+    char buf[256];
+    int length = formatSwiftV1MangledName(name, false, buf, sizeof(buf));
+    if (length >= (int)sizeof(buf)) {
+        char *swName = copySwiftV1MangledName(name);
+        result = getClass_impl(swName, nameHash64(swName));
         free(swName);
         return result;
     }
+    if (length >= 0) {
+        result = getClass_impl(buf, nameHash64(buf));
+        if (result) return result;
+    }
 
+    size_t nameLength = strlen(name);
+    if (nameLength < sizeof(miss.name)) {
+        miss.generation = namedClassesGeneration;
+        miss.hash = hash;
+        memcpy(miss.name, name, nameLength + 1);
+    }
     return nil;
 }
 
@@ -1817,7 +2501,9 @@ static void addNamedClass(Class cls, const char *name, Class replacing = nil)
         // secondary meta->nonmeta table.
         addNonMetaClass(cls);
     } else {
+        namedClasses.insert(name, cls);
         NXMapInsert(gdb_objc_realized_classes, name, cls);
+        namedClassesChanged();
     }
     ASSERT(!cls->isMetaClassMaybeUnrealized());
 
@@ -1841,8 +2527,11 @@ static void removeNamedClass(Class cls, const char *name)
 {
     lockdebug::assert_locked(&runtimeLock);
     ASSERT(!(cls->data()->flags & RO_META));
-    if (cls == NXMapGet(gdb_objc_realized_classes, name)) {
+    auto entry = namedClasses.find(name, nameHash64(name));
+    if (entry  &&  entry->cls == cls) {
+        namedClasses.remove(name);
         NXMapRemove(gdb_objc_realized_classes, name);
+        namedClassesChanged();
     } else {
         // cls has a name collision with another class - don't remove the other
         // but do remove cls from the secondary metaclass->class map.
@@ -3073,10 +3762,15 @@ static void flushCaches(Class cls, const char *func, bool (^predicate)(Class))
     mutex_locker_t lock(cacheUpdateLock);
 #endif
 
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+    objc::methodLookupChanged();
+#endif
+
     const auto handler = ^(Class c) {
         if (predicate(c)) {
             c->cache.eraseNolock(func);
         }
+        forgetMissingSels(c);
 
         return true;
     };
@@ -3149,10 +3843,18 @@ map_images(unsigned count, const char * const paths[],
            const struct mach_header * const mhdrs[])
 {
     bool takeEnforcementDisableFault;
+    size_t earlySelrefs = 0;
+
+#if CONFIG_PARALLEL_SELREF_MIN
+    // Fix up large batches of selector references before taking
+    // runtimeLock, so the worker threads never wait behind it.
+    earlySelrefs = fixupSelectorRefsInParallel(count, mhdrs);
+#endif
 
     {
         mutex_locker_t lock(runtimeLock);
-        map_images_nolock(count, paths, mhdrs, &takeEnforcementDisableFault);
+        map_images_nolock(count, paths, mhdrs, earlySelrefs,
+                          &takeEnforcementDisableFault);
     }
 
     if (takeEnforcementDisableFault) {
@@ -3226,7 +3928,12 @@ static void load_categories_nolock(header_info *hi) {
                     ||  cat->instanceProperties)
                 {
                     if (cls->isRealized()) {
-                        attachCategories(cls, &lc, 1, ATTACH_EXISTING);
+                        if (!deferCategory(lc, cls, cls)) {
+                            // Categories deferred earlier go first,
+                            // so this one overrides them.
+                            attachLazyCategories(cls);
+                            attachCategories(cls, &lc, 1, ATTACH_EXISTING);
+                        }
                     } else {
                         objc::unattachedCategories.addForClass(lc, cls);
                     }
@@ -3236,7 +3943,10 @@ static void load_categories_nolock(header_info *hi) {
                     ||  (hasClassProperties && cat->_classProperties))
                 {
                     if (cls->ISA()->isRealized()) {
-                        attachCategories(cls->ISA(), &lc, 1, ATTACH_EXISTING | ATTACH_METACLASS);
+                        if (!deferCategory(lc, cls->ISA(), cls)) {
+                            attachLazyCategories(cls->ISA());
+                            attachCategories(cls->ISA(), &lc, 1, ATTACH_EXISTING | ATTACH_METACLASS);
+                        }
                     } else {
                         objc::unattachedCategories.addForClass(lc, cls->ISA());
                     }
@@ -3538,16 +4248,208 @@ readProtocol(protocol_t *newproto, Class protocol_class,
             }
         }
     }
-    else {
-        // New protocol from an un-preoptimized image. Fix it up in place.
-        // fixme duplicate protocols from unloadable bundle
-        newproto->initIsa(protocol_class);  // fixme pinned
-        insertFn(protocol_map, newproto->mangledName, newproto);
-        if (PrintProtocols) {
-            _objc_inform("PROTOCOLS: protocol at %p is %s",
-                         newproto, newproto->nameForLogging());
-        }
-    }
+    else {
+        // New protocol from an un-preoptimized image. Fix it up in place.
+        // fixme duplicate protocols from unloadable bundle
+        newproto->initIsa(protocol_class);  // fixme pinned
+        insertFn(protocol_map, newproto->mangledName, newproto);
+        if (PrintProtocols) {
+            _objc_inform("PROTOCOLS: protocol at %p is %s",
+                         newproto, newproto->nameForLogging());
+        }
+    }
+}
+
+#if CONFIG_PARALLEL_SELREF_MIN
+/***********************************************************************
+* imageFixesUpSelectorRefsEarly
+* Whether map_images() fixes up this image's selector references
+* before taking runtimeLock, when it fixes up any. Only images that
+* dyld did not optimize qualify; their references are never shared
+* with the dyld shared cache.
+**********************************************************************/
+static bool imageFixesUpSelectorRefsEarly(const headerType *mhdr)
+{
+    const objc_image_info *info = _getObjcImageInfo(mhdr, nil);
+    return info  &&  !info->optimizedByDyld()  &&  !info->optimizedByDyldClosure();
+}
+
+// A run of one image's selector references, the hashes of their names,
+// and which of them are not registered yet.
+struct selref_chunk_t {
+    SEL *sels;
+    uint32_t count;
+    uint32_t missCount;
+    bool isBundle;
+    uint64_t missed[CONFIG_PARALLEL_SELREF_CHUNK / 64];
+    uint32_t hashes[CONFIG_PARALLEL_SELREF_CHUNK];
+};
+
+struct selref_fixup_t {
+    selref_chunk_t *chunks;
+    size_t chunkCount;
+};
+
+/***********************************************************************
+* resolveSelectorRefChunk
+* dispatch_apply_f() body of the first pass of the parallel fixup.
+* Points each reference in the chunk whose name is already registered
+* at its SEL, and remembers the rest. Registers nothing, so no lock
+* is needed.
+**********************************************************************/
+static void resolveSelectorRefChunk(void *ctxt, size_t c)
+{
+    selref_chunk_t& chunk = ((selref_fixup_t *)ctxt)->chunks[c];
+    for (uint32_t i = 0; i < chunk.count; i++) {
+        const char *name = sel_cname(chunk.sels[i]);
+        uint32_t hash = sel_namehash(name);
+        SEL sel = sel_lookUpByNameAndHash(name, hash);
+        if (!sel) {
+            chunk.hashes[i] = hash;
+            chunk.missed[i / 64] |= 1ULL << (i % 64);
+            chunk.missCount++;
+        } else if (chunk.sels[i] != sel) {
+            chunk.sels[i] = sel;
+        }
+    }
+}
+
+/***********************************************************************
+* registerSelectorRefShard
+* dispatch_apply_f() body of the second pass of the parallel fixup.
+* Registers the unresolved references whose names fall in one shard
+* of the selector table, in image order, so each reference gets the
+* SEL a serial fixup would give it.
+* Locking: the thread that called dispatch_apply_f() holds selLock.
+**********************************************************************/
+static void registerSelectorRefShard(void *ctxt, size_t shard)
+{
+    auto fixup = (selref_fixup_t *)ctxt;
+    for (size_t c = 0; c < fixup->chunkCount; c++) {
+        selref_chunk_t& chunk = fixup->chunks[c];
+        if (!chunk.missCount) continue;
+        for (uint32_t i = 0; i < chunk.count; i++) {
+            if (!(chunk.missed[i / 64] & (1ULL << (i % 64)))) continue;
+            if (sel_shard(chunk.hashes[i]) != shard) continue;
+            SEL sel = sel_registerNameInShard(sel_cname(chunk.sels[i]),
+                                              chunk.hashes[i], chunk.isBundle);
+            if (chunk.sels[i] != sel) {
+                chunk.sels[i] = sel;
+            }
+        }
+    }
+}
+
+/***********************************************************************
+* fixupSelectorRefsInParallel
+* Fix up the selector references of the images dyld is mapping, when
+* there are at least CONFIG_PARALLEL_SELREF_MIN of them, using
+* dispatch_apply_f(). Called before runtimeLock is taken, so the
+* worker threads never wait behind it or behind anything that waits
+* for it. The calling thread takes part in every dispatch_apply_f(),
+* so the fixup finishes even if no worker is available.
+* The images mapped at launch are skipped: libdispatch may still be
+* initializing then.
+* Returns the number of references fixed up, or 0 if _read_images()
+* must fix them up itself.
+* Locking: acquires selLock. runtimeLock must not be held.
+**********************************************************************/
+static size_t
+fixupSelectorRefsInParallel(unsigned mhCount,
+                            const struct mach_header * const mhdrs[])
+{
+    if (!didCallDyldNotifyRegister  ||  DisableParallelImageReading) return 0;
+
+    // Count references in the order _read_images() sees the images.
+    size_t total = 0, chunkCount = 0;
+    for (unsigned i = mhCount; i--; ) {
+        auto mhdr = (const headerType *)mhdrs[i];
+        if (!imageFixesUpSelectorRefsEarly(mhdr)) continue;
+        size_t count;
+        _getObjc2SelectorRefs(mhdr, &count);
+        total += count;
+        chunkCount += (count + CONFIG_PARALLEL_SELREF_CHUNK - 1)
+            / CONFIG_PARALLEL_SELREF_CHUNK;
+    }
+    if (total < CONFIG_PARALLEL_SELREF_MIN) return 0;
+
+    selref_fixup_t fixup;
+    fixup.chunks = (selref_chunk_t *)
+        calloc(chunkCount, sizeof(selref_chunk_t));
+    fixup.chunkCount = 0;
+    for (unsigned i = mhCount; i--; ) {
+        auto mhdr = (const headerType *)mhdrs[i];
+        if (!imageFixesUpSelectorRefsEarly(mhdr)) continue;
+        size_t count;
+        SEL *sels = _getObjc2SelectorRefs(mhdr, &count);
+        for (size_t s = 0; s < count; s += CONFIG_PARALLEL_SELREF_CHUNK) {
+            selref_chunk_t& chunk = fixup.chunks[fixup.chunkCount++];
+            chunk.sels = sels + s;
+            chunk.count = (uint32_t)
+                std::min(count - s, (size_t)CONFIG_PARALLEL_SELREF_CHUNK);
+            chunk.isBundle = (mhdr->filetype == MH_BUNDLE);
+        }
+    }
+
+    dispatch_apply_f(fixup.chunkCount, DISPATCH_APPLY_AUTO,
+                     &fixup, resolveSelectorRefChunk);
+
+    size_t registered = 0;
+    for (size_t c = 0; c < fixup.chunkCount; c++) {
+        registered += fixup.chunks[c].missCount;
+    }
+    if (registered) {
+        mutex_locker_t lock(selLock);
+        dispatch_apply_f(SEL_SHARDS, DISPATCH_APPLY_AUTO,
+                         &fixup, registerSelectorRefShard);
+    }
+
+    if (PrintImageTimes) {
+        _objc_inform("IMAGE TIMES: resolved %zu selector references in "
+                     "parallel, registered %zu in %d shards",
+                     total - registered, registered, SEL_SHARDS);
+    }
+    free(fixup.chunks);
+    return total;
+}
+#endif
+
+/***********************************************************************
+* fixupSelectorRefs
+* Unique the selector references of every header in hList that
+* does not have preoptimized selectors.
+* If map_images() already fixed up earlySelrefs references in
+* parallel, the images it fixed up are skipped.
+* Returns the number of references fixed up.
+* Locking: runtimeLock acquired by map_images
+**********************************************************************/
+static size_t
+fixupSelectorRefs(header_info **hList, uint32_t hCount, size_t earlySelrefs)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+    size_t total = earlySelrefs;
+    mutex_locker_t lock(selLock);
+    for (uint32_t h = 0; h < hCount; h++) {
+        header_info *hi = hList[h];
+        if (hi->hasPreoptimizedSelectors()) continue;
+#if CONFIG_PARALLEL_SELREF_MIN
+        if (earlySelrefs  &&  imageFixesUpSelectorRefsEarly(hi->mhdr())) continue;
+#endif
+
+        bool isBundle = hi->isBundle();
+        size_t count;
+        SEL *sels = _getObjc2SelectorRefs(hi, &count);
+        total += count;
+        for (size_t i = 0; i < count; i++) {
+            const char *name = sel_cname(sels[i]);
+            SEL sel = sel_registerNameNoLock(name, isBundle);
+            if (sels[i] != sel) {
+                sels[i] = sel;
+            }
+        }
+    }
+    return total;
 }
 
 /***********************************************************************
@@ -3555,11 +4457,14 @@ readProtocol(protocol_t *newproto, Class protocol_class,
 * Perform initial processing of the headers in the linked
 * list beginning with headerList.
 *
+* earlySelrefs is the number of selector references map_images
+* already fixed up, or 0.
+*
 * Called by: map_images_nolock
 *
 * Locking: runtimeLock acquired by map_images
 **********************************************************************/
-void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int unoptimizedTotalClasses)
+void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int unoptimizedTotalClasses, size_t earlySelrefs)
 {
     header_info *hi;
     uint32_t hIndex;
@@ -3573,6 +4478,11 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
 
     lockdebug::assert_locked(&runtimeLock);
 
+    // Class lookups that missed may find classes in these images,
+    // and protocol closures may miss their protocols.
+    namedClassesChanged();
+    discardAllProtocolClosures();
+
 #define EACH_HEADER \
     hIndex = 0;         \
     hIndex < hCount && (hi = hList[hIndex]); \
@@ -3648,6 +4558,7 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
         // 4/3 is NXMapTable's load factor
         int namedClassesSize =
             (isPreoptimized() ? unoptimizedTotalClasses : totalClasses) * 4 / 3;
+        namedClasses.init(namedClassesSize);
         gdb_objc_realized_classes =
             NXCreateMapTable(NXStrValueMapPrototype, namedClassesSize);
 
@@ -3658,23 +4569,7 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
     // Note this has to be before anyone uses a method list, as relative method
     // lists point to selRefs, and assume they are already fixed up (uniqued).
     static size_t UnfixedSelectors;
-    {
-        mutex_locker_t lock(selLock);
-        for (EACH_HEADER) {
-            if (hi->hasPreoptimizedSelectors()) continue;
-
-            bool isBundle = hi->isBundle();
-            SEL *sels = _getObjc2SelectorRefs(hi, &count);
-            UnfixedSelectors += count;
-            for (i = 0; i < count; i++) {
-                const char *name = sel_cname(sels[i]);
-                SEL sel = sel_registerNameNoLock(name, isBundle);
-                if (sels[i] != sel) {
-                    sels[i] = sel;
-                }
-            }
-        }
-    }
+    UnfixedSelectors += fixupSelectorRefs(hList, hCount, earlySelrefs);
 
     ts.log("IMAGE TIMES: fix up selector references");
 
@@ -3996,6 +4891,9 @@ void _unload_image(header_info *hi)
     lockdebug::assert_locked(&loadMethodLock);
     lockdebug::assert_locked(&runtimeLock);
 
+    namedClassesChanged();
+    discardAllProtocolClosures();
+
     // Unload unattached categories and categories waiting for +load.
 
     // Ignore __objc_catlist2. We don't support unloading Swift
@@ -4011,6 +4909,12 @@ void _unload_image(header_info *hi)
         // unattached list
         objc::unattachedCategories.eraseCategoryForClass(cat, cls);
 
+        // deferred lists, for the class and its metaclass; searched
+        // by category so cls->ISA() is not needed
+        for (auto &entry : objc::lazyCategories.get()) {
+            entry.second.erase(cat);
+        }
+
         // +load queue
         remove_category_from_loadable_list(cat);
     }
@@ -4932,6 +5836,8 @@ void objc_registerProtocol(Protocol *proto_gen)
     // Should we warn on duplicates?
     if (getProtocol(proto->mangledName) == nil) {
         NXMapKeyCopyingInsert(protocols(), proto->mangledName, proto);
+        // Closures may hold another protocol of this name.
+        discardAllProtocolClosures();
     }
 }
 
@@ -4981,6 +5887,9 @@ protocol_addProtocol(Protocol *proto_gen, Protocol *addition_gen)
 
     protolist->list[protolist->count++] = (protocol_ref_t)addition;
     proto->protocols = protolist;
+
+    // A class may already adopt proto.
+    discardAllProtocolClosures();
 }
 
 
@@ -5287,6 +6196,7 @@ _classConformsToProtocol_unrealized(Class _Nonnull cls,
     protocol_array_t protocols;
 
     if (cls->isRealized()) {
+        attachLazyCategories(cls);
         protocols = cls->data()->protocols();
     } else {
         auto ro = cls->safe_ro();
@@ -5634,6 +6544,7 @@ class_copyMethodList(Class cls, unsigned int *outCount)
     }
 
     mutex_locker_t lock(runtimeLock);
+    attachLazyCategories(cls);
     const auto methods = cls->data()->methods();
 
     ASSERT(cls->isRealized());
@@ -5713,6 +6624,7 @@ class_copyPropertyList(Class cls, unsigned int *outCount)
 
     checkIsKnownClass(cls);
     ASSERT(cls->isRealized());
+    attachLazyCategories(cls);
 
     auto rw = cls->data();
 
@@ -5808,6 +6720,7 @@ class_copyProtocolList(Class cls, unsigned int *outCount)
     }
 
     mutex_locker_t lock(runtimeLock);
+    attachLazyCategories(cls);
     const auto protocols = cls->data()->protocols();
 
     checkIsKnownClass(cls);
@@ -6491,6 +7404,112 @@ method_lists_contains_any(T *mlists, T *end,
 }
 
 
+#if CONFIG_METHOD_INDEX_MIN_LISTS
+/***********************************************************************
+ * buildMethodIndex
+ * Merge all of cls's method lists into one index sorted by selector.
+ * Locking: runtimeLock must be held by the caller
+ **********************************************************************/
+static NEVER_INLINE method_index_t *
+buildMethodIndex(Class cls, class_rw_ext_t *rwe)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+    uint64_t start = slowpath(PrintConnecting) ? nanoseconds() : 0;
+
+    auto const &methods = rwe->methods;
+    uint32_t total = 0;
+    uint32_t listCount = 0;
+    for (auto mlists = methods.beginLists(), end = methods.endLists();
+         mlists != end;
+         ++mlists)
+    {
+        const method_list_t *mlist = *mlists;
+        total += mlist->count;
+        listCount++;
+    }
+
+    size_t size = method_index_t::byteSize(total);
+    auto index = (method_index_t *)malloc(size);
+    index->listCount = listCount;
+    new (&index->lookups) std::atomic<uintptr_t>(0);
+
+    // Lists in search order, methods in list order. The stable sort
+    // keeps that order among methods with the same selector.
+    auto entries = index->entries;
+    uint32_t n = 0;
+    for (auto mlists = methods.beginLists(), end = methods.endLists();
+         mlists != end;
+         ++mlists)
+    {
+        const method_list_t *mlist = *mlists;
+        for (auto& meth : *mlist) {
+            entries[n++] = { meth.name(), &meth };
+        }
+    }
+    std::stable_sort(entries, entries + n,
+                     [](const method_index_t::entry_t &a,
+                        const method_index_t::entry_t &b) {
+        return (uintptr_t)a.sel < (uintptr_t)b.sel;
+    });
+
+    // Keep the first method for each selector.
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (count == 0  ||  entries[count - 1].sel != entries[i].sel) {
+            entries[count++] = entries[i];
+        }
+    }
+    index->count = count;
+
+    if (slowpath(PrintConnecting)) {
+        _objc_inform("METHOD INDEX: built index of class '%s'%s: "
+                     "%u methods from %u method lists, %zu bytes, %llu ns",
+                     cls->nameForLogging(), cls->isMetaClass() ? " (meta)" : "",
+                     count, listCount, size,
+                     (unsigned long long)(nanoseconds() - start));
+    }
+
+    rwe->cachesAllocIfNeeded()->methodIndex.store(index, std::memory_order_release);
+    return index;
+}
+
+/***********************************************************************
+ * methodIndexForSearch
+ * Returns cls's merged method index, building it on the second search
+ * since its method lists changed if it has enough of them.
+ * Returns nil if the method lists should be searched instead.
+ * Locking: runtimeLock must be held by the caller
+ **********************************************************************/
+ALWAYS_INLINE static method_index_t *
+methodIndexForSearch(Class cls, class_rw_ext_t *rwe)
+{
+    auto const &methods = rwe->methods;
+    if (methods.endLists() - methods.beginLists() < CONFIG_METHOD_INDEX_MIN_LISTS  ||
+        DisableMethodIndex)
+    {
+        return nil;
+    }
+
+    auto rw = cls->data();
+    if (!(rw->flags & RW_METHOD_INDEX_PENDING)) {
+        rw->setFlags(RW_METHOD_INDEX_PENDING);
+        return nil;
+    }
+    return buildMethodIndex(cls, rwe);
+}
+
+ALWAYS_INLINE static method_t *
+search_method_index(method_index_t *index, SEL sel)
+{
+    if (slowpath(PrintConnecting)) {
+        index->lookups.fetch_add(1, std::memory_order_relaxed);
+    }
+    return index->find(sel);
+}
+#endif
+
+
 /***********************************************************************
  * getMethodNoSuper_nolock
  * fixme
@@ -6505,6 +7524,17 @@ getMethodNoSuper_nolock(Class cls, SEL sel)
     // fixme nil cls?
     // fixme nil sel?
 
+    attachLazyCategories(cls);
+
+#if CONFIG_METHOD_INDEX_MIN_LISTS
+    if (auto rwe = cls->data()->ext()) {
+        auto caches = rwe->getCaches();
+        auto index = caches ? caches->methodIndex.load(std::memory_order_relaxed) : nil;
+        if (!index) index = methodIndexForSearch(cls, rwe);
+        if (index) return search_method_index(index, sel);
+    }
+#endif
+
     auto const methods = cls->data()->methods();
     for (auto mlists = methods.beginLists(),
               end = methods.endLists();
@@ -6523,6 +7553,42 @@ getMethodNoSuper_nolock(Class cls, SEL sel)
 }
 
 
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+/***********************************************************************
+ * getMethodNoSuper_lockfree
+ * Like getMethodNoSuper_nolock, for callers that do not hold runtimeLock.
+ * The caller must be inside a LockFreeLookupScope and must validate
+ * the result against methodLookupGeneration.
+ **********************************************************************/
+static method_t *
+getMethodNoSuper_lockfree(Class cls, SEL sel)
+{
+    ASSERT(cls->isRealized());
+
+#if CONFIG_METHOD_INDEX_MIN_LISTS
+    // Indexes are only built with the lock held.
+    if (auto rwe = cls->data()->ext()) {
+        auto caches = rwe->getCaches();
+        auto index = caches ? caches->methodIndex.load(std::memory_order_acquire) : nil;
+        if (index) return search_method_index(index, sel);
+    }
+#endif
+
+    auto const methods = cls->data()->methodsUnlocked();
+    for (auto mlists = methods.beginLists(),
+              end = methods.endLists();
+         mlists != end;
+         ++mlists)
+    {
+        method_t *m = search_method_list_inline(*mlists, sel);
+        if (m) return m;
+    }
+
+    return nil;
+}
+#endif
+
+
 /***********************************************************************
 * getMethod_nolock
 * fixme
@@ -6736,6 +7802,59 @@ log_and_fill_cache(Class cls, IMP imp, SEL sel, id receiver, Class implementer)
 }
 
 
+/***********************************************************************
+* rememberMissingSel
+* Records that cls does not implement sel, for LOOKUP_NIL lookups.
+* Returns false if negative caches are not read without the lock,
+* so the caller fills the method cache instead.
+* Locking: runtimeLock must be held by the caller.
+**********************************************************************/
+static bool
+rememberMissingSel(Class cls, SEL sel)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+    if (DisableLockFreeLookup) return false;
+    negativeSelCacheForInsert(cls)->insert(sel);
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+/***********************************************************************
+* isKnownMissingSel
+* Returns true if a LOOKUP_NIL lookup of sel in cls found nothing
+* and no method list has changed since.
+* Locking: none
+**********************************************************************/
+static bool
+isKnownMissingSel(Class cls, SEL sel)
+{
+#if CONFIG_USE_PREOPT_CACHES
+    // lookUpImpOrForward records misses where it would fill the cache.
+    while (cls->cache.isConstantOptimizedCache(/* strict */true)) {
+        cls = cls->cache.preoptFallbackClass();
+    }
+#endif
+
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+    if (DisableLockFreeLookup) return false;
+
+    // Retired tables and caches stay allocated while this scope is open.
+    objc::LockFreeLookupScope scope;
+    auto table = negativeSelTable.load(std::memory_order_acquire);
+    if (!table) return false;
+    auto negative = table->find(cls, std::memory_order_acquire);
+    return negative  &&  negative->contains(sel);
+#else
+    return false;
+#endif
+}
+
+
 /***********************************************************************
 * realizeAndInitializeIfNeeded_locked
 * Realize the given class if not already realized, and initialize it if
@@ -6765,6 +7884,82 @@ realizeAndInitializeIfNeeded_locked(id inst, Class cls, bool initialize)
     return cls;
 }
 
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+/***********************************************************************
+* lookUpImpLockFreeAndLock
+* Searches cls and its superclasses for sel without holding runtimeLock,
+* then acquires runtimeLock.
+* Returns the IMP found, possibly _objc_msgForward_impcache, and the class
+* that provided it, if no method search result changed in the meantime.
+* Returns nil if the caller must redo the search with the lock held.
+* cls must be initialized. Classes with constant caches are not searched.
+* Locking: runtimeLock must not be held by the caller; it is held on return.
+**********************************************************************/
+static IMP
+lookUpImpLockFreeAndLock(SEL sel, Class cls, Class *outImplementer)
+{
+    const IMP forward_imp = (IMP)_objc_msgForward_impcache;
+    // Superclass chains are never this deep. The locked search
+    // diagnoses cycles with unreasonableClassCount().
+    constexpr unsigned maxSearchDepth = 1024;
+
+    method_t *meth = nil;
+    IMP imp = nil;
+    Class curClass = cls;
+    uintptr_t generation;
+    bool found = false;
+
+    lockdebug::assert_unlocked(&runtimeLock);
+    ASSERT(cls->isInitialized());
+
+    {
+        objc::LockFreeLookupScope scope;
+        generation = objc::methodLookupGeneration.load(std::memory_order_acquire);
+
+        for (unsigned attempts = maxSearchDepth; attempts > 0; attempts--) {
+            // Constant caches can be invalidated concurrently,
+            // leave them to the locked search.
+            if (curClass->cache.isConstantOptimizedCache(/* strict */true)) {
+                break;
+            }
+
+            // curClass method list.
+            if ((meth = getMethodNoSuper_lockfree(curClass, sel))) {
+                found = true;
+                break;
+            }
+
+            if ((curClass = curClass->getSuperclass()) == nil) {
+                imp = forward_imp;
+                found = true;
+                break;
+            }
+
+            // Superclass cache. A forward:: entry ends the search
+            // like it does in lookUpImpOrForward.
+            if ((imp = cache_getImp(curClass, sel))) {
+                found = true;
+                break;
+            }
+        }
+    }
+
+    runtimeLock.lock();
+
+    if (!found  ||
+        objc::methodLookupGeneration.load(std::memory_order_relaxed) != generation)
+    {
+        return nil;
+    }
+
+    // Small method IMPs may be remapped, which must be read under the lock.
+    if (meth) imp = meth->imp(false);
+    *outImplementer = curClass;
+    return imp;
+}
+#endif
+
+
 /***********************************************************************
 * lookUpImpOrForward / lookUpImpOrForwardTryCache / lookUpImpOrNilTryCache
 * The standard IMP lookup.
@@ -6773,7 +7968,8 @@ realizeAndInitializeIfNeeded_locked(id inst, Class cls, bool initialize)
 * Most callers should use lookUpImpOrForwardTryCache with LOOKUP_INITIALIZE
 *
 * Without LOOKUP_INITIALIZE: tries to avoid +initialize (but sometimes fails)
-* With    LOOKUP_NIL: returns nil on negative cache hits
+* With    LOOKUP_NIL: returns nil on negative cache hits, and records misses
+*                    in the class's negative_sel_cache_t, not in cache_t
 *
 * inst is an instance of cls or a subclass thereof, or nil if none is known.
 *   If cls is an un-initialized metaclass then a non-nil inst is faster.
@@ -6799,6 +7995,9 @@ static IMP _lookUpImpTryCache(id inst, SEL sel, Class cls, int behavior)
     }
 #endif
     if (slowpath(imp == NULL)) {
+        if ((behavior & LOOKUP_NIL)  &&  isKnownMissingSel(cls, sel)) {
+            return nil;
+        }
         return lookUpImpOrForward(inst, sel, cls, behavior);
     }
 
@@ -6853,8 +8052,19 @@ IMP lookUpImpOrForward(id inst, SEL sel, Class cls, int behavior)
     // Otherwise, a category could be added but ignored indefinitely because
     // the cache was re-filled with the old value after the cache flush on
     // behalf of the category.
-
-    runtimeLock.lock();
+    //
+    // With CONFIG_LOCKFREE_METHOD_LOOKUP initialized classes are searched
+    // first without the lock. The cache fill still happens under the lock,
+    // after checking that no method list changed during the search.
+
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+    if (fastpath((behavior & LOOKUP_NOCACHE) == 0  &&  !DisableLockFreeLookup)) {
+        imp = lookUpImpLockFreeAndLock(sel, cls, &curClass);
+    } else
+#endif
+    {
+        runtimeLock.lock();
+    }
 
     // We don't want people to be able to craft a binary blob that looks like
     // a class but really isn't one and do a CFI attack.
@@ -6864,6 +8074,13 @@ IMP lookUpImpOrForward(id inst, SEL sel, Class cls, int behavior)
     // objc_duplicateClass, objc_initializeClassPair or objc_allocateClassPair.
     checkIsKnownClass(cls);
 
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+    if (imp) {
+        if (imp == forward_imp) goto resolve;
+        goto done;
+    }
+#endif
+
     cls = realizeAndInitializeIfNeeded_locked(inst, cls, behavior & LOOKUP_INITIALIZE);
     // runtimeLock may have been dropped but is now locked again
     lockdebug::assert_locked(&runtimeLock);
@@ -6919,7 +8136,9 @@ IMP lookUpImpOrForward(id inst, SEL sel, Class cls, int behavior)
     }
 
     // No implementation found. Try method resolver once.
-
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+ resolve:
+#endif
     if (slowpath(behavior & LOOKUP_RESOLVER)) {
         behavior ^= LOOKUP_RESOLVER;
         return resolveMethod_locked(inst, sel, cls, behavior);
@@ -6932,7 +8151,11 @@ IMP lookUpImpOrForward(id inst, SEL sel, Class cls, int behavior)
             cls = cls->cache.preoptFallbackClass();
         }
 #endif
-        log_and_fill_cache(cls, imp, sel, inst, curClass);
+        if (!(slowpath((behavior & LOOKUP_NIL) && imp == forward_imp)  &&
+              rememberMissingSel(cls, sel)))
+        {
+            log_and_fill_cache(cls, imp, sel, inst, curClass);
+        }
     }
 #if CONFIG_USE_PREOPT_CACHES
  done_unlock:
@@ -7006,6 +8229,7 @@ objc_property_t class_getProperty(Class cls, const char *name)
     ASSERT(cls->isRealized());
 
     for ( ; cls; cls = cls->getSuperclass()) {
+        attachLazyCategories(cls);
         for (auto& prop : cls->data()->properties()) {
             if (0 == strcmp(name, prop.name)) {
                 return (objc_property_t)&prop;
@@ -7052,6 +8276,11 @@ objc_class::setInitialized()
 
     mutex_locker_t lock(runtimeLock);
 
+    // Deferred categories must be attached before the class is
+    // marked initialized and searched without the lock.
+    attachLazyCategories(cls);
+    attachLazyCategories(metacls);
+
     // Special cases:
     // - NSObject AWZ  class methods are default.
     // - NSObject RR   class and instance methods are default.
@@ -7430,10 +8659,135 @@ _class_getVariable(Class cls, const char *name)
 }
 
 
+#if CONFIG_PROTOCOL_CLOSURE_CACHE_SIZE
+static void
+addToProtocolClosure(protocol_t *proto, objc::DenseSet<protocol_t *> &seen)
+{
+    if (!seen.insert(proto).second) return;
+    if (proto->protocols) {
+        for (uintptr_t i = 0; i < proto->protocols->count; i++) {
+            addToProtocolClosure(remapProtocol(proto->protocols->list[i]), seen);
+        }
+    }
+}
+
+/***********************************************************************
+* protocolClosureSlotForInsert
+* Returns the slot of cls's set that a new closure for cls should use,
+* or nil if every closure in the set is in use and none is evicted.
+* Locking: runtimeLock must be held by the caller
+**********************************************************************/
+static std::atomic<protocol_closure_t *> *
+protocolClosureSlotForInsert(Class cls)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+    auto &set = protocolClosureSet(cls);
+    for (auto &slot : set.slots) {
+        if (!slot.load(std::memory_order_relaxed)) return &slot;
+    }
+
+    // Second chance: skip closures used since the last search,
+    // and clear their marks for the next one.
+    for (unsigned i = 0; i < set.ways; i++) {
+        auto &slot = set.slots[set.hand];
+        set.hand = (set.hand + 1) % set.ways;
+        protocol_closure_t *closure = slot.load(std::memory_order_relaxed);
+        if (!closure->used.load(std::memory_order_relaxed)) return &slot;
+        closure->used.store(false, std::memory_order_relaxed);
+    }
+    return nil;
+}
+
+/***********************************************************************
+* buildProtocolClosure
+* Collects the protocols cls adopts, directly or through other
+* protocols, and installs them as cls's protocol closure.
+* Returns nil if cls's set has no room for it.
+* Locking: runtimeLock must be held by the caller
+**********************************************************************/
+static NEVER_INLINE protocol_closure_t *buildProtocolClosure(Class cls)
+{
+    lockdebug::assert_locked(&runtimeLock);
+
+    auto slot = protocolClosureSlotForInsert(cls);
+    if (!slot) return nil;
+
+    objc::DenseSet<protocol_t *> seen{};
+    for (const auto& proto_ref : cls->data()->protocols()) {
+        addToProtocolClosure(remapProtocol(proto_ref), seen);
+    }
+
+    uint32_t count = (uint32_t)seen.size();
+    auto closure = (protocol_closure_t *)
+        malloc(protocol_closure_t::byteSize(count));
+    closure->cls = cls;
+    closure->count = count;
+    new (&closure->used) std::atomic<bool>(true);
+    closure->bloom = 0;
+
+    uint32_t i = 0;
+    for (protocol_t *proto : seen) closure->protocols[i++] = proto;
+    std::sort(closure->protocols, closure->protocols + count);
+
+    auto names = closure->names();
+    for (i = 0; i < count; i++) {
+        const char *name = closure->protocols[i]->mangledName;
+        names[i] = { nameHash64(name), name };
+        closure->bloom |= protocol_closure_t::bloomBits(names[i].hash);
+    }
+    std::sort(names, names + count,
+              [](const protocol_closure_t::name_t &a,
+                 const protocol_closure_t::name_t &b) {
+        return a.hash < b.hash;
+    });
+
+    protocol_closure_t *old = slot->load(std::memory_order_relaxed);
+    slot->store(closure, std::memory_order_release);
+    if (old) retireListArray(old);
+
+    return closure;
+}
+
+/***********************************************************************
+* protocolClosureContains
+* Returns YES if closure has proto or a protocol with the same name.
+* Protocols are equal if their names are, as in
+* protocol_conformsToProtocol_nolock(). The closure has canonical
+* protocols, so a canonical proto is usually found by address.
+**********************************************************************/
+static bool
+protocolClosureContains(const protocol_closure_t *closure, protocol_t *proto)
+{
+    if (std::binary_search(closure->protocols,
+                           closure->protocols + closure->count, proto))
+    {
+        return YES;
+    }
+
+    uint64_t hash = nameHash64(proto->mangledName);
+    uint64_t bits = protocol_closure_t::bloomBits(hash);
+    if ((closure->bloom & bits) != bits) return NO;
+
+    auto names = closure->names();
+    auto it = std::lower_bound(names, names + closure->count, hash,
+                               [](const protocol_closure_t::name_t &name,
+                                  uint64_t hash) {
+        return name.hash < hash;
+    });
+    for (; it != names + closure->count  &&  it->hash == hash; ++it) {
+        if (0 == strcmp(it->mangledName, proto->mangledName)) return YES;
+    }
+    return NO;
+}
+#endif
+
+
 /***********************************************************************
 * class_conformsToProtocol
-* fixme
-* Locking: read-locks runtimeLock
+* Returns YES if cls adopts proto, directly or through other protocols.
+* Superclasses are not searched.
+* Locking: acquires runtimeLock if cls has no protocol closure yet
 **********************************************************************/
 BOOL class_conformsToProtocol(Class cls, Protocol *proto_gen)
 {
@@ -7442,11 +8796,31 @@ BOOL class_conformsToProtocol(Class cls, Protocol *proto_gen)
     if (!cls) return NO;
     if (!proto_gen) return NO;
 
+#if CONFIG_PROTOCOL_CLOSURE_CACHE_SIZE && CONFIG_LOCKFREE_METHOD_LOOKUP
+    if (!DisableLockFreeLookup) {
+        // Retired closures stay allocated while this scope is open.
+        objc::LockFreeLookupScope scope;
+        auto closure = protocolClosureSet(cls).find(cls, std::memory_order_acquire);
+        if (closure) {
+            useProtocolClosure(closure);
+            return protocolClosureContains(closure, proto);
+        }
+    }
+#endif
+
     mutex_locker_t lock(runtimeLock);
 
     checkIsKnownClass(cls);
 
     ASSERT(cls->isRealized());
+    attachLazyCategories(cls);
+
+#if CONFIG_PROTOCOL_CLOSURE_CACHE_SIZE
+    auto closure = protocolClosureSet(cls).find(cls, std::memory_order_relaxed);
+    if (closure) useProtocolClosure(closure);
+    else closure = buildProtocolClosure(cls);
+    if (closure) return protocolClosureContains(closure, proto);
+#endif
 
     for (const auto& proto_ref : cls->data()->protocols()) {
         protocol_t *p = remapProtocol(proto_ref);
@@ -7461,6 +8835,7 @@ BOOL class_conformsToProtocol(Class cls, Protocol *proto_gen)
 static void
 addMethods_finish(Class cls, method_list_t *newlist)
 {
+    attachLazyCategories(cls);
     auto rwe = cls->data()->extAllocIfNeeded();
 
     if (newlist->count > 1)
@@ -7468,6 +8843,7 @@ addMethods_finish(Class cls, method_list_t *newlist)
 
     prepareMethodLists(cls, &newlist, 1, NO, NO, __func__);
     rwe->methods.attachLists(&newlist, 1);
+    discardMethodIndex(cls, rwe);
 
     // If the class being modified has a constant cache,
     // then all children classes are flattened constant caches
@@ -7724,6 +9100,7 @@ BOOL class_addProtocol(Class cls, Protocol *protocol_gen)
     if (class_conformsToProtocol(cls, protocol_gen)) return NO;
 
     mutex_locker_t lock(runtimeLock);
+    attachLazyCategories(cls);
     auto rwe = cls->data()->extAllocIfNeeded();
 
     ASSERT(cls->isRealized());
@@ -7735,6 +9112,7 @@ BOOL class_addProtocol(Class cls, Protocol *protocol_gen)
     protolist->list[0] = (protocol_ref_t)protocol;
 
     rwe->protocols.attachLists(&protolist, 1);
+    discardProtocolClosure(cls);
 
     // fixme metaclass?
 
@@ -7769,6 +9147,7 @@ _class_addProperty(Class cls, const char *name,
     }
     else {
         mutex_locker_t lock(runtimeLock);
+        attachLazyCategories(cls);
         auto rwe = cls->data()->extAllocIfNeeded();
 
         ASSERT(cls->isRealized());
@@ -7900,6 +9279,7 @@ objc_duplicateClass(Class original, const char *name,
     mutex_locker_t lock(runtimeLock);
 
     checkIsKnownClass(original);
+    attachLazyCategories(original);
 
     auto orig_rw  = original->data();
     auto orig_rwe = orig_rw->ext();
@@ -8229,6 +9609,7 @@ static void detach_class(Class cls, bool isMeta)
 
     // categories not yet attached to this class
     objc::unattachedCategories.eraseClass(cls);
+    objc::lazyCategories.eraseClass(cls);
 
     // superclass's subclass list
     if (cls->isRealized()) {
@@ -8265,6 +9646,8 @@ static void free_class(Class cls)
     auto ro = rw->ro();
 
     cls->cache.destroy();
+    discardProtocolClosure(cls);
+    discardMissingSels(cls);
 
     if (rwe) {
         for (auto& meth : rwe->methods) {
@@ -8291,6 +9674,11 @@ static void free_class(Class cls)
         rwe->properties.tryFree();
 
         rwe->protocols.tryFree();
+
+        if (auto caches = rwe->getCaches()) {
+            free(caches->methodIndex.load(std::memory_order_relaxed));
+            free(caches);
+        }
     }
 
     try_free(ro->getIvarLayout());
@@ -8585,6 +9973,9 @@ object_dispose(id obj)
     if (!obj) return nil;
 
     objc_destructInstance(obj);
+#if ISA_HAS_BIASED_RC
+    obj->biasedRCDispose();
+#endif
     free(obj);
 
     return nil;
@@ -8964,5 +10355,9 @@ void runtime_init(void)
 {
     objc::disableEnforceClassRXPtrAuth = DisableClassRXSigningEnforcement;
     objc::unattachedCategories.init(32);
+    objc::lazyCategories.init(32);
     objc::allocatedClasses.init();
+#if CONFIG_LOCKFREE_METHOD_LOOKUP
+    objc::lockFreeLookupReadersMap.init();
+#endif
 }
@@ -91,6 +91,7 @@ const option_t Settings[] = {
 
 namespace objc {
     int PageCountWarning = 50;  // Default value if the environment variable is not set
+    int PoolPageStashLimit = 4;  // Default value if the environment variable is not set
 }
 
 // objc's TLS
@@ -347,6 +348,21 @@ void SetPageCountWarning(const char* envvar) {
     }
 }
 
+/***********************************************************************
+* SetPoolPageStashLimit
+* Convert environment variable value to integer value.
+* If the value is valid, set the global PoolPageStashLimit value.
+**********************************************************************/
+void SetPoolPageStashLimit(const char* envvar) {
+    if (envvar) {
+        char *end;
+        long result = strtol(envvar, &end, 10);
+        if (end != envvar  &&  result >= 0  &&  result <= 1024) {
+            objc::PoolPageStashLimit = (int)result;
+        }
+    }
+}
+
 /***********************************************************************
 * environ_init
 * Read environment variables that affect the runtime.
@@ -406,6 +422,10 @@ void environ_init(void)
             SetPageCountWarning(*p + 22);
             continue;
         }
+        if (0 == strncmp(*p, "OBJC_POOL_PAGE_STASH=", 21)) {
+            SetPoolPageStashLimit(*p + 21);
+            continue;
+        }
 
         const char *value = strchr(*p, '=');
         if (!*value) continue;
@@ -529,6 +549,11 @@ _objc_pthread_data::~_objc_pthread_data() {
         }
     }
     free(classNameLookups);
+    _destroyPoolPageStash(poolPageStash);
+    _destroyZoneMagazines(zoneMagazines);
+#if CONFIG_CACHE_EPOCHS
+    _destroyCacheReader(cacheReader);
+#endif
 
     // add further cleanup here...
 }
@@ -22,12 +22,192 @@
  */
 
 #include "objc-private.h"
-#include "DenseMapExtras.h"
 
-static objc::ExplicitInitDenseSet<const char *> namedSelectors;
 static SEL search_builtins(const char *key);
 
 
+/***********************************************************************
+* Selector table.
+* namedSelectors interns the names of selectors that dyld did not 
+* preoptimize. It is split into SEL_SHARDS tables by the top bits of 
+* the name's hash. Lookups take no lock. Each shard has one writer at 
+* a time: inserts are made with selLock held, or by the one thread 
+* that sel_registerNameInShard() is called on for that shard while 
+* another thread holds selLock.
+*
+* The table is open-addressed in groups of SEL_GROUP_WIDTH slots, 
+* like the weak table. Each group has a word of control bytes: 
+* SEL_CTRL_EMPTY, or seven bits of the name's hash. A lookup compares 
+* a whole group of control bytes at once, then the full 32-bit hash, 
+* and calls strcmp() only when both match. The hash is computed once 
+* per call and reused by the insert that may follow a miss.
+*
+* A writer fills in a slot's name and hash, then publishes the slot 
+* with a release store of its group's control word. Nothing is ever 
+* removed. A resize builds a whole new table and publishes it with a 
+* release store of namedSelectors. Readers may still be probing the 
+* old table, so it is kept on the new table's retired list rather 
+* than freed.
+*
+* Retired tables are never freed: the leak is bounded. Each resize at 
+* least doubles a shard's capacity, so a shard's retired tables 
+* together are smaller than its current table, and the selector 
+* tables never take more than twice the memory of the current ones. 
+* Freeing them would need proof that no reader is still probing. 
+* Lookups run on any thread, with no registration and no reader 
+* count, and the cache epochs and PC checks only cover cache scans. 
+* sel_init() presizes the tables for the images mapped at launch, 
+* which avoids most resizes.
+**********************************************************************/
+#define SEL_GROUP_WIDTH 8
+#define SEL_CTRL_EMPTY ((uint8_t)0x80)
+
+static const uint64_t SEL_LSBS = 0x0101010101010101ULL;
+static const uint64_t SEL_MSBS = 0x8080808080808080ULL;
+
+struct SelectorTable {
+    uintptr_t mask;           // slot count - 1
+    size_t count;             // names in the table
+    size_t growthLeft;        // empty slots usable before the next resize
+    SelectorTable *retired;   // previous table, or nil
+    std::atomic<uint64_t> *ctrl;  // one control word per group
+    const char **names;
+    uint32_t *hashes;
+
+    size_t groupMask() const { return (mask + 1) / SEL_GROUP_WIDTH - 1; }
+};
+
+static std::atomic<SelectorTable *> namedSelectors[SEL_SHARDS];
+
+uint32_t sel_namehash(const char *name)
+{
+    return ptr_hash(_objc_strhash(name));
+}
+
+static inline uint8_t sel_h2(uint32_t hash) { return hash & 0x7f; }
+static inline uint32_t sel_h1(uint32_t hash) { return hash >> 7; }
+
+// Slots whose control byte is h2. May report a full slot next to a 
+// real match; callers compare hashes anyway.
+static inline uint64_t sel_group_match(uint64_t group, uint8_t h2)
+{
+    uint64_t x = group ^ (SEL_LSBS * h2);
+    return (x - SEL_LSBS) & ~x & SEL_MSBS;
+}
+
+static inline uint64_t sel_group_match_empty(uint64_t group)
+{
+    return group & SEL_MSBS;
+}
+
+static inline size_t sel_group_slot(uint64_t match)
+{
+    return __builtin_ctzll(match) / 8;
+}
+
+static SelectorTable *sel_table_alloc(size_t capacity)
+{
+    ASSERT(capacity >= SEL_GROUP_WIDTH  &&  (capacity & (capacity-1)) == 0);
+    size_t groups = capacity / SEL_GROUP_WIDTH;
+    size_t size = sizeof(SelectorTable)
+        + groups * sizeof(std::atomic<uint64_t>)
+        + capacity * sizeof(const char *)
+        + capacity * sizeof(uint32_t);
+    auto *table = (SelectorTable *)malloc(size);
+    table->mask = capacity - 1;
+    table->count = 0;
+    table->growthLeft = capacity - capacity / 8;
+    table->retired = nil;
+    table->ctrl = (std::atomic<uint64_t> *)(table + 1);
+    table->names = (const char **)(table->ctrl + groups);
+    table->hashes = (uint32_t *)(table->names + capacity);
+    for (size_t g = 0; g < groups; g++) {
+        new (&table->ctrl[g]) std::atomic<uint64_t>(SEL_LSBS * SEL_CTRL_EMPTY);
+    }
+    return table;
+}
+
+// Find a name in the current table of its shard. Takes no lock.
+static const char *sel_table_find(const char *name, uint32_t hash)
+{
+    SelectorTable *table =
+        namedSelectors[sel_shard(hash)].load(std::memory_order_acquire);
+    if (!table) return nil;
+
+    size_t gmask = table->groupMask();
+    size_t group = sel_h1(hash) & gmask;
+    uint8_t h2 = sel_h2(hash);
+    for (size_t step = 1; ; step++) {
+        uint64_t word = table->ctrl[group].load(std::memory_order_acquire);
+        for (uint64_t m = sel_group_match(word, h2); m; m &= m - 1) {
+            size_t index = group * SEL_GROUP_WIDTH + sel_group_slot(m);
+            if (table->hashes[index] == hash  &&  
+                0 == strcmp(table->names[index], name)) 
+            {
+                return table->names[index];
+            }
+        }
+        if (sel_group_match_empty(word)) return nil;
+        group = (group + step) & gmask;
+    }
+}
+
+// Add a name that is not in the table. The slot is published last.
+static void sel_table_add(SelectorTable *table, const char *name, uint32_t hash)
+{
+    size_t gmask = table->groupMask();
+    size_t group = sel_h1(hash) & gmask;
+    for (size_t step = 1; ; step++) {
+        uint64_t word = table->ctrl[group].load(std::memory_order_relaxed);
+        if (uint64_t m = sel_group_match_empty(word)) {
+            size_t slot = sel_group_slot(m);
+            size_t index = group * SEL_GROUP_WIDTH + slot;
+            table->names[index] = name;
+            table->hashes[index] = hash;
+            word &= ~(0xffULL << (slot * 8));
+            word |= (uint64_t)sel_h2(hash) << (slot * 8);
+            table->ctrl[group].store(word, std::memory_order_release);
+            table->count++;
+            table->growthLeft--;
+            return;
+        }
+        group = (group + step) & gmask;
+    }
+}
+
+// Locking: the caller is the shard's writer.
+static SelectorTable *sel_table_grow(unsigned shard, SelectorTable *table,
+                                     size_t minCount)
+{
+    size_t oldCapacity = table ? table->mask + 1 : 0;
+    size_t capacity = std::max<size_t>(oldCapacity * 2, 4 * SEL_GROUP_WIDTH);
+    while (capacity - capacity / 8 < minCount) capacity *= 2;
+
+    SelectorTable *newTable = sel_table_alloc(capacity);
+    if (table) {
+        for (size_t i = 0; i < oldCapacity; i++) {
+            uint64_t word = table->ctrl[i / SEL_GROUP_WIDTH].load(std::memory_order_relaxed);
+            if (word & (0x80ULL << (i % SEL_GROUP_WIDTH * 8))) continue;
+            sel_table_add(newTable, table->names[i], table->hashes[i]);
+        }
+        newTable->retired = table;
+    }
+    namedSelectors[shard].store(newTable, std::memory_order_release);
+    return newTable;
+}
+
+// Locking: the caller is the shard's writer.
+static void sel_table_insert(const char *name, uint32_t hash)
+{
+    unsigned shard = sel_shard(hash);
+    SelectorTable *table = namedSelectors[shard].load(std::memory_order_relaxed);
+    if (!table  ||  table->growthLeft == 0) {
+        table = sel_table_grow(shard, table, table ? table->count + 1 : 1);
+    }
+    sel_table_add(table, name, hash);
+}
+
+
 /***********************************************************************
 * sel_init
 * Initialize selector tables and register selectors used internally.
@@ -40,11 +220,18 @@ void sel_init(size_t selrefCount)
     }
 #endif
 
-  namedSelectors.init((unsigned)selrefCount);
+    mutex_locker_t lock(selLock);
 
-    // Register selectors used by libobjc
+    // Names spread evenly over the shards.
+    size_t shardCount = selrefCount / SEL_SHARDS + 1;
+    for (unsigned shard = 0; shard < SEL_SHARDS; shard++) {
+        SelectorTable *table = namedSelectors[shard].load(std::memory_order_relaxed);
+        if (!table  ||  table->growthLeft < shardCount) {
+            sel_table_grow(shard, table, (table ? table->count : 0) + shardCount);
+        }
+    }
 
-    mutex_locker_t lock(selLock);
+    // Register selectors used by libobjc
 
     SEL_cxx_construct = sel_registerNameNoLock(".cxx_construct", NO);
     SEL_cxx_destruct = sel_registerNameNoLock(".cxx_destruct", NO);
@@ -83,9 +270,7 @@ BOOL sel_isMapped(SEL sel)
 
     if (sel == search_builtins(name)) return YES;
 
-    mutex_locker_t lock(selLock);
-    auto it = namedSelectors.get().find(name);
-    return it != namedSelectors.get().end() && (SEL)*it == sel;
+    return sel == (SEL)sel_table_find(name, sel_namehash(name));
 }
 
 
@@ -110,14 +295,35 @@ static SEL __sel_registerName(const char *name, bool shouldLock, bool copy)
 
     result = search_builtins(name);
     if (result) return result;
-    
+
+    uint32_t hash = sel_namehash(name);
+    if (const char *found = sel_table_find(name, hash)) return (SEL)found;
+
     conditional_mutex_locker_t lock(selLock, shouldLock);
-	auto it = namedSelectors.get().insert(name);
-	if (it.second) {
-		// No match. Insert.
-		*it.first = (const char *)sel_alloc(name, copy);
-	}
-	return (SEL)*it.first;
+    if (shouldLock) {
+        // Another thread may have inserted it since the unlocked lookup.
+        if (const char *found = sel_table_find(name, hash)) return (SEL)found;
+    }
+    result = sel_alloc(name, copy);
+    sel_table_insert((const char *)result, hash);
+    return result;
+}
+
+
+/***********************************************************************
+* sel_registerNameInShard
+* Register a name that is not preoptimized, given its sel_namehash().
+* Used by the parallel selector fixup, whose threads each register 
+* the names of different shards.
+* Locking: another thread holds selLock, and the calling thread is 
+* the only one registering names in the name's shard.
+**********************************************************************/
+SEL sel_registerNameInShard(const char *name, uint32_t hash, bool copy)
+{
+    if (const char *found = sel_table_find(name, hash)) return (SEL)found;
+    SEL result = (SEL)(copy ? strdupIfMutable(name) : name);
+    sel_table_insert((const char *)result, hash);
+    return result;
 }
 
 
@@ -144,12 +350,15 @@ SEL sel_lookUpByName(const char *name) {
     SEL result = search_builtins(name);
     if (result) return result;
 
-    mutex_locker_t lock(selLock);
-    auto it = namedSelectors.get().find(name);
-    if (it == namedSelectors.get().end()) {
-        return (SEL)0;
-    }
-    return (SEL)*it;
+    return (SEL)sel_table_find(name, sel_namehash(name));
+}
+
+// sel_lookUpByName() for a name whose sel_namehash() is known.
+SEL sel_lookUpByNameAndHash(const char *name, uint32_t hash) {
+    SEL result = search_builtins(name);
+    if (result) return result;
+
+    return (SEL)sel_table_find(name, hash);
 }
 
 BOOL sel_isEqual(SEL lhs, SEL rhs)
@@ -25,16 +25,18 @@
 #include "objc-sync.h"
 
 //
-// Allocate a lock only when needed.  Since few locks are needed at any point
-// in time, keep them on a single list.
+// Allocate a lock only when needed. Locks in use are kept in a small hash
+// table per stripe. Idle locks are unlinked from the table and kept on a
+// free list for reuse, so the number of SyncData blocks is bounded by the
+// number of objects synchronized at the same time, not by object churn.
 //
 
 
 typedef struct alignas(CacheLineSize) SyncData {
-    struct SyncData* nextData;
+    struct SyncData* nextData;  // next in the hash chain or free list
     DisguisedPtr<objc_object> object;
     int32_t threadCount;  // number of THREADS using this block
-    recursive_mutex_t mutex;
+    adaptive_recursive_mutex_t mutex;
 } SyncData;
 
 typedef struct {
@@ -42,8 +44,10 @@ typedef struct {
     unsigned int lockCount;  // number of times THIS THREAD locked this block
 } SyncCacheItem;
 
+// Open-addressed with linear probing, keyed by data->object.
+// Empty slots have data == nil.
 typedef struct SyncCache {
-    unsigned int allocated;
+    unsigned int allocated;  // power of two
     unsigned int used;
     SyncCacheItem list[0];
 } SyncCache;
@@ -68,16 +72,108 @@ static tls_direct_fast(SyncData *, tls_key::sync_data) syncData;
 static tls_direct_fast(uintptr_t, tls_key::sync_count) syncLockCount;
 #endif
 
+static inline uint32_t sync_hash(id object)
+{
+    return ptr_hash((uintptr_t)object);
+}
+
+// SyncData in use for the objects of one stripe, chained in buckets.
+// SyncData are never freed: a thread may still be unlocking an idle
+// SyncData's mutex after it decremented threadCount, so idle blocks
+// are only ever reused as SyncData.
 struct SyncList {
-    SyncData *data;
+    SyncData **buckets;
+    SyncData *freeList;
+    uint32_t mask;  // bucket count - 1
+    uint32_t count;  // SyncData in buckets
     spinlock_t lock;
 
-    SyncList() : data(nil), lock(fork_unsafe) { }
+    SyncList() : buckets(nil), freeList(nil), mask(0), count(0), lock(fork_unsafe) { }
+
+    SyncData **bucketFor(id object) {
+        return &buckets[sync_hash(object) & mask];
+    }
+
+    // Move the idle SyncData at *link to the free list.
+    // threadCount only goes up from 0 under this lock, so an idle
+    // SyncData cannot be picked up by another thread meanwhile.
+    void reclaim(SyncData **link) {
+        SyncData *data = *link;
+        ASSERT(data->threadCount == 0);
+        *link = data->nextData;
+        data->object = nil;
+        data->nextData = freeList;
+        freeList = data;
+        count--;
+    }
+
+    // Called when count reaches the bucket count. Reclaims every idle
+    // SyncData, then doubles the buckets only if at least half of them
+    // would still hold live ones. Growth therefore follows the number
+    // of objects locked at once, not the number ever locked.
+    void grow() {
+        uint32_t oldCount = buckets ? mask + 1 : 0;
+        for (uint32_t i = 0; i < oldCount; i++) {
+            SyncData **link = &buckets[i];
+            while (SyncData *p = *link) {
+                if (p->threadCount == 0) reclaim(link);
+                else link = &p->nextData;
+            }
+        }
+        if (oldCount  &&  count < oldCount / 2) return;
+
+        uint32_t newCount = oldCount ? oldCount * 2 : 4;
+        SyncData **oldBuckets = buckets;
+        buckets = (SyncData **)calloc(newCount, sizeof(SyncData *));
+        mask = newCount - 1;
+        for (uint32_t i = 0; i < oldCount; i++) {
+            SyncData *p = oldBuckets[i];
+            while (p) {
+                SyncData *next = p->nextData;
+                SyncData **head = bucketFor((id)p->object);
+                p->nextData = *head;
+                *head = p;
+                p = next;
+            }
+        }
+        free(oldBuckets);
+    }
+
+    // Find the SyncData for object, reclaiming idle ones on the way.
+    SyncData *find(id object) {
+        if (!buckets) return nil;
+        SyncData **link = bucketFor(object);
+        while (SyncData *p = *link) {
+            if (p->object == object) return p;
+            if (p->threadCount == 0) reclaim(link);
+            else link = &p->nextData;
+        }
+        return nil;
+    }
+
+    SyncData *insert(id object) {
+        if (count >= (buckets ? mask + 1 : 0)) grow();
+
+        SyncData *result = freeList;
+        if (result) {
+            freeList = result->nextData;
+            result->mutex.resetStatistics();
+        } else {
+            posix_memalign((void **)&result, alignof(SyncData), sizeof(SyncData));
+            new (&result->mutex) adaptive_recursive_mutex_t(fork_unsafe);
+        }
+        result->object = (objc_object *)object;
+        result->threadCount = 1;
+
+        SyncData **head = bucketFor(object);
+        result->nextData = *head;
+        *head = result;
+        count++;
+        return result;
+    }
 };
 
 // Use multiple parallel lists to decrease contention among unrelated objects.
-#define LOCK_FOR_OBJ(obj) sDataLists[obj].lock
-#define LIST_FOR_OBJ(obj) sDataLists[obj].data
 static StripedMap<SyncList> sDataLists;
 
 
@@ -94,21 +190,13 @@ static SyncCache *fetch_cache(bool create)
         if (!create) {
             return NULL;
         } else {
-            int count = 4;
+            int count = 8;
             data->syncCache = (SyncCache *)
                 calloc(1, sizeof(SyncCache) + count*sizeof(SyncCacheItem));
             data->syncCache->allocated = count;
         }
     }
 
-    // Make sure there's at least one open slot in the list.
-    if (data->syncCache->allocated == data->syncCache->used) {
-        data->syncCache->allocated *= 2;
-        data->syncCache = (SyncCache *)
-            realloc(data->syncCache, sizeof(SyncCache) 
-                    + data->syncCache->allocated * sizeof(SyncCacheItem));
-    }
-
     return data->syncCache;
 }
 
@@ -119,10 +207,72 @@ void _destroySyncCache(struct SyncCache *cache)
 }
 
 
+static SyncCacheItem *cache_find(SyncCache *cache, id object)
+{
+    unsigned int mask = cache->allocated - 1;
+    for (unsigned int i = sync_hash(object) & mask; ; i = (i+1) & mask) {
+        SyncCacheItem *item = &cache->list[i];
+        if (!item->data) return NULL;
+        if (item->data->object == object) return item;
+    }
+}
+
+
+static void cache_insert(_objc_pthread_data *data, SyncData *result)
+{
+    SyncCache *cache = data->syncCache;
+
+    // Keep the table at most 3/4 full.
+    if (4 * (cache->used + 1) > 3 * cache->allocated) {
+        SyncCache *old = cache;
+        unsigned int count = old->allocated * 2;
+        cache = (SyncCache *)
+            calloc(1, sizeof(SyncCache) + count*sizeof(SyncCacheItem));
+        cache->allocated = count;
+        for (unsigned int i = 0; i < old->allocated; i++) {
+            SyncCacheItem *item = &old->list[i];
+            if (!item->data) continue;
+            unsigned int j = sync_hash((id)item->data->object) & (count - 1);
+            while (cache->list[j].data) j = (j+1) & (count - 1);
+            cache->list[j] = *item;
+        }
+        cache->used = old->used;
+        free(old);
+        data->syncCache = cache;
+    }
+
+    unsigned int mask = cache->allocated - 1;
+    unsigned int i = sync_hash((id)result->object) & mask;
+    while (cache->list[i].data) i = (i+1) & mask;
+    cache->list[i].data = result;
+    cache->list[i].lockCount = 1;
+    cache->used++;
+}
+
+
+// Remove an item and shift back any items that probed past it.
+static void cache_remove(SyncCache *cache, SyncCacheItem *item)
+{
+    unsigned int mask = cache->allocated - 1;
+    unsigned int hole = (unsigned int)(item - cache->list);
+    for (unsigned int i = (hole+1) & mask; cache->list[i].data; i = (i+1) & mask) {
+        unsigned int home = sync_hash((id)cache->list[i].data->object) & mask;
+        // Move the item at i into the hole if its home slot
+        // is not cyclically in (hole, i].
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            cache->list[hole] = cache->list[i];
+            hole = i;
+        }
+    }
+    cache->list[hole].data = nil;
+    cache->list[hole].lockCount = 0;
+    cache->used--;
+}
+
+
 static SyncData* id2data(id object, enum usage why)
 {
-    spinlock_t *lockp = &LOCK_FOR_OBJ(object);
-    SyncData **listp = &LIST_FOR_OBJ(object);
+    SyncList& list = sDataLists[object];
     SyncData* result = NULL;
 
 #if ENABLE_FAST_CACHE
@@ -164,12 +314,9 @@ static SyncData* id2data(id object, enum usage why)
 
     // Check per-thread cache of already-owned locks for matching object
     SyncCache *cache = fetch_cache(NO);
-    if (cache) {
-        unsigned int i;
-        for (i = 0; i < cache->used; i++) {
-            SyncCacheItem *item = &cache->list[i];
-            if (item->data->object != object) continue;
-
+    if (cache  &&  cache->used) {
+        SyncCacheItem *item = cache_find(cache, object);
+        if (item) {
             // Found a match.
             result = item->data;
             if (result->threadCount <= 0  ||  item->lockCount <= 0) {
@@ -184,7 +331,7 @@ static SyncData* id2data(id object, enum usage why)
                 item->lockCount--;
                 if (item->lockCount == 0) {
                     // remove from per-thread cache
-                    cache->list[i] = cache->list[--cache->used];
+                    cache_remove(cache, item);
                     // atomic because may collide with concurrent ACQUIRE
                     AtomicDecrement(&result->threadCount);
                 }
@@ -199,54 +346,24 @@ static SyncData* id2data(id object, enum usage why)
     }
 
     // Thread cache didn't find anything.
-    // Walk in-use list looking for matching object
+    // Look up the stripe's table of locks in use.
     // Spinlock prevents multiple threads from creating multiple 
     // locks for the same new object.
-    // We could keep the nodes in some hash table if we find that there are
-    // more than 20 or so distinct locks active, but we don't do that now.
-    
-    lockp->lock();
-
-    {
-        SyncData* p;
-        SyncData* firstUnused = NULL;
-        for (p = *listp; p != NULL; p = p->nextData) {
-            if ( p->object == object ) {
-                result = p;
-                // atomic because may collide with concurrent RELEASE
-                AtomicIncrement(&result->threadCount);
-                goto done;
-            }
-            if ( (firstUnused == NULL) && (p->threadCount == 0) )
-                firstUnused = p;
-        }
     
+    list.lock.lock();
+
+    result = list.find(object);
+    if (result) {
+        // atomic because may collide with concurrent RELEASE
+        AtomicIncrement(&result->threadCount);
+    } else if (why == ACQUIRE) {
         // no SyncData currently associated with object
-        if ( (why == RELEASE) || (why == CHECK) )
-            goto done;
-    
-        // an unused one was found, use it
-        if ( firstUnused != NULL ) {
-            result = firstUnused;
-            result->object = (objc_object *)object;
-            result->threadCount = 1;
-            goto done;
-        }
+        // XXX allocating memory with a global lock held is bad practice,
+        // but allocation only happens when the free list is empty.
+        result = list.insert(object);
     }
 
-    // Allocate a new SyncData and add to list.
-    // XXX allocating memory with a global lock held is bad practice,
-    // might be worth releasing the lock, allocating, and searching again.
-    // But since we never free these guys we won't be stuck in allocation very often.
-    posix_memalign((void **)&result, alignof(SyncData), sizeof(SyncData));
-    result->object = (objc_object *)object;
-    result->threadCount = 1;
-    new (&result->mutex) recursive_mutex_t(fork_unsafe);
-    result->nextData = *listp;
-    *listp = result;
-    
- done:
-    lockp->unlock();
+    list.lock.unlock();
     if (result) {
         // Only new ACQUIRE should get here.
         // All RELEASE and CHECK and recursive ACQUIRE are 
@@ -254,6 +371,8 @@ static SyncData* id2data(id object, enum usage why)
         if (why == RELEASE) {
             // Probably some thread is incorrectly exiting 
             // while the object is held by another thread.
+            // Undo the threadCount taken above.
+            AtomicDecrement(&result->threadCount);
             return nil;
         }
         if (why != ACQUIRE) _objc_fatal("id2data is buggy");
@@ -269,9 +388,7 @@ static SyncData* id2data(id object, enum usage why)
         {
             // Save in thread cache
             if (!cache) cache = fetch_cache(YES);
-            cache->list[cache->used].data = result;
-            cache->list[cache->used].lockCount = 1;
-            cache->used++;
+            cache_insert(_objc_fetch_pthread_data(NO), result);
         }
     }
 
@@ -326,6 +443,30 @@ BOOL objc_sync_try_enter(id obj)
 }
 
 
+BOOL _objc_getSyncLockHistograms(id obj, struct objc_sync_lock_histograms *out)
+{
+    using statistics = objc_adaptive_recursive_lock_base_t::statistics;
+    static_assert(sizeof(out->hold) == sizeof(statistics::hold),
+                  "hold-time histogram size mismatch");
+    static_assert(sizeof(out->spin) >= sizeof(statistics::spin),
+                  "spin histogram too small");
+
+    statistics stats;
+    SyncList& list = sDataLists[obj];
+    list.lock.lock();
+    SyncData *data = list.find(obj);
+    if (data) data->mutex.getStatistics(&stats);
+    list.lock.unlock();
+    if (!data) return NO;
+
+    bzero(out, sizeof(*out));
+    memcpy(out->hold, stats.hold, sizeof(stats.hold));
+    memcpy(out->spin, stats.spin, sizeof(stats.spin));
+    out->spinRounds = objc_adaptive_recursive_lock_base_t::SpinRounds;
+    return YES;
+}
+
+
 // End synchronizing on 'obj'. 
 // Returns OBJC_SYNC_SUCCESS or OBJC_SYNC_NOT_OWNING_THREAD_ERROR
 int objc_sync_exit(id obj)
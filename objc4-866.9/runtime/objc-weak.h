@@ -115,12 +115,36 @@ struct weak_entry_t {
 /**
  * The global weak references table. Stores object ids as keys,
  * and weak_entry_t structs as their values.
+ *
+ * The table is open-addressed in groups of WEAK_GROUP_WIDTH slots.
+ * Each slot has a control byte in weak_ctrl: WEAK_CTRL_EMPTY, 
+ * WEAK_CTRL_DELETED, or seven bits of the referent's hash. A lookup 
+ * compares a whole group of control bytes at once and only reads the 
+ * weak_entry_t of slots whose hash bits match.
+ *
+ * The table grows and shrinks incrementally. A resize allocates the 
+ * new arrays and keeps the previous ones in old_entries/old_ctrl; 
+ * each later register, unregister, or clear moves a few groups of 
+ * old slots into the new arrays until old_entries is empty.
+ * Lookups check both sets of arrays while a move is in progress.
+ *
+ * An all-zero weak_table_t is a valid empty table.
  */
+#define WEAK_GROUP_WIDTH 8
+#define WEAK_CTRL_EMPTY   ((uint8_t)0x80)
+#define WEAK_CTRL_DELETED ((uint8_t)0xFE)
+
 struct weak_table_t {
     weak_entry_t *weak_entries;
-    size_t    num_entries;
-    uintptr_t mask;
-    uintptr_t max_hash_displacement;
+    uint8_t   *weak_ctrl;
+    size_t    num_entries;     // in both sets of arrays
+    uintptr_t mask;            // weak_entries capacity - 1
+    size_t    growth_left;     // empty slots usable before the next resize
+
+    weak_entry_t *old_entries; // previous arrays while resizing, or nil
+    uint8_t   *old_ctrl;
+    uintptr_t old_mask;
+    size_t    old_next;        // next old slot to move
 };
 
 enum WeakRegisterDeallocatingOptions {
@@ -37,6 +37,7 @@ BREAKPOINT_FUNCTION(
     void objc_weak_error(void)
 );
 
+__attribute__((noreturn))
 static void bad_weak_table(weak_entry_t *entries)
 {
     _objc_fatal("bad weak table at %p. This may be a runtime bug or a "
@@ -203,66 +204,190 @@ static void remove_referrer(weak_entry_t *entry, objc_object **old_referrer)
     entry->num_refs--;
 }
 
+/***********************************************************************
+* Weak table groups.
+* The control bytes of a group are compared eight at a time in a 
+* uint64_t. Byte i of the word is slot i of the group. Each match 
+* function returns a word with bit 7 of byte i set for matching slots.
+**********************************************************************/
+static const uint64_t WEAK_LSBS = 0x0101010101010101ULL;
+static const uint64_t WEAK_MSBS = 0x8080808080808080ULL;
+
+// Number of old slots moved by each table operation during a resize.
+#define WEAK_RESIZE_STEP (4 * WEAK_GROUP_WIDTH)
+
+static inline uint64_t weak_group_load(const uint8_t *ctrl, size_t group)
+{
+    uint64_t word;
+    memcpy(&word, ctrl + group * WEAK_GROUP_WIDTH, sizeof(word));
+    return word;
+}
+
+// Slots whose control byte is h2. May report a full slot next to a 
+// real match; callers compare referents anyway.
+static inline uint64_t weak_group_match(uint64_t group, uint8_t h2)
+{
+    uint64_t x = group ^ (WEAK_LSBS * h2);
+    return (x - WEAK_LSBS) & ~x & WEAK_MSBS;
+}
+
+static inline uint64_t weak_group_match_empty(uint64_t group)
+{
+    return group & ~(group << 6) & WEAK_MSBS;
+}
+
+static inline uint64_t weak_group_match_empty_or_deleted(uint64_t group)
+{
+    return group & ~(group << 7) & WEAK_MSBS;
+}
+
+static inline size_t weak_group_slot(uint64_t match)
+{
+    return __builtin_ctzll(match) / 8;
+}
+
+static inline uint8_t weak_h2(uintptr_t hash) { return hash & 0x7f; }
+static inline uintptr_t weak_h1(uintptr_t hash) { return hash >> 7; }
+
+static inline size_t weak_group_mask(uintptr_t mask)
+{
+    return (mask + 1) / WEAK_GROUP_WIDTH - 1;
+}
+
+
 /** 
- * Add new_entry to the object's table of weak references.
- * Does not check whether the referent is already in the table.
+ * Find referent in one set of weak table arrays.
+ * Probes groups in triangular order, which visits every group 
+ * of a power-of-two table.
  */
-static void weak_entry_insert(weak_table_t *weak_table, weak_entry_t *new_entry)
+static weak_entry_t *
+weak_arrays_find(weak_entry_t *entries, uint8_t *ctrl, uintptr_t mask, 
+                 objc_object *referent, uintptr_t hash)
 {
-    weak_entry_t *weak_entries = weak_table->weak_entries;
-    ASSERT(weak_entries != nil);
+    if (!entries) return nil;
+
+    size_t gmask = weak_group_mask(mask);
+    size_t group = weak_h1(hash) & gmask;
+    uint8_t h2 = weak_h2(hash);
+    for (size_t step = 1; step <= gmask + 1; step++) {
+        uint64_t word = weak_group_load(ctrl, group);
+        for (uint64_t m = weak_group_match(word, h2); m; m &= m - 1) {
+            weak_entry_t *entry = 
+                &entries[group * WEAK_GROUP_WIDTH + weak_group_slot(m)];
+            if (entry->referent == referent) return entry;
+        }
+        if (weak_group_match_empty(word)) return nil;
+        group = (group + step) & gmask;
+    }
+    return nil;
+}
 
-    size_t begin = hash_pointer(new_entry->referent) & (weak_table->mask);
-    size_t index = begin;
-    size_t hash_displacement = 0;
-    while (weak_entries[index].referent != nil) {
-        index = (index+1) & weak_table->mask;
-        if (index == begin) bad_weak_table(weak_entries);
-        hash_displacement++;
+
+/** 
+ * Claim a slot for a referent in the table's current arrays.
+ * Does not check whether the referent is already in the table.
+ * The caller copies the entry into the returned slot.
+ */
+static weak_entry_t *
+weak_arrays_claim(weak_table_t *weak_table, uintptr_t hash)
+{
+    size_t gmask = weak_group_mask(weak_table->mask);
+    size_t group = weak_h1(hash) & gmask;
+    for (size_t step = 1; step <= gmask + 1; step++) {
+        uint64_t word = weak_group_load(weak_table->weak_ctrl, group);
+        uint64_t m = weak_group_match_empty_or_deleted(word);
+        if (m) {
+            size_t index = group * WEAK_GROUP_WIDTH + weak_group_slot(m);
+            uint8_t &ctrl = weak_table->weak_ctrl[index];
+            if (ctrl == WEAK_CTRL_EMPTY) {
+                ASSERT(weak_table->growth_left > 0);
+                weak_table->growth_left--;
+            }
+            ctrl = weak_h2(hash);
+            return &weak_table->weak_entries[index];
+        }
+        group = (group + step) & gmask;
     }
+    bad_weak_table(weak_table->weak_entries);
+}
 
-    weak_entries[index] = *new_entry;
-    weak_table->num_entries++;
 
-    if (hash_displacement > weak_table->max_hash_displacement) {
-        weak_table->max_hash_displacement = hash_displacement;
+/** 
+ * Move up to count slots from the old arrays into the current ones.
+ * Frees the old arrays when they are empty.
+ */
+static void weak_resize_step(weak_table_t *weak_table, size_t count)
+{
+    if (!weak_table->old_entries) return;
+
+    size_t old_size = weak_table->old_mask + 1;
+    size_t end = old_size - weak_table->old_next > count 
+        ? weak_table->old_next + count : old_size;
+    for (size_t i = weak_table->old_next; i < end; i++) {
+        uint8_t &ctrl = weak_table->old_ctrl[i];
+        if (ctrl & 0x80) continue;  // empty or deleted
+
+        weak_entry_t *entry = &weak_table->old_entries[i];
+        *weak_arrays_claim(weak_table, hash_pointer(entry->referent)) = *entry;
+        memset(entry, 0, sizeof(*entry));
+        ctrl = WEAK_CTRL_DELETED;
+    }
+    weak_table->old_next = end;
+
+    if (end == old_size) {
+        free(weak_table->old_entries);
+        weak_table->old_entries = nil;
+        weak_table->old_ctrl = nil;
+        weak_table->old_mask = 0;
+        weak_table->old_next = 0;
     }
 }
 
 
-static void weak_resize(weak_table_t *weak_table, size_t new_size)
+/** 
+ * Start moving the table to arrays with room for its entries.
+ * Entries move over the next operations, a few groups at a time. 
+ * The new capacity leaves room for the entries that will be inserted 
+ * before the move finishes, and for the table to double.
+ */
+static void weak_resize(weak_table_t *weak_table)
 {
+    // Only one move at a time. This is normally already done.
+    weak_resize_step(weak_table, SIZE_MAX);
+
     size_t old_size = TABLE_SIZE(weak_table);
+    size_t needed = weak_table->num_entries + old_size / WEAK_RESIZE_STEP + 1;
+    if (needed < weak_table->num_entries * 2) {
+        needed = weak_table->num_entries * 2;
+    }
+    size_t new_size = 64;
+    while (new_size * 7 / 8 < needed) new_size *= 2;
 
-    weak_entry_t *old_entries = weak_table->weak_entries;
+    // One allocation: the entries, then the control bytes.
     weak_entry_t *new_entries = (weak_entry_t *)
-        calloc(new_size, sizeof(weak_entry_t));
-
-    weak_table->mask = new_size - 1;
-    weak_table->weak_entries = new_entries;
-    weak_table->max_hash_displacement = 0;
-    weak_table->num_entries = 0;  // restored by weak_entry_insert below
-    
-    if (old_entries) {
-        weak_entry_t *entry;
-        weak_entry_t *end = old_entries + old_size;
-        for (entry = old_entries; entry < end; entry++) {
-            if (entry->referent) {
-                weak_entry_insert(weak_table, entry);
-            }
-        }
-        free(old_entries);
+        calloc(new_size, sizeof(weak_entry_t) + 1);
+    uint8_t *new_ctrl = (uint8_t *)(new_entries + new_size);
+    memset(new_ctrl, WEAK_CTRL_EMPTY, new_size);
+
+    if (weak_table->weak_entries) {
+        weak_table->old_entries = weak_table->weak_entries;
+        weak_table->old_ctrl = weak_table->weak_ctrl;
+        weak_table->old_mask = weak_table->mask;
+        weak_table->old_next = 0;
     }
+    weak_table->weak_entries = new_entries;
+    weak_table->weak_ctrl = new_ctrl;
+    weak_table->mask = new_size - 1;
+    weak_table->growth_left = new_size * 7 / 8;
 }
 
 // Grow the given zone's table of weak references if it is full.
 static void weak_grow_maybe(weak_table_t *weak_table)
 {
-    size_t old_size = TABLE_SIZE(weak_table);
-
-    // Grow if at least 3/4 full.
-    if (weak_table->num_entries >= old_size * 3 / 4) {
-        weak_resize(weak_table, old_size ? old_size*2 : 64);
+    // Full means no empty slots left below 7/8 load. 
+    // Deleted slots are reclaimed by the resize.
+    if (weak_table->growth_left == 0) {
+        weak_resize(weak_table);
     }
 }
 
@@ -272,9 +397,10 @@ static void weak_compact_maybe(weak_table_t *weak_table)
     size_t old_size = TABLE_SIZE(weak_table);
 
     // Shrink if larger than 1024 buckets and at most 1/16 full.
-    if (old_size >= 1024  && old_size / 16 >= weak_table->num_entries) {
-        weak_resize(weak_table, old_size / 8);
-        // leaves new table no more than 1/2 full
+    if (!weak_table->old_entries  &&  
+        old_size >= 1024  &&  old_size / 16 >= weak_table->num_entries)
+    {
+        weak_resize(weak_table);
     }
 }
 
@@ -288,6 +414,14 @@ static void weak_entry_remove(weak_table_t *weak_table, weak_entry_t *entry)
     if (entry->out_of_line()) free(entry->referrers);
     memset(entry, 0, sizeof(*entry));
 
+    weak_entry_t *entries = weak_table->weak_entries;
+    uint8_t *ctrl = weak_table->weak_ctrl;
+    if (entry < entries  ||  entry > entries + weak_table->mask) {
+        entries = weak_table->old_entries;
+        ctrl = weak_table->old_ctrl;
+    }
+    ctrl[entry - entries] = WEAK_CTRL_DELETED;
+
     weak_table->num_entries--;
 
     weak_compact_maybe(weak_table);
@@ -309,23 +443,15 @@ weak_entry_for_referent(weak_table_t *weak_table, objc_object *referent)
 {
     ASSERT(referent);
 
-    weak_entry_t *weak_entries = weak_table->weak_entries;
-
-    if (!weak_entries) return nil;
-
-    size_t begin = hash_pointer(referent) & weak_table->mask;
-    size_t index = begin;
-    size_t hash_displacement = 0;
-    while (weak_table->weak_entries[index].referent != referent) {
-        index = (index+1) & weak_table->mask;
-        if (index == begin) bad_weak_table(weak_table->weak_entries);
-        hash_displacement++;
-        if (hash_displacement > weak_table->max_hash_displacement) {
-            return nil;
-        }
+    uintptr_t hash = hash_pointer(referent);
+    weak_entry_t *entry = 
+        weak_arrays_find(weak_table->weak_entries, weak_table->weak_ctrl, 
+                         weak_table->mask, referent, hash);
+    if (!entry  &&  weak_table->old_entries) {
+        entry = weak_arrays_find(weak_table->old_entries, weak_table->old_ctrl,
+                                 weak_table->old_mask, referent, hash);
     }
-    
-    return &weak_table->weak_entries[index];
+    return entry;
 }
 
 /** 
@@ -354,6 +480,8 @@ weak_unregister_no_lock(weak_table_t *weak_table, id referent_id,
 
     if (!referent) return;
 
+    weak_resize_step(weak_table, WEAK_RESIZE_STEP);
+
     if ((entry = weak_entry_for_referent(weak_table, referent))) {
         remove_referrer(entry, referrer);
         bool empty = true;
@@ -429,6 +557,8 @@ weak_register_no_lock(weak_table_t *weak_table, id referent_id,
     }
 
     // now remember it and where it is being stored
+    weak_resize_step(weak_table, WEAK_RESIZE_STEP);
+
     weak_entry_t *entry;
     if ((entry = weak_entry_for_referent(weak_table, referent))) {
         append_referrer(entry, referrer);
@@ -436,7 +566,8 @@ weak_register_no_lock(weak_table_t *weak_table, id referent_id,
     else {
         weak_entry_t new_entry(referent, referrer);
         weak_grow_maybe(weak_table);
-        weak_entry_insert(weak_table, &new_entry);
+        *weak_arrays_claim(weak_table, hash_pointer(referent)) = new_entry;
+        weak_table->num_entries++;
     }
 
     // Do not set *referrer. objc_storeWeak() requires that the 
@@ -467,6 +598,8 @@ weak_clear_no_lock(weak_table_t *weak_table, id referent_id)
 {
     objc_object *referent = (objc_object *)referent_id;
 
+    weak_resize_step(weak_table, WEAK_RESIZE_STEP);
+
     weak_entry_t *entry = weak_entry_for_referent(weak_table, referent);
     if (entry == nil) {
         /// XXX shouldn't happen, but does with mismatched CF/objc
@@ -49,6 +49,7 @@ class AtomicQueue {
     using pair_t = uint64_t;
 #endif
     static constexpr auto relaxed = std::memory_order_relaxed;
+    static constexpr auto acquire = std::memory_order_acquire;
     static constexpr auto release = std::memory_order_release;
 
     struct Entry {
@@ -73,6 +74,47 @@ public:
     }
 };
 
+/*
+ * Free elements of a packed zone are cached per thread in magazines of
+ * up to CONFIG_ZONE_MAGAZINE_SIZE elements, linked through each
+ * element's second word. As in Bonwick's magazine allocator, a thread
+ * has a loaded and a previous magazine for each zone. Allocations and
+ * frees use the loaded one. When it is empty or full, the thread swaps
+ * in the previous one if that can help, and only then takes a full
+ * magazine from the zone's depot or gives one back. A thread that
+ * allocates and frees around a magazine boundary does not touch the
+ * depot, and the depot's cache line moves once per magazine rather
+ * than once per element. The depot is an AtomicQueue of full
+ * magazines, linked through the first word of each magazine's first
+ * element.
+ */
+struct ZoneStatistics {
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> frees;
+    std::atomic<uint64_t> refills;  // magazines taken from the depot
+    std::atomic<uint64_t> spills;   // magazines given to the depot
+    std::atomic<uint64_t> slabs;    // slabs allocated with calloc
+};
+
+struct ZoneDepot {
+    AtomicQueue magazines;
+    ZoneStatistics stats;
+};
+
+struct ZoneMagazine {
+    void *head;             // free elements
+    unsigned count;
+};
+
+// A thread's magazines for one zone.
+struct ZoneThreadCache {
+    ZoneDepot *depot;       // zone this cache is for, or nullptr
+    ZoneMagazine loaded;
+    ZoneMagazine previous;  // empty or full
+    unsigned allocations;   // not yet added to depot->stats
+    unsigned frees;         // not yet added to depot->stats
+};
+
 template<class T, bool useMalloc>
 class Zone {
 };
@@ -80,21 +122,24 @@ class Zone {
 template<class T>
 class Zone<T, false> {
     struct Element {
-        Element *next;
-        char buf[sizeof(T) - sizeof(void *)];
+        Element *next;      // next magazine, in the depot
+        Element *batch;     // next element, in a magazine
+        char buf[sizeof(T) - 2 * sizeof(void *)];
     } __attribute__((packed));
 
-    static AtomicQueue _freelist;
-    static T *alloc_slow();
+    static ZoneDepot _depot;
+    static Element *alloc_slow(ZoneThreadCache *cache);
 
 public:
     static T *alloc();
     static void free(T *);
+    static constexpr const ZoneStatistics *stats() { return &_depot.stats; }
 };
 
 template<class T>
 class Zone<T, true> {
 public:
+    static constexpr const ZoneStatistics *stats() { return nullptr; }
     static inline T *alloc() {
         return reinterpret_cast<T *>(::calloc(sizeof(T), 1));
     }
@@ -33,6 +33,12 @@
 #include "objc-private.h"
 #include "objc-zalloc.h"
 
+#define ZONE_MAGAZINE_ZONES 4
+
+struct ZoneMagazines {
+    objc::ZoneThreadCache list[ZONE_MAGAZINE_ZONES];
+};
+
 namespace objc {
 
 void *AtomicQueue::pop()
@@ -41,13 +47,15 @@ void *AtomicQueue::pop()
 
     l1.pair = pair; // non atomic on purpose
 
+    // acquire pairs with push_list() so the rest of a popped magazine
+    // is visible, not just its first element.
     do {
         if (l1.head == nullptr) {
             return nullptr;
         }
         l2.head = l1.head->next;
         l2.gen  = l1.gen + 1;
-    } while (!atomic_pair.compare_exchange_weak(l1.pair, l2.pair, relaxed, relaxed));
+    } while (!atomic_pair.compare_exchange_weak(l1.pair, l2.pair, acquire, relaxed));
 
     return reinterpret_cast<void *>(l1.head);
 }
@@ -73,35 +81,136 @@ T gcd(T a, T b)
     return b == 0 ? a : gcd(b, a % b);
 }
 
+/***********************************************************************
+* Per-thread zone magazines.
+* A thread has a cache for each of the first ZONE_MAGAZINE_ZONES
+* packed zones it uses. Allocations from any further zones go to the
+* depot directly. The thread's ZoneMagazines hang off its
+* _objc_pthread_data, and are also kept in a TLS slot so the fast
+* paths need only one TLS load.
+**********************************************************************/
+static tls_fast(ZoneMagazines *) currentZoneMagazines;
+
+static ZoneThreadCache *zone_thread_cache(ZoneDepot *depot)
+{
+    ZoneMagazines *mags = currentZoneMagazines;
+    if (slowpath(!mags)) {
+        _objc_pthread_data *data = _objc_fetch_pthread_data(true);
+        if (!data) return nullptr;
+
+        mags = data->zoneMagazines;
+        if (!mags) {
+            mags = (ZoneMagazines *)calloc(1, sizeof(ZoneMagazines));
+            data->zoneMagazines = mags;
+        }
+        currentZoneMagazines = mags;
+    }
+    for (ZoneThreadCache &cache : mags->list) {
+        if (cache.depot == depot) return &cache;
+        if (!cache.depot) {
+            cache.depot = depot;
+            return &cache;
+        }
+    }
+    return nullptr;
+}
+
+static void zone_cache_flush_stats(ZoneThreadCache *cache)
+{
+    if (cache->allocations) {
+        cache->depot->stats.allocations.fetch_add(cache->allocations, std::memory_order_relaxed);
+        cache->allocations = 0;
+    }
+    if (cache->frees) {
+        cache->depot->stats.frees.fetch_add(cache->frees, std::memory_order_relaxed);
+        cache->frees = 0;
+    }
+}
+
+static void zone_magazine_spill(ZoneDepot *depot, ZoneMagazine *mag)
+{
+    if (!mag->head) return;
+    depot->magazines.push(mag->head);
+    depot->stats.spills.fetch_add(1, std::memory_order_relaxed);
+    mag->head = nullptr;
+    mag->count = 0;
+}
+
 template<class T>
-AtomicQueue Zone<T, false>::_freelist;
+ZoneDepot Zone<T, false>::_depot;
 
 template<class T>
-T *Zone<T, false>::alloc_slow()
+typename Zone<T, false>::Element *Zone<T, false>::alloc_slow(ZoneThreadCache *cache)
 {
+    if (cache) {
+        // The loaded magazine is empty. Use the previous one if it is full.
+        if (cache->previous.count) {
+            std::swap(cache->loaded, cache->previous);
+            Element *e = reinterpret_cast<Element *>(cache->loaded.head);
+            cache->loaded.head = e->batch;
+            cache->loaded.count--;
+            return e;
+        }
+    }
+
+    // Take a whole magazine from the depot.
+    Element *e = reinterpret_cast<Element *>(_depot.magazines.pop());
+    if (e) {
+        _depot.stats.refills.fetch_add(1, std::memory_order_relaxed);
+        if (cache) {
+            cache->loaded.head = e->batch;
+            cache->loaded.count = 0;
+            for (Element *rest = e->batch; rest; rest = rest->batch) {
+                cache->loaded.count++;
+            }
+        } else if (e->batch) {
+            _depot.magazines.push(e->batch);
+        }
+        return e;
+    }
+
     // our malloc aligns to 16 bytes and this code should be used for sizes
     // small enough that this should always be an actual malloc bucket.
     //
     // The point of this code is *NOT* speed but optimal density
     constexpr size_t n_elem = MALLOC_ALIGNMENT / gcd(sizeof(T), size_t{MALLOC_ALIGNMENT});
     Element *slab = reinterpret_cast<Element *>(::calloc(n_elem, sizeof(T)));
+    _depot.stats.slabs.fetch_add(1, std::memory_order_relaxed);
     for (size_t i = 1; i < n_elem - 1; i++) {
-        slab[i].next = &slab[i + 1];
+        slab[i].batch = &slab[i + 1];
+    }
+    if (cache) {
+        cache->loaded.head = &slab[1];
+        cache->loaded.count = n_elem - 1;
+    } else {
+        _depot.magazines.push(&slab[1]);
     }
-    _freelist.push_list(reinterpret_cast<void *>(&slab[1]),
-                        reinterpret_cast<void *>(&slab[n_elem - 1]));
-    return reinterpret_cast<T *>(&slab[0]);
+    return &slab[0];
 }
 
 template<class T>
 T *Zone<T, false>::alloc()
 {
-    void *e = _freelist.pop();
-    if (e) {
-        memset(e, 0, sizeof(void *));
-        return reinterpret_cast<T *>(e);
+    ZoneThreadCache *cache = zone_thread_cache(&_depot);
+    Element *e;
+    if (cache && cache->loaded.head) {
+        e = reinterpret_cast<Element *>(cache->loaded.head);
+        cache->loaded.head = e->batch;
+        cache->loaded.count--;
+    } else {
+        e = alloc_slow(cache);
+    }
+    e->next = nullptr;
+    e->batch = nullptr;
+
+    if (cache) {
+        if (++cache->allocations == CONFIG_ZONE_MAGAZINE_SIZE) {
+            zone_cache_flush_stats(cache);
+        }
+    } else {
+        _depot.stats.allocations.fetch_add(1, std::memory_order_relaxed);
     }
-    return alloc_slow();
+    return reinterpret_cast<T *>(e);
 }
 
 template<class T>
@@ -110,7 +219,29 @@ void Zone<T, false>::free(T *ptr)
     if (ptr) {
         Element *e = reinterpret_cast<Element *>(ptr);
         memset(e->buf, 0, sizeof(e->buf));
-        _freelist.push(e);
+        e->next = nullptr;
+
+        ZoneThreadCache *cache = zone_thread_cache(&_depot);
+        if (!cache) {
+            e->batch = nullptr;
+            _depot.magazines.push(e);
+            _depot.stats.frees.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (cache->loaded.count >= CONFIG_ZONE_MAGAZINE_SIZE) {
+            // The loaded magazine is full. Keep it as the previous one,
+            // giving the old previous one to the depot if it is full too.
+            if (cache->previous.count) {
+                zone_magazine_spill(&_depot, &cache->previous);
+            }
+            std::swap(cache->loaded, cache->previous);
+        }
+        e->batch = reinterpret_cast<Element *>(cache->loaded.head);
+        cache->loaded.head = e;
+        cache->loaded.count++;
+        if (++cache->frees == CONFIG_ZONE_MAGAZINE_SIZE) {
+            zone_cache_flush_stats(cache);
+        }
     }
 }
 
@@ -120,4 +251,69 @@ void Zone<T, false>::free(T *ptr)
 ZoneInstantiate(class_rw_t);
 ZoneInstantiate(class_rw_ext_t);
 
+// Per-class data that class_rw_ext_t does not need on every class
+// belongs in class_rw_ext_caches_t instead.
+static_assert(sizeof(class_rw_ext_t) % MALLOC_ALIGNMENT != 0,
+              "class_rw_ext_t must stay in a packed zone");
+
+#define ZoneDescribe(type) \
+	{ #type, sizeof(type), Zone<type, sizeof(type) % MALLOC_ALIGNMENT == 0>::stats() }
+
+// Zones whose statistics _objc_getZoneStatistics() reports.
+// Zones that call malloc directly have no statistics.
+static const struct {
+    const char *name;
+    size_t elementSize;
+    const ZoneStatistics *stats;
+} AllZones[] = {
+    ZoneDescribe(class_rw_t),
+    ZoneDescribe(class_rw_ext_t),
+};
+
+}
+
+
+/***********************************************************************
+* _destroyZoneMagazines
+* Return a thread's cached zone elements to their depots.
+* Called from the destructor of the thread's _objc_pthread_data.
+**********************************************************************/
+void _destroyZoneMagazines(struct ZoneMagazines *mags)
+{
+    if (!mags) return;
+    for (objc::ZoneThreadCache &cache : mags->list) {
+        if (!cache.depot) continue;
+        objc::zone_cache_flush_stats(&cache);
+        objc::zone_magazine_spill(cache.depot, &cache.loaded);
+        objc::zone_magazine_spill(cache.depot, &cache.previous);
+    }
+    if (objc::currentZoneMagazines == mags) objc::currentZoneMagazines = nullptr;
+    free(mags);
+}
+
+
+/***********************************************************************
+* _objc_getZoneStatistics
+* Copy the statistics of up to count packed zones into stats. 
+* Returns the number of packed zones.
+**********************************************************************/
+unsigned _objc_getZoneStatistics(struct objc_zone_statistics *stats, 
+                                 unsigned count)
+{
+    unsigned total = 0;
+    for (auto &zone : objc::AllZones) {
+        if (!zone.stats) continue;
+        if (total < count) {
+            objc_zone_statistics *out = &stats[total];
+            out->name = zone.name;
+            out->elementSize = zone.elementSize;
+            out->allocations = zone.stats->allocations.load(std::memory_order_relaxed);
+            out->frees = zone.stats->frees.load(std::memory_order_relaxed);
+            out->refills = zone.stats->refills.load(std::memory_order_relaxed);
+            out->spills = zone.stats->spills.load(std::memory_order_relaxed);
+            out->slabs = zone.stats->slabs.load(std::memory_order_relaxed);
+        }
+        total++;
+    }
+    return total;
 }
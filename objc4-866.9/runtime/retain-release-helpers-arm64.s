@@ -128,6 +128,10 @@ Lretry_retain_\reg:
 	tbz p17, HAS_DEFAULT_RR_BIT, LcustomRR_retain
 
 	tbz p16, NONPOINTER_ISA_BIT, LrawISA_retain    // If raw isa pointer, call into C.
+#if ISA_HAS_BIASED_RC
+	// Biased objects keep the owner's count outside the isa. Call into C.
+	tbnz p16, #ISA_BIASED_RC_BIT, Lbiased_retain
+#endif
 
 	// We now have:
 	// * Raw isa field in p16.
@@ -198,6 +202,12 @@ Loverflow_retain:
 	CLREX
 	b __objc_rootRetain
 
+#if ISA_HAS_BIASED_RC
+Lbiased_retain:
+	CLREX
+	b __objc_rootRetain
+#endif
+
 Ldeallocating_retain:
 	// Clear our exclusive load of the isa before returning.
 	CLREX
@@ -281,6 +291,10 @@ Lretry_release_\reg:
 	tbz p17, HAS_DEFAULT_RR_BIT, LcustomRR_release_\reg
 
 	tbz p16, NONPOINTER_ISA_BIT, LrawISA_release_\reg   // If raw isa pointer, call into C.
+#if ISA_HAS_BIASED_RC
+	// Biased objects keep the owner's count outside the isa. Call into C.
+	tbnz p16, #ISA_BIASED_RC_BIT, Lcall_root_release_\reg
+#endif
 
 	// We now have:
 	// * Raw isa field in p16.
@@ -0,0 +1,56 @@
+// TEST_ENV OBJC_ADAPTIVE_CACHES=YES
+// TEST_CONFIG MEM=mrc
+
+// With OBJC_ADAPTIVE_CACHES a flushed cache may shrink to fit the
+// selectors it held. Send a wide set of selectors, then a narrow set
+// across many flushes, and check every send still finds its method.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+
+#define SELS 512
+
+static SEL sels[SELS];
+
+static uintptr_t valueFor(int i) { return 0x2000 + i; }
+
+static void sendAll(Class cls, int count)
+{
+    for (int i = 0; i < count; i++) {
+        uintptr_t result = ((uintptr_t(*)(id, SEL))objc_msgSend)((id)cls, sels[i]);
+        testassert(result == valueFor(i));
+    }
+}
+
+int main()
+{
+    Class cls = objc_allocateClassPair([TestRoot class], "AdaptiveCaches", 0);
+    objc_registerClassPair(cls);
+    Class meta = object_getClass(cls);
+    for (int i = 0; i < SELS; i++) {
+        char *name;
+        asprintf(&name, "adaptiveSel%d", i);
+        sels[i] = sel_registerName(name);
+        free(name);
+        uintptr_t value = valueFor(i);
+        class_addMethod(meta, sels[i],
+                        imp_implementationWithBlock(^(id self __unused) { return value; }),
+                        "L@:");
+    }
+
+    // Grow the cache, then shrink it with a small working set.
+    sendAll(cls, SELS);
+    for (int round = 0; round < 200; round++) {
+        _objc_flush_caches(meta);
+        sendAll(cls, 4);
+    }
+
+    // Grow it again after shrinking.
+    _objc_flush_caches(meta);
+    sendAll(cls, SELS);
+    _objc_flush_caches(meta);
+    sendAll(cls, SELS);
+
+    succeed(__FILE__);
+}
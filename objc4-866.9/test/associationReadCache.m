@@ -0,0 +1,117 @@
+// TEST_CONFIG MEM=mrc
+
+// objc_getAssociatedObject() without the stripe lock for policies whose
+// getter does not retain. Sets must be seen by later gets, atomic
+// policies must still retain and autorelease, and a new object at a
+// deallocated object's address must not see the old associations.
+// Readers race with a writer, then get is timed for ASSIGN and
+// RETAIN_NONATOMIC against RETAIN.
+
+#include "test.h"
+#include <objc/runtime.h>
+#include <Foundation/Foundation.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+
+#define READERS 8
+#define ITERATIONS 10000000
+
+static char key;
+static id target;
+static id values[2];
+static _Atomic int done;
+
+static void *reader(void *arg __unused)
+{
+    while (!atomic_load(&done)) {
+        id value = objc_getAssociatedObject(target, &key);
+        testassert(value == values[0]  ||  value == values[1]);
+    }
+    return NULL;
+}
+
+static double timeGets(id obj, mach_timebase_info_data_t timebase)
+{
+    uint64_t start = mach_absolute_time();
+    for (int i = 0; i < ITERATIONS; i++) {
+        @autoreleasepool {
+            objc_getAssociatedObject(obj, &key);
+        }
+    }
+    uint64_t t = mach_absolute_time() - start;
+    return (double)t * timebase.numer / timebase.denom / ITERATIONS;
+}
+
+int main()
+{
+    values[0] = [NSObject new];
+    values[1] = [NSObject new];
+
+    // Sets are seen by the next get.
+    id obj = [NSObject new];
+    objc_setAssociatedObject(obj, &key, values[0], OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    testassert(objc_getAssociatedObject(obj, &key) == values[0]);
+    testassert(objc_getAssociatedObject(obj, &key) == values[0]);
+    objc_setAssociatedObject(obj, &key, values[1], OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    testassert(objc_getAssociatedObject(obj, &key) == values[1]);
+    objc_setAssociatedObject(obj, &key, nil, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    testassert(objc_getAssociatedObject(obj, &key) == nil);
+
+    // Atomic gets retain and autorelease every time.
+    objc_setAssociatedObject(obj, &key, values[0], OBJC_ASSOCIATION_RETAIN);
+    @autoreleasepool {
+        NSUInteger rc = [values[0] retainCount];
+        testassert(objc_getAssociatedObject(obj, &key) == values[0]);
+        testassert(objc_getAssociatedObject(obj, &key) == values[0]);
+        testassert([values[0] retainCount] == rc + 2);
+    }
+
+    // Deallocation forgets the cached values.
+    objc_setAssociatedObject(obj, &key, values[0], OBJC_ASSOCIATION_ASSIGN);
+    testassert(objc_getAssociatedObject(obj, &key) == values[0]);
+    uintptr_t oldAddress = (uintptr_t)obj;
+    [obj release];
+    int reused = 0;
+    for (int i = 0; i < 100; i++) {
+        id obj2 = [NSObject new];
+        if ((uintptr_t)obj2 == oldAddress) reused++;
+        testassert(objc_getAssociatedObject(obj2, &key) == nil);
+        [obj2 release];
+    }
+    testprintf("address reused %d times\n", reused);
+
+    // Readers race with a writer.
+    target = [NSObject new];
+    objc_setAssociatedObject(target, &key, values[0], OBJC_ASSOCIATION_ASSIGN);
+    pthread_t threads[READERS];
+    for (int t = 0; t < READERS; t++) {
+        pthread_create(&threads[t], NULL, &reader, NULL);
+    }
+    for (int i = 0; i < 200000; i++) {
+        objc_setAssociatedObject(target, &key, values[i & 1], OBJC_ASSOCIATION_ASSIGN);
+    }
+    atomic_store(&done, 1);
+    for (int t = 0; t < READERS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    // Benchmark.
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    objc_setAssociatedObject(target, &key, values[0], OBJC_ASSOCIATION_ASSIGN);
+    double assign = timeGets(target, timebase);
+    objc_setAssociatedObject(target, &key, values[0], OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    double nonatomic = timeGets(target, timebase);
+    objc_setAssociatedObject(target, &key, values[0], OBJC_ASSOCIATION_RETAIN);
+    double atomic = timeGets(target, timebase);
+    testprintf("get: ASSIGN %5.2f ns, RETAIN_NONATOMIC %5.2f ns, RETAIN %5.2f ns "
+               "(including an autorelease pool)\n", assign, nonatomic, atomic);
+
+    [target release];
+    testassert([values[0] retainCount] == 1);
+    [values[0] release];
+    [values[1] release];
+
+    succeed(__FILE__);
+}
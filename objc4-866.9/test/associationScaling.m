@@ -0,0 +1,157 @@
+// TEST_CONFIG MEM=mrc
+
+// Associated objects from 1, 8, and 64 threads. Each thread sets and
+// gets keys on its own objects, which spread over the association
+// stripes. The same run on one object shared by every thread puts all
+// of the traffic on a single stripe lock, as the old global
+// AssociationsManagerLock did. Also checks objects that move from
+// inline keys to a separate map and back, and removal at dealloc, and
+// reports the memory used by objects with one key.
+// associationScalingDenseMap.m runs the same with
+// OBJC_DISABLE_INLINE_ASSOCIATIONS=YES, which keeps every object's
+// keys in a DenseMap as before, to compare against.
+
+#include "test.h"
+#include <objc/runtime.h>
+#include <Foundation/Foundation.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+#include <malloc/malloc.h>
+
+#ifndef NAME
+#define NAME "associationScaling"
+#endif
+
+#define KEYS 6
+#define OBJECTS 16
+#define ITERATIONS 20000
+#define MAXTHREADS 64
+#define MEMOBJECTS 100000
+
+static char keys[KEYS];
+static id sharedObject;
+static id value;
+static _Atomic int startFlag;
+static bool useShared;
+
+static void *worker(void *arg __unused)
+{
+    id objs[OBJECTS];
+    for (int i = 0; i < OBJECTS; i++) {
+        objs[i] = useShared ? sharedObject : [NSObject new];
+    }
+
+    while (!atomic_load(&startFlag)) { }
+
+    for (int n = 0; n < ITERATIONS; n++) {
+        id obj = objs[n % OBJECTS];
+        const void *key = &keys[n % 2];
+        objc_setAssociatedObject(obj, key, value, OBJC_ASSOCIATION_RETAIN);
+        testassert(objc_getAssociatedObject(obj, key) == value);
+        testassert(objc_getAssociatedObject(obj, &keys[KEYS-1]) == nil);
+    }
+
+    if (!useShared) {
+        for (int i = 0; i < OBJECTS; i++) [objs[i] release];
+    }
+    return NULL;
+}
+
+static uint64_t run(int threadCount, bool shared)
+{
+    pthread_t threads[MAXTHREADS];
+    useShared = shared;
+    atomic_store(&startFlag, 0);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_create(&threads[t], NULL, &worker, NULL);
+    }
+    uint64_t start = mach_absolute_time();
+    atomic_store(&startFlag, 1);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    return mach_absolute_time() - start;
+}
+
+int main()
+{
+    value = [NSObject new];
+
+    // Grow past the inline keys, then shrink, then deallocate.
+    id obj = [NSObject new];
+    for (int k = 0; k < KEYS; k++) {
+        objc_setAssociatedObject(obj, &keys[k], value, OBJC_ASSOCIATION_RETAIN);
+        for (int j = 0; j <= k; j++) {
+            testassert(objc_getAssociatedObject(obj, &keys[j]) == value);
+        }
+    }
+    testassert([value retainCount] == 1 + KEYS);
+    for (int k = 0; k < KEYS; k += 2) {
+        objc_setAssociatedObject(obj, &keys[k], nil, OBJC_ASSOCIATION_RETAIN);
+        testassert(objc_getAssociatedObject(obj, &keys[k]) == nil);
+        testassert(objc_getAssociatedObject(obj, &keys[k+1]) == value);
+    }
+    testassert([value retainCount] == 1 + KEYS/2);
+    [obj release];
+    testassert([value retainCount] == 1);
+
+    // Removing one inline key keeps the others.
+    obj = [NSObject new];
+    for (int k = 0; k < 3; k++) {
+        objc_setAssociatedObject(obj, &keys[k], value, OBJC_ASSOCIATION_RETAIN);
+    }
+    objc_setAssociatedObject(obj, &keys[0], nil, OBJC_ASSOCIATION_RETAIN);
+    testassert(objc_getAssociatedObject(obj, &keys[1]) == value);
+    testassert(objc_getAssociatedObject(obj, &keys[2]) == value);
+    objc_removeAssociatedObjects(obj);
+    testassert(objc_getAssociatedObject(obj, &keys[1]) == nil);
+    testassert([value retainCount] == 1);
+    [obj release];
+
+    // One key, replaced and removed while inline.
+    obj = [NSObject new];
+    objc_setAssociatedObject(obj, &keys[0], value, OBJC_ASSOCIATION_RETAIN);
+    objc_setAssociatedObject(obj, &keys[0], obj, OBJC_ASSOCIATION_ASSIGN);
+    testassert(objc_getAssociatedObject(obj, &keys[0]) == obj);
+    testassert([value retainCount] == 1);
+    objc_setAssociatedObject(obj, &keys[0], nil, OBJC_ASSOCIATION_ASSIGN);
+    testassert(objc_getAssociatedObject(obj, &keys[0]) == nil);
+    objc_setAssociatedObject(obj, &keys[1], value, OBJC_ASSOCIATION_RETAIN);
+    testassert(objc_getAssociatedObject(obj, &keys[1]) == value);
+    [obj release];
+    testassert([value retainCount] == 1);
+
+    // Memory for objects with one key each, which is the usual case.
+    id *objs = (id *)malloc(MEMOBJECTS * sizeof(id));
+    for (int i = 0; i < MEMOBJECTS; i++) objs[i] = [NSObject new];
+    malloc_statistics_t before, after;
+    malloc_zone_statistics(NULL, &before);
+    for (int i = 0; i < MEMOBJECTS; i++) {
+        objc_setAssociatedObject(objs[i], &keys[0], value, OBJC_ASSOCIATION_ASSIGN);
+    }
+    malloc_zone_statistics(NULL, &after);
+    double bytes = (double)(after.size_in_use - before.size_in_use) / MEMOBJECTS;
+    testprintf("%s: %.0f bytes per object with one associated object\n",
+               NAME, bytes);
+    testassert(bytes < 256);
+    for (int i = 0; i < MEMOBJECTS; i++) [objs[i] release];
+    free(objs);
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    sharedObject = [NSObject new];
+    for (int threadCount = 1; threadCount <= MAXTHREADS; threadCount *= 8) {
+        uint64_t spread = run(threadCount, false);
+        uint64_t single = run(threadCount, true);
+        double ops = (double)threadCount * ITERATIONS * 3;
+        testprintf("%s: threads %2d: spread %7.2f ns/op, "
+                   "one stripe %7.2f ns/op\n", NAME, threadCount,
+                   spread * timebase.numer / timebase.denom / ops,
+                   single * timebase.numer / timebase.denom / ops);
+    }
+    [sharedObject release];
+    testassert([value retainCount] == 1);
+
+    succeed(NAME);
+}
@@ -0,0 +1,9 @@
+// TEST_ENV OBJC_DISABLE_INLINE_ASSOCIATIONS=YES
+// TEST_CONFIG MEM=mrc
+
+// associationScaling.m with every object's associated objects in a
+// DenseMap of its own, as before inline keys, for comparison.
+
+#define NAME "associationScalingDenseMap"
+
+#include "associationScaling.m"
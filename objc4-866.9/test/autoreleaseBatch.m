@@ -0,0 +1,118 @@
+// TEST_CONFIG MEM=mrc
+
+// objc_autoreleaseBatch: nil, tagged pointers, duplicates, RR
+// overrides, and batches that span several pool pages. The pool pop
+// must release each object as often as it appeared in the batch. Then
+// compare it with a per-element objc_autorelease loop.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+#include <Foundation/Foundation.h>
+#include <mach/mach_time.h>
+
+static int deallocs;
+
+@interface AutoreleaseBatchObject : NSObject @end
+@implementation AutoreleaseBatchObject
+-(void)dealloc {
+    deallocs++;
+    [super dealloc];
+}
+@end
+
+#define OBJECTS 10000
+#define ITERATIONS 200
+
+static id objs[OBJECTS];
+
+int main()
+{
+    // Duplicates, nil, and tagged pointers.
+    id obj = [AutoreleaseBatchObject new];
+    id tagged = (id)[NSNumber numberWithInt:1];
+    id small[] = { obj, nil, obj, tagged, obj };
+    @autoreleasepool {
+        objc_retainBatch(small, 5);
+        objc_autoreleaseBatch(small, 5);
+        testassert([obj retainCount] == 4);
+    }
+    testassert([obj retainCount] == 1);
+
+    // A run longer than one coalesced pool entry can count.
+    static id many[70000];
+    for (int i = 0; i < 70000; i++) many[i] = obj;
+    @autoreleasepool {
+        objc_retainBatch(many, 70000);
+        objc_autoreleaseBatch(many, 70000);
+        testassert([obj retainCount] == 70001);
+    }
+    testassert([obj retainCount] == 1);
+    [obj release];
+    testassert(deallocs == 1);
+
+    // Objects with RR overrides get real messages, in batch order.
+    id root = [TestRoot new];
+    id other = [AutoreleaseBatchObject new];
+    id mixed[] = { other, root, other, root };
+    TestRootAutorelease = 0;
+    @autoreleasepool {
+        objc_retainBatch(mixed, 4);
+        objc_autoreleaseBatch(mixed, 4);
+        testassert(TestRootAutorelease == 2);
+    }
+    testassert([other retainCount] == 1);
+    [root release];
+    [other release];
+    testassert(deallocs == 2);
+
+    // Fresh objects spanning several pages, in a nested pool.
+    deallocs = 0;
+    @autoreleasepool {
+        id outer = [AutoreleaseBatchObject new];
+        objc_autoreleaseBatch(&outer, 1);
+        @autoreleasepool {
+            for (int i = 0; i < OBJECTS; i++) {
+                objs[i] = [AutoreleaseBatchObject new];
+            }
+            objc_autoreleaseBatch(objs, OBJECTS);
+            testassert(deallocs == 0);
+        }
+        testassert(deallocs == OBJECTS);
+        // Autorelease after the batch still lands on the right page.
+        objc_autorelease([AutoreleaseBatchObject new]);
+    }
+    testassert(deallocs == OBJECTS + 2);
+
+    // Benchmark.
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    for (int i = 0; i < OBJECTS; i++) {
+        objs[i] = [AutoreleaseBatchObject new];
+    }
+    uint64_t loop = 0, batch = 0;
+    for (int n = 0; n < ITERATIONS; n++) {
+        @autoreleasepool {
+            objc_retainBatch(objs, OBJECTS);
+            uint64_t start = mach_absolute_time();
+            for (int i = 0; i < OBJECTS; i++) objc_autorelease(objs[i]);
+            loop += mach_absolute_time() - start;
+        }
+        @autoreleasepool {
+            objc_retainBatch(objs, OBJECTS);
+            uint64_t start = mach_absolute_time();
+            objc_autoreleaseBatch(objs, OBJECTS);
+            batch += mach_absolute_time() - start;
+        }
+    }
+    double perElement = (double)ITERATIONS * OBJECTS;
+    testprintf("autorelease: loop %6.2f ns/op, batch %6.2f ns/op\n",
+               loop * timebase.numer / timebase.denom / perElement,
+               batch * timebase.numer / timebase.denom / perElement);
+    for (int i = 0; i < OBJECTS; i++) {
+        testassert([objs[i] retainCount] == 1);
+        [objs[i] release];
+    }
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,82 @@
+// TEST_CONFIG MEM=mrc
+
+// Autorelease pool pages freed by a pop are stashed per thread and
+// reused by the next pool that outgrows its page. Runs push,
+// autorelease N, pop cycles at several depths and checks that every
+// object is released by its pop. Reports ns per cycle; set
+// OBJC_POOL_PAGE_STASH=0 to compare against freeing every page.
+
+#include "test.h"
+#include <objc/NSObject.h>
+#include <objc/objc-internal.h>
+#include <mach/mach_time.h>
+
+#define OBJECTS 2000000
+#define DISTINCT 16  // more than autorelease coalescing looks back
+
+static int deallocs;
+
+@interface PageStashObject : NSObject @end
+@implementation PageStashObject
+-(void)dealloc {
+    deallocs++;
+    [super dealloc];
+}
+@end
+
+static id objs[DISTINCT];
+
+static void cycle(int count)
+{
+    void *pool = objc_autoreleasePoolPush();
+    for (int i = 0; i < count; i++) {
+        objc_autorelease(objc_retain(objs[i % DISTINCT]));
+    }
+    objc_autoreleasePoolPop(pool);
+}
+
+int main()
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+
+    // Nested pools that each spill onto new pages.
+    deallocs = 0;
+    for (int n = 0; n < 10; n++) {
+        void *outer = objc_autoreleasePoolPush();
+        for (int i = 0; i < 3000; i++) {
+            objc_autorelease([PageStashObject new]);
+        }
+        void *inner = objc_autoreleasePoolPush();
+        for (int i = 0; i < 3000; i++) {
+            objc_autorelease([PageStashObject new]);
+        }
+        objc_autoreleasePoolPop(inner);
+        testassert(deallocs == n*6000 + 3000);
+        objc_autoreleasePoolPop(outer);
+        testassert(deallocs == (n+1)*6000);
+    }
+
+    for (int i = 0; i < DISTINCT; i++) {
+        objs[i] = [NSObject new];
+    }
+    for (int count = 10; count <= 100000; count *= 10) {
+        cycle(count);  // warm up
+        int cycles = OBJECTS / count;
+        uint64_t start = mach_absolute_time();
+        for (int n = 0; n < cycles; n++) {
+            cycle(count);
+        }
+        uint64_t t = mach_absolute_time() - start;
+        for (int i = 0; i < DISTINCT; i++) {
+            testassert([objs[i] retainCount] == 1);
+        }
+        testprintf("autorelease %6d: %10.1f ns/cycle\n", count,
+                   (double)t * timebase.numer / timebase.denom / cycles);
+    }
+    for (int i = 0; i < DISTINCT; i++) {
+        [objs[i] release];
+    }
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,258 @@
+// TEST_ENV OBJC_BIASED_RC=YES
+// TEST_CONFIG MEM=mrc
+
+// With OBJC_BIASED_RC the allocating thread keeps its retains of its
+// objects in a table of its own. Check retain counts and deallocation
+// when other threads retain and release too, including releases taken
+// from the owner's share, owners that exit or block, owners with many
+// objects, and objects freed by object_dispose(). Then compare the
+// cost of retain/release on the owner thread with the shared count.
+
+#include "test.h"
+#include <objc/objc-internal.h>
+#include <objc/runtime.h>
+#include <Foundation/Foundation.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+#include <sched.h>
+
+// More objects than an owner's first table holds.
+#define MANY 5000
+
+static _Atomic int deallocs;
+
+@interface BiasedObject : NSObject @end
+@implementation BiasedObject
+-(void)dealloc {
+    atomic_fetch_add(&deallocs, 1);
+    [super dealloc];
+}
+@end
+
+// Not biased: retain and release are overridden.
+@interface CustomRRObject : BiasedObject @end
+@implementation CustomRRObject
+-(id)retain { return [super retain]; }
+-(oneway void)release { [super release]; }
+@end
+
+static void *releaseOnce(void *arg)
+{
+    [(id)arg release];
+    return NULL;
+}
+
+static void *retainAndRelease(void *arg)
+{
+    for (int i = 0; i < 100000; i++) {
+        [(id)arg retain];
+        [(id)arg release];
+    }
+    return NULL;
+}
+
+static void *disposeOnce(void *arg)
+{
+    object_dispose((id)arg);
+    return NULL;
+}
+
+static void *releaseAll(void *arg)
+{
+    id *objs = (id *)arg;
+    for (int i = 0; i < MANY; i++) [objs[i] release];
+    return NULL;
+}
+
+static _Atomic int ownerState;
+
+// Allocates an object and holds two references until told to stop.
+static void *allocAndBlock(void *arg)
+{
+    id obj = [BiasedObject new];
+    [obj retain];
+    *(id *)arg = obj;
+    atomic_store(&ownerState, 1);
+    while (atomic_load(&ownerState) != 2) sched_yield();
+    [obj release];
+    [obj release];
+    return NULL;
+}
+
+static void *allocAndExit(void *arg __unused)
+{
+    id obj = [BiasedObject new];
+    [obj retain];
+    [obj retain];
+    return obj;
+}
+
+static void runThread(void *(*fn)(void *), void *arg, void **result)
+{
+    pthread_t th;
+    pthread_create(&th, NULL, fn, arg);
+    pthread_join(th, result);
+}
+
+#define ITERATIONS 10000000
+
+static double timeRetainRelease(id obj, mach_timebase_info_data_t timebase)
+{
+    uint64_t start = mach_absolute_time();
+    for (int i = 0; i < ITERATIONS; i++) {
+        objc_retain(obj);
+        objc_release(obj);
+    }
+    uint64_t t = mach_absolute_time() - start;
+    return (double)t * timebase.numer / timebase.denom / (ITERATIONS * 2);
+}
+
+int main()
+{
+    // Owner only.
+    id obj = [BiasedObject new];
+    for (int i = 0; i < 1000; i++) [obj retain];
+    testassert([obj retainCount] == 1001);
+    for (int i = 0; i < 1000; i++) [obj release];
+    testassert([obj retainCount] == 1);
+    [obj release];
+    testassert(deallocs == 1);
+
+    // Another thread retains and releases the shared count;
+    // the owner's last release deallocates.
+    obj = [BiasedObject new];
+    runThread(retainAndRelease, obj, NULL);
+    testassert([obj retainCount] == 1);
+    [obj release];
+    testassert(deallocs == 2);
+
+    // Another thread releases the last reference, which was in the
+    // owner's share. It deallocates the object at once.
+    obj = [BiasedObject new];
+    [obj retain];
+    [obj release];
+    runThread(releaseOnce, obj, NULL);
+    testassert(deallocs == 3);
+
+    // retainCount includes the owner's share, less the releases
+    // other threads took from it.
+    obj = [BiasedObject new];
+    [obj retain];
+    [obj retain];
+    runThread(releaseOnce, obj, NULL);
+    testassert([obj retainCount] == 2);
+    [obj release];
+    testassert([obj retainCount] == 1);
+    [obj release];
+    testassert(deallocs == 4);
+
+    // Weak references to a biased object.
+    obj = [BiasedObject new];
+    id weak = nil;
+    objc_storeWeak(&weak, obj);
+    id loaded = objc_loadWeakRetained(&weak);
+    testassert(loaded == obj);
+    [loaded release];
+    [obj release];
+    testassert(deallocs == 5);
+    testassert(objc_loadWeakRetained(&weak) == nil);
+    objc_destroyWeak(&weak);
+
+    // The owner exits with references outstanding.
+    void *result;
+    runThread(allocAndExit, NULL, &result);
+    obj = (id)result;
+    testassert([obj retainCount] == 3);
+    [obj release];
+    [obj release];
+    testassert(deallocs == 5);
+    [obj release];
+    testassert(deallocs == 6);
+
+    // retainCount counts the share of an owner that is still running,
+    // and the last release here deallocates while the owner waits.
+    atomic_store(&ownerState, 0);
+    pthread_t owner;
+    pthread_create(&owner, NULL, &allocAndBlock, &obj);
+    while (atomic_load(&ownerState) != 1) sched_yield();
+    testassert([obj retainCount] == 2);
+    [obj retain];
+    testassert([obj retainCount] == 3);
+    atomic_store(&ownerState, 2);
+    pthread_join(owner, NULL);
+    testassert(deallocs == 6);
+    testassert([obj retainCount] == 1);
+    [obj release];
+    testassert(deallocs == 7);
+
+    // An owner with many objects, each released for the last time
+    // on another thread.
+    id *objs = (id *)malloc(MANY * sizeof(id));
+    for (int i = 0; i < MANY; i++) {
+        objs[i] = [BiasedObject new];
+        [objs[i] retain];
+    }
+    for (int i = 0; i < MANY; i++) {
+        testassert([objs[i] retainCount] == 2);
+        [objs[i] release];
+    }
+    runThread(releaseAll, objs, NULL);
+    testassert(deallocs == 7 + MANY);
+    free(objs);
+
+    // Several threads and the owner at once.
+    obj = [BiasedObject new];
+    pthread_t threads[8];
+    for (int t = 0; t < 8; t++) {
+        pthread_create(&threads[t], NULL, &retainAndRelease, obj);
+    }
+    for (int i = 0; i < 100000; i++) {
+        [obj retain];
+        [obj release];
+    }
+    for (int t = 0; t < 8; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    testassert([obj retainCount] == 1);
+    [obj release];
+    testassert(deallocs == 8 + MANY);
+
+    // A class with custom retain/release uses the shared count only,
+    // so another thread's last release deallocates at once.
+    obj = [CustomRRObject new];
+    runThread(releaseOnce, obj, NULL);
+    testassert(deallocs == 9 + MANY);
+
+    // object_dispose() by the owner and by another thread. New objects
+    // that may reuse the memory have the usual retain counts.
+    for (int i = 0; i < 100; i++) {
+        obj = [BiasedObject new];
+        [obj retain];
+        if (i % 2) object_dispose(obj);
+        else runThread(disposeOnce, obj, NULL);
+        obj = [BiasedObject new];
+        testassert([obj retainCount] == 1);
+        [obj retain];
+        runThread(releaseOnce, obj, NULL);
+        [obj release];
+        testassert(deallocs == 10 + MANY + i);
+    }
+
+    // Benchmark the owner against the shared count.
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    id owned = [BiasedObject new];
+    runThread(allocAndExit, NULL, &result);
+    id shared = (id)result;
+    testprintf("owner %5.2f ns/op, shared %5.2f ns/op\n",
+               timeRetainRelease(owned, timebase),
+               timeRetainRelease(shared, timebase));
+    [owned release];
+    [shared release];
+    [shared release];
+    [shared release];
+    testassert(deallocs == 111 + MANY);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,122 @@
+// TEST_ENV OBJC_BIASED_RC=YES
+// TEST_CONFIG MEM=mrc ARCH=arm64 OS=!iphonesimulator,!appletvsimulator,!watchsimulator
+
+// OBJC_BIASED_RC takes isa bit 43 on arm64, between weakly_referenced
+// and has_sidetable_rc. Check the raw isa bits as objc_retain() and
+// objc_release() change them, so the assembly fast paths send biased
+// objects to the runtime and leave the neighboring bits alone.
+
+#include "test.h"
+#include <objc/objc-internal.h>
+#include <Foundation/Foundation.h>
+#include <pthread.h>
+
+// From isa.h for arm64 without pointer authentication.
+#define WEAKLY_REFERENCED_BIT 42
+#define BIASED_RC_BIT 43
+#define HAS_SIDETABLE_RC_BIT 44
+#define EXTRA_RC_SHIFT 45
+#define RC_HALF (1UL << 18)
+
+static int deallocs;
+
+@interface BiasedIsaObject : NSObject @end
+@implementation BiasedIsaObject
+-(void)dealloc {
+    deallocs++;
+    [super dealloc];
+}
+@end
+
+static uintptr_t isaBits(id obj) { return *(uintptr_t *)obj; }
+static bool isBiased(id obj) { return (isaBits(obj) >> BIASED_RC_BIT) & 1; }
+static bool isWeaklyReferenced(id obj) { return (isaBits(obj) >> WEAKLY_REFERENCED_BIT) & 1; }
+static bool hasSidetableRC(id obj) { return (isaBits(obj) >> HAS_SIDETABLE_RC_BIT) & 1; }
+static uintptr_t extraRC(id obj) { return isaBits(obj) >> EXTRA_RC_SHIFT; }
+
+static void *retainShared(void *arg)
+{
+    objc_retain((id)arg);
+    return NULL;
+}
+
+static void *releaseShared(void *arg)
+{
+    objc_release((id)arg);
+    return NULL;
+}
+
+static void *retainManyShared(void *arg)
+{
+    for (uintptr_t i = 0; i < RC_HALF * 2; i++) objc_retain((id)arg);
+    return NULL;
+}
+
+static void *releaseManyShared(void *arg)
+{
+    for (uintptr_t i = 0; i < RC_HALF * 2; i++) objc_release((id)arg);
+    return NULL;
+}
+
+static void runThread(void *(*fn)(void *), void *arg)
+{
+    pthread_t th;
+    pthread_create(&th, NULL, fn, arg);
+    pthread_join(th, NULL);
+}
+
+int main()
+{
+    // A biased object starts with an empty shared count.
+    id obj = [BiasedIsaObject new];
+    uintptr_t initial = isaBits(obj);
+    testassert(isBiased(obj));
+    testassert(extraRC(obj) == 0);
+    testassert(!hasSidetableRC(obj));
+
+    // The owner's objc_retain and objc_release leave the isa alone.
+    objc_retain(obj);
+    testassert(isaBits(obj) == initial);
+    testassert([obj retainCount] == 2);
+    objc_release(obj);
+    testassert(isaBits(obj) == initial);
+    testassert([obj retainCount] == 1);
+
+    // Other threads use extra_rc and keep the bias.
+    runThread(retainShared, obj);
+    testassert(isBiased(obj));
+    testassert(extraRC(obj) == 1);
+    testassert([obj retainCount] == 2);
+    runThread(releaseShared, obj);
+    testassert(isaBits(obj) == initial);
+
+    // A weak reference sets the bit below.
+    id weak = nil;
+    objc_storeWeak(&weak, obj);
+    testassert(isWeaklyReferenced(obj));
+    testassert(isBiased(obj));
+    testassert(extraRC(obj) == 0);
+
+    // Overflowing extra_rc sets the bit above.
+    runThread(retainManyShared, obj);
+    testassert(isBiased(obj));
+    testassert(hasSidetableRC(obj));
+    testassert([obj retainCount] == 1 + RC_HALF * 2);
+    runThread(releaseManyShared, obj);
+    testassert(isBiased(obj));
+    testassert([obj retainCount] == 1);
+
+    // The last release ends the bias and deallocates.
+    objc_release(obj);
+    testassert(deallocs == 1);
+    testassert(objc_loadWeakRetained(&weak) == nil);
+    objc_destroyWeak(&weak);
+
+    // Released last on another thread, the object is unbiased by that
+    // thread's objc_release and deallocated there.
+    obj = [BiasedIsaObject new];
+    runThread(releaseShared, obj);
+    testassert(deallocs == 2);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,92 @@
+// TEST_ENV OBJC_DEBUG_SCRIBBLE_CACHES=YES
+// TEST_CONFIG MEM=mrc
+
+// Dead method caches are freed once every online thread has passed a
+// quiescent state. Threads send messages between autorelease pool pops,
+// _objc_cacheQuiescentState() calls, or sleeps spent offline, while the
+// main thread keeps growing and flushing the caches. Freed caches are
+// scribbled, so a cache freed too early sends a message to a bad IMP.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#define SELS 128
+#define THREADS 9
+
+static SEL sels[SELS];
+static Class cls;
+static _Atomic int done;
+
+static uintptr_t valueFor(int i) { return 0x4000 + i; }
+
+static void sendAll(void)
+{
+    for (int i = 0; i < SELS; i++) {
+        uintptr_t result = ((uintptr_t(*)(id, SEL))objc_msgSend)((id)cls, sels[i]);
+        testassert(result == valueFor(i));
+    }
+}
+
+enum { UsePools, UseQuiescentStates, UseOffline };
+
+static void *sender(void *arg)
+{
+    int mode = (int)(intptr_t)arg;
+    while (!atomic_load(&done)) {
+        if (mode == UsePools) {
+            void *pool = objc_autoreleasePoolPush();
+            sendAll();
+            objc_autoreleasePoolPop(pool);
+        } else if (mode == UseQuiescentStates) {
+            sendAll();
+            _objc_cacheQuiescentState();
+        } else {
+            sendAll();
+            _objc_cacheThreadOffline();
+            usleep(100);
+            _objc_cacheThreadOnline();
+        }
+    }
+    return NULL;
+}
+
+int main()
+{
+    cls = objc_allocateClassPair([TestRoot class], "CacheEpochs", 0);
+    objc_registerClassPair(cls);
+    Class meta = object_getClass(cls);
+    for (int i = 0; i < SELS; i++) {
+        char *name;
+        asprintf(&name, "cacheEpochSel%d", i);
+        sels[i] = sel_registerName(name);
+        free(name);
+        uintptr_t value = valueFor(i);
+        class_addMethod(meta, sels[i],
+                        imp_implementationWithBlock(^(id self __unused) { return value; }),
+                        "L@:");
+    }
+    sendAll();
+
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &sender, (void *)(intptr_t)(t % 3));
+    }
+
+    for (int round = 0; round < 2000; round++) {
+        _objc_flush_caches(meta);
+        sendAll();
+    }
+    // Flushing everything also collects as much garbage as possible.
+    _objc_flush_caches(nil);
+
+    atomic_store(&done, 1);
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    succeed(__FILE__);
+}
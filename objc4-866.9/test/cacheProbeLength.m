@@ -0,0 +1,136 @@
+// TEST_CONFIG MEM=mrc
+
+// Method cache probe lengths and lookup time for real selector sets.
+// The selectors of the classes with the most instance methods in the
+// process are replayed into replacement classes, so the cache sees the
+// same SEL addresses and hashes as the original classes would.
+// Probe lengths come from objc_cache_lookup(), the portable version of
+// the cache scan. cacheProbeLengthRobinHood.m runs the same replay
+// with OBJC_ROBIN_HOOD_CACHES=YES.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+#include <mach/mach_time.h>
+
+#define MAXCLASSES 8
+#define MINSELS 64
+#define ROUNDS 200
+
+static uintptr_t valueFor(unsigned i) { return 0x3000 + i; }
+
+#ifndef NAME
+#define NAME "cacheProbeLength"
+#endif
+
+static void replay(const char *name, SEL *sels, unsigned count,
+                   mach_timebase_info_data_t timebase)
+{
+    char *replayName;
+    asprintf(&replayName, "CacheReplay_%s", name);
+    Class cls = objc_allocateClassPair([TestRoot class], replayName, 0);
+    free(replayName);
+    for (unsigned i = 0; i < count; i++) {
+        uintptr_t value = valueFor(i);
+        class_addMethod(cls, sels[i],
+                        imp_implementationWithBlock(^(id self __unused) { return value; }),
+                        "L@:");
+    }
+    objc_registerClassPair(cls);
+    id obj = class_createInstance(cls, 0);
+
+    // Fill the cache, then verify every entry through the portable scan.
+    for (unsigned i = 0; i < count; i++) {
+        uintptr_t result = ((uintptr_t(*)(id, SEL))objc_msgSend)(obj, sels[i]);
+        testassert(result == valueFor(i));
+    }
+
+    unsigned cached = 0, totalProbes = 0, maxProbes = 0;
+    for (unsigned i = 0; i < count; i++) {
+        unsigned probes;
+        IMP imp = objc_cache_lookup(_class_getCache(cls), sels[i], &probes);
+        if (!imp) continue;  // evicted when the cache grew
+        testassert(imp == class_getMethodImplementation(cls, sels[i]));
+        cached++;
+        totalProbes += probes;
+        if (probes > maxProbes) maxProbes = probes;
+    }
+    testassert(cached > 0);
+    testassert(cached <= objc_cache_occupied(_class_getCache(cls)));
+
+    uint64_t minMsgSend = UINT64_MAX, minLookup = UINT64_MAX;
+    for (int r = 0; r < ROUNDS; r++) {
+        uint64_t start = mach_absolute_time();
+        for (unsigned i = 0; i < count; i++) {
+            ((uintptr_t(*)(id, SEL))objc_msgSend)(obj, sels[i]);
+        }
+        uint64_t t = mach_absolute_time() - start;
+        if (t < minMsgSend) minMsgSend = t;
+
+        start = mach_absolute_time();
+        for (unsigned i = 0; i < count; i++) {
+            objc_cache_lookup(_class_getCache(cls), sels[i], NULL);
+        }
+        t = mach_absolute_time() - start;
+        if (t < minLookup) minLookup = t;
+    }
+
+    testprintf("%-40s %4u sels, %4u cached in %5u slots: "
+               "mean probe %.2f, max %2u; "
+               "%5.2f ns/msgSend, %5.2f ns/lookup\n",
+               name, count, cached, objc_cache_capacity(_class_getCache(cls)),
+               (double)totalProbes / cached, maxProbes,
+               (double)minMsgSend * timebase.numer / timebase.denom / count,
+               (double)minLookup * timebase.numer / timebase.denom / count);
+}
+
+int main()
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+
+    // Pick the classes with the most instance methods.
+    unsigned classCount;
+    Class *classes = objc_copyClassList(&classCount);
+    Class chosen[MAXCLASSES] = {};
+    unsigned chosenCounts[MAXCLASSES] = {};
+    for (unsigned c = 0; c < classCount; c++) {
+        unsigned count;
+        free(class_copyMethodList(classes[c], &count));
+        if (count < MINSELS) continue;
+        for (int k = 0; k < MAXCLASSES; k++) {
+            if (count > chosenCounts[k]) {
+                memmove(&chosen[k+1], &chosen[k], (MAXCLASSES-k-1) * sizeof(Class));
+                memmove(&chosenCounts[k+1], &chosenCounts[k], (MAXCLASSES-k-1) * sizeof(unsigned));
+                chosen[k] = classes[c];
+                chosenCounts[k] = count;
+                break;
+            }
+        }
+    }
+    free(classes);
+
+    for (int k = 0; k < MAXCLASSES && chosen[k]; k++) {
+        unsigned count;
+        Method *methods = class_copyMethodList(chosen[k], &count);
+        SEL *sels = (SEL *)malloc(count * sizeof(SEL));
+        for (unsigned i = 0; i < count; i++) {
+            sels[i] = method_getName(methods[i]);
+        }
+        free(methods);
+        replay(class_getName(chosen[k]), sels, count, timebase);
+        free(sels);
+    }
+
+    // Always measure a synthetic set too, in case few classes are loaded.
+    SEL sels[512];
+    for (unsigned i = 0; i < 512; i++) {
+        char *name;
+        asprintf(&name, "cacheProbeSel%u:with:%u", i, i * 7);
+        sels[i] = sel_registerName(name);
+        free(name);
+    }
+    replay("synthetic", sels, 512, timebase);
+
+    succeed(NAME);
+}
@@ -0,0 +1,8 @@
+// TEST_ENV OBJC_ROBIN_HOOD_CACHES=YES
+// TEST_CONFIG MEM=mrc
+
+// cacheProbeLength.m with dense caches filled in Robin-Hood order.
+
+#define NAME "cacheProbeLengthRobinHood"
+
+#include "cacheProbeLength.m"
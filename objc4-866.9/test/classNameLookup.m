@@ -0,0 +1,105 @@
+// TEST_CFLAGS -Wno-deprecated-declarations
+// TEST_CONFIG MEM=mrc
+
+// Class lookups by name go through the runtime's named class table,
+// which remembers recent misses. Adds and removes many classes and
+// checks that every lookup agrees with what is registered, that a miss
+// is forgotten once a class of that name is added, that Swift names
+// find their mangled classes however long they are, and that the
+// debugger table gdb_objc_realized_classes stays in step.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+#include <objc/objc-gdb.h>
+#include <mach/mach_time.h>
+
+#define CLASSES 5000
+#define LOOKUPS 1000000
+
+static Class classes[CLASSES];
+
+static void nameOf(int i, char *buf, size_t size)
+{
+    snprintf(buf, size, "ClassNameLookup%d", i);
+}
+
+static Class make(const char *name)
+{
+    Class cls = objc_allocateClassPair([TestRoot class], name, 0);
+    testassert(cls);
+    objc_registerClassPair(cls);
+    return cls;
+}
+
+int main()
+{
+    char name[64];
+
+    // A miss is forgotten when the class is added.
+    testassert(!objc_getClass("ClassNameLookupLate"));
+    testassert(!objc_getClass("ClassNameLookupLate"));
+    Class late = make("ClassNameLookupLate");
+    testassert(objc_getClass("ClassNameLookupLate") == late);
+
+    // Enough classes to grow the table.
+    for (int i = 0; i < CLASSES; i++) {
+        nameOf(i, name, sizeof(name));
+        testassert(!objc_lookUpClass(name));
+        classes[i] = make(name);
+    }
+    // Remove every third class, then check them all.
+    for (int i = 0; i < CLASSES; i += 3) {
+        objc_disposeClassPair(classes[i]);
+        classes[i] = nil;
+    }
+    for (int i = 0; i < CLASSES; i++) {
+        nameOf(i, name, sizeof(name));
+        // A copy of the name, not the class's own pointer.
+        char *copy = strdup(name);
+        testassert(objc_lookUpClass(copy) == classes[i]);
+        testassert(objc_lookUpClass(copy) == classes[i]);
+        testassert((Class)NXMapGet(gdb_objc_realized_classes, copy) == classes[i]);
+        free(copy);
+    }
+    // Removed names can be used again.
+    for (int i = 0; i < CLASSES; i += 3) {
+        nameOf(i, name, sizeof(name));
+        classes[i] = make(name);
+        testassert(objc_lookUpClass(name) == classes[i]);
+    }
+
+    // Swift names find their mangled classes.
+    Class swift = make("_TtC16ClassNameLookup5Thing");
+    testassert(objc_getClass("ClassNameLookup.Thing") == swift);
+    testassert(!objc_getClass("ClassNameLookup.Other"));
+
+    char longName[400], longMangled[420];
+    memset(longName, 'x', 300);
+    longName[300] = 0;
+    snprintf(longMangled, sizeof(longMangled), "_TtC6Module300%s", longName);
+    char longDemangled[420];
+    snprintf(longDemangled, sizeof(longDemangled), "Module.%s", longName);
+    testassert(!objc_getClass(longDemangled));
+    Class longSwift = make(longMangled);
+    testassert(objc_getClass(longDemangled) == longSwift);
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    uint64_t start = mach_absolute_time();
+    for (int i = 0; i < LOOKUPS; i++) {
+        objc_lookUpClass("ClassNameLookup1");
+    }
+    testprintf("%.2f ns per lookup (hit)\n",
+               (double)(mach_absolute_time() - start) * timebase.numer
+               / timebase.denom / LOOKUPS);
+    start = mach_absolute_time();
+    for (int i = 0; i < LOOKUPS; i++) {
+        objc_lookUpClass("ClassNameLookup.Missing");
+    }
+    testprintf("%.2f ns per lookup (miss)\n",
+               (double)(mach_absolute_time() - start) * timebase.numer
+               / timebase.denom / LOOKUPS);
+
+    succeed(__FILE__);
+}
@@ -79,5 +79,12 @@ int main()
     unsignedROContents[4] = ptrauth_strip(unsignedROContents[4], ptrauth_key_process_independent_data);
     testassert(strcmp(objc_debug_class_getNameRaw(ClassWithUnsignedClassRO_raw), "ClassWithUnsignedClassRO") == 0);
 
+    // Side table stripes: both symbols find the same first stripe.
+    void **stripes = (void **)objc_debug_side_table_stripes;
+    uintptr_t stripeMask = (uintptr_t)stripes[1];
+    testassert(stripes[0] == objc_debug_side_tables_map);
+    testassert(stripeMask + 1 >= 8);
+    testassert((stripeMask & (stripeMask + 1)) == 0);
+
     succeed(__FILE__);
 }
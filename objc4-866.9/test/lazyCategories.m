@@ -0,0 +1,150 @@
+// TEST_CFLAGS -Wl,-no_objc_category_merging
+// TEST_CONFIG MEM=mrc
+
+// Classes with +load are realized before this image's categories are
+// loaded, so their categories are attached when each class is first
+// used instead. Checks that the categories are seen, in load order,
+// whether the class is first messaged, reflected on, or given new
+// methods. lazyCategoriesDisabled.m checks the same with
+// OBJC_DISABLE_LAZY_CATEGORIES=YES.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+
+#ifndef NAME
+#define NAME "lazyCategories"
+#endif
+
+@protocol LazyProtocol @end
+
+// First used by a message.
+@interface LazyMessaged : TestRoot @end
+@implementation LazyMessaged
++(void)load { }
+-(int)override { return 0; }
++(int)classOverride { return 0; }
+@end
+
+// First used by reflection.
+@interface LazyReflected : TestRoot @end
+@implementation LazyReflected
++(void)load { }
+-(int)override { return 0; }
+@end
+
+// First used by class_addMethod().
+@interface LazyAdded : TestRoot @end
+@implementation LazyAdded
++(void)load { }
+@end
+
+@interface LazyMessaged (First) @end
+@implementation LazyMessaged (First)
+-(int)override { return 1; }
+-(int)first { return 1; }
++(int)classOverride { return 1; }
+@end
+
+@interface LazyMessaged (Second) @end
+@implementation LazyMessaged (Second)
+-(int)override { return 2; }
++(int)classOverride { return 2; }
+@end
+
+@interface LazyReflected (First) <LazyProtocol>
+@property int lazyProperty;
+@end
+@implementation LazyReflected (First)
+-(int)override { return 1; }
+-(int)lazyProperty { return 1; }
+-(void)setLazyProperty:(int)value __unused { }
+@end
+
+@interface LazyAdded (First) @end
+@implementation LazyAdded (First)
+-(int)fromCategory { return 1; }
+@end
+
+// Added by class_addMethod().
+@interface LazyAdded (Added)
+-(int)fromAdd;
+@end
+
+static int added(id self __unused, SEL _cmd __unused) { return 2; }
+
+static bool hasMethod(Class cls, SEL sel)
+{
+    unsigned int count;
+    Method *methods = class_copyMethodList(cls, &count);
+    bool found = false;
+    for (unsigned int i = 0; i < count; i++) {
+        if (method_getName(methods[i]) == sel) found = true;
+    }
+    free(methods);
+    return found;
+}
+
+int main()
+{
+    struct objc_lazy_category_statistics before;
+    _objc_getLazyCategoryStatistics(&before);
+    testprintf("%zu deferred, %zu attached, %zu classes pending, "
+               "%zu without class_rw_ext_t\n",
+               before.deferredCategories, before.attachedCategories,
+               before.pendingClasses, before.avoidedExtAllocations);
+#if LAZY_DISABLED
+    testassert(before.deferredCategories == 0);
+    testassert(before.pendingClasses == 0);
+#else
+    // Both sides of LazyMessaged's two categories and of LazyReflected's,
+    // which adopts a protocol, and LazyAdded's instance side.
+    testassert(before.deferredCategories >= 7);
+    testassert(before.pendingClasses >= 5);
+    testassert(before.avoidedExtAllocations <= before.pendingClasses);
+#endif
+
+    // Messaging: the last loaded category wins.
+    LazyMessaged *obj = [LazyMessaged new];
+    testassert([obj override] == 2);
+    testassert([obj first] == 1);
+    testassert([LazyMessaged classOverride] == 2);
+    testassert(hasMethod([LazyMessaged class], @selector(first)));
+    [obj release];
+
+    // Reflection before any message.
+    Class reflected = objc_getClass("LazyReflected");
+    testassert(hasMethod(reflected, @selector(lazyProperty)));
+    testassert(class_getProperty(reflected, "lazyProperty"));
+    testassert(class_conformsToProtocol(reflected, @protocol(LazyProtocol)));
+    Method m = class_getInstanceMethod(reflected, @selector(override));
+    testassert(((int(*)(id, SEL))method_getImplementation(m))(nil, @selector(override)) == 1);
+
+    // Methods added later override the category's, and
+    // the category's methods can't be added again.
+    Class addedTo = objc_getClass("LazyAdded");
+    testassert(!class_addMethod(addedTo, @selector(fromCategory), (IMP)added, "i@:"));
+    testassert(class_addMethod(addedTo, @selector(fromAdd), (IMP)added, "i@:"));
+    class_replaceMethod(addedTo, @selector(fromCategory), (IMP)added, "i@:");
+    id addedObj = [addedTo new];
+    testassert([addedObj fromCategory] == 2);
+    testassert([addedObj fromAdd] == 2);
+    [addedObj release];
+
+    struct objc_lazy_category_statistics after;
+    _objc_getLazyCategoryStatistics(&after);
+    testprintf("%zu deferred, %zu attached, %zu classes pending, "
+               "%zu without class_rw_ext_t\n",
+               after.deferredCategories, after.attachedCategories,
+               after.pendingClasses, after.avoidedExtAllocations);
+#if LAZY_DISABLED
+    testassert(after.attachedCategories == 0);
+#else
+    testassert(after.attachedCategories >= before.attachedCategories + 5);
+    testassert(after.attachedCategories <= after.deferredCategories);
+    testassert(after.pendingClasses <= before.pendingClasses);
+#endif
+
+    succeed(NAME);
+}
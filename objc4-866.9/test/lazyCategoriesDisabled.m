@@ -0,0 +1,10 @@
+// TEST_CFLAGS -Wl,-no_objc_category_merging
+// TEST_ENV OBJC_DISABLE_LAZY_CATEGORIES=YES
+// TEST_CONFIG MEM=mrc
+
+// lazyCategories.m with categories attached as soon as they load.
+
+#define NAME "lazyCategoriesDisabled"
+#define LAZY_DISABLED 1
+
+#include "lazyCategories.m"
@@ -0,0 +1,42 @@
+/*
+TEST_CONFIG MEM=mrc
+TEST_BUILD
+    $C{COMPILE} -Wl,-no_objc_category_merging $DIR/lazyCategoriesInitialize.m -o lazyCategoriesInitialize.exe
+    $C{COMPILE} $DIR/lazyCategoriesInitialize2.m -o lazyCategoriesInitialize2.bundle -bundle -bundle_loader lazyCategoriesInitialize.exe
+END
+*/
+
+// A category on a class with +load is deferred until the class is
+// first used. The class's +initialize loads a bundle with another
+// category on it, which is attached at once. The bundle's category
+// is loaded last, so it must still override the deferred one.
+
+#include "test.h"
+#include "testroot.i"
+#include <dlfcn.h>
+
+@interface LazyInitialized : TestRoot @end
+@implementation LazyInitialized
++(void)load { }
++(void)initialize {
+    testassert(dlopen("lazyCategoriesInitialize2.bundle", RTLD_LAZY));
+}
+-(int)value { return 0; }
++(int)classValue { return 0; }
+@end
+
+@interface LazyInitialized (First) @end
+@implementation LazyInitialized (First)
+-(int)value { return 1; }
++(int)classValue { return 1; }
+@end
+
+int main()
+{
+    LazyInitialized *obj = [LazyInitialized new];
+    testassert([obj value] == 2);
+    testassert([LazyInitialized classValue] == 2);
+    [obj release];
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,9 @@
+// Bundle for lazyCategoriesInitialize.m, loaded by +initialize.
+
+@interface LazyInitialized @end
+
+@interface LazyInitialized (Second) @end
+@implementation LazyInitialized (Second)
+-(int)value { return 2; }
++(int)classValue { return 2; }
+@end
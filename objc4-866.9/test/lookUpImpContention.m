@@ -0,0 +1,138 @@
+// TEST_CONFIG MEM=mrc
+
+// Method cache miss throughput at 1-64 threads.
+// Every round flushes the caches and then has each thread send every
+// selector once, so each send goes through lookUpImpOrForward.
+// Compare runs with OBJC_DISABLE_LOCKFREE_LOOKUP=YES and =NO to
+// measure the contention on runtimeLock.
+// A second pass adds methods while the threads search, to check that
+// lock-free searches never fill the cache with a stale IMP.
+
+#include "test.h"
+#include "testroot.i"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+
+#define SELS 256
+#define ROUNDS 20
+#define MAXTHREADS 64
+
+static SEL sels[SELS];
+static Class Leaf;
+static _Atomic int startFlag;
+
+static uintptr_t valueFor(int i) { return 0x1000 + i; }
+
+static void *searcher(void *arg)
+{
+    int rotate = (int)(intptr_t)arg;
+    id obj = (id)Leaf;
+
+    while (!atomic_load(&startFlag)) { }
+
+    for (int n = 0; n < SELS; n++) {
+        int i = (n + rotate) % SELS;
+        uintptr_t result = ((uintptr_t(*)(id, SEL))objc_msgSend)(obj, sels[i]);
+        testassert(result == valueFor(i));
+    }
+    return NULL;
+}
+
+static uint64_t runRound(int threadCount)
+{
+    pthread_t threads[MAXTHREADS];
+
+    _objc_flush_caches(object_getClass(Leaf));
+    atomic_store(&startFlag, 0);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_create(&threads[t], NULL, &searcher, (void *)(intptr_t)(t * 7));
+    }
+
+    uint64_t start = mach_absolute_time();
+    atomic_store(&startFlag, 1);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    return mach_absolute_time() - start;
+}
+
+static void *writer(void *arg __unused)
+{
+    // Each added method prepends a method list to Base's metaclass,
+    // replacing the method list array under lock-free searchers.
+    Class meta = object_getClass(objc_getClass("LookupBase"));
+    for (int i = 0; i < 200; i++) {
+        char *name;
+        asprintf(&name, "added%d", i);
+        class_addMethod(meta, sel_registerName(name),
+                        imp_implementationWithBlock(^(id self __unused) { return (uintptr_t)0; }),
+                        "L@:");
+        free(name);
+    }
+    return NULL;
+}
+
+int main()
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+
+    // LookupBase has all of the methods, half of them in separately
+    // attached method lists. The searches start three subclasses down.
+    Class base = objc_allocateClassPair([TestRoot class], "LookupBase", 0);
+    Class baseMeta = object_getClass(base);
+    for (int i = 0; i < SELS; i++) {
+        char *name;
+        asprintf(&name, "lookupSel%d", i);
+        sels[i] = sel_registerName(name);
+        free(name);
+        if (i % 2 == 0) {
+            uintptr_t value = valueFor(i);
+            class_addMethod(baseMeta, sels[i],
+                            imp_implementationWithBlock(^(id self __unused) { return value; }),
+                            "L@:");
+        }
+    }
+    objc_registerClassPair(base);
+    for (int i = 1; i < SELS; i += 2) {
+        uintptr_t value = valueFor(i);
+        class_addMethod(baseMeta, sels[i],
+                        imp_implementationWithBlock(^(id self __unused) { return value; }),
+                        "L@:");
+    }
+
+    Class sup = base;
+    for (int depth = 0; depth < 3; depth++) {
+        char *name;
+        asprintf(&name, "LookupSub%d", depth);
+        Class sub = objc_allocateClassPair(sup, name, 0);
+        free(name);
+        objc_registerClassPair(sub);
+        sup = sub;
+    }
+    Leaf = sup;
+    [Leaf self];  // +initialize
+
+    for (int threadCount = 1; threadCount <= MAXTHREADS; threadCount *= 2) {
+        uint64_t minTime = UINT64_MAX;
+        for (int r = 0; r < ROUNDS; r++) {
+            uint64_t t = runRound(threadCount);
+            if (t < minTime) minTime = t;
+        }
+        uint64_t ns = minTime * timebase.numer / timebase.denom;
+        testprintf("threads %2d: %6llu ns per round, %4llu ns per lookup\n",
+                   threadCount, ns, ns / ((uint64_t)threadCount * SELS));
+    }
+
+    // Searches racing with method list changes still find the right IMPs.
+    pthread_t writerThread;
+    pthread_create(&writerThread, NULL, &writer, NULL);
+    for (int r = 0; r < ROUNDS; r++) {
+        runRound(8);
+    }
+    pthread_join(writerThread, NULL);
+
+    succeed(__FILE__);
+}
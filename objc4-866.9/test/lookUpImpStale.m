@@ -0,0 +1,118 @@
+// TEST_CONFIG MEM=mrc
+
+// Lock-free method searches racing with method list changes.
+// Reader threads keep flushing the caches and sending every selector,
+// so each send goes through lookUpImpOrForward, while a writer
+// overrides the methods one by one in a subclass and churns the
+// method lists of the base class. Every IMP a reader gets must be
+// the base method or the override. Once the writer has overridden a
+// method, every later send must reach the override: a stale IMP
+// filled into a cache would keep answering with the base method.
+
+#include "test.h"
+#include "testroot.i"
+
+#include <objc/runtime.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define SELS 128
+#define THREADS 8
+#define CHURN 4
+
+static SEL sels[SELS];
+static IMP baseImps[SELS];
+static IMP overrideImps[SELS];
+static Class Leaf;
+static _Atomic int overridden;
+static _Atomic int done;
+
+static uintptr_t baseValue(int i) { return 0x1000 + i; }
+static uintptr_t overrideValue(int i) { return 0x2000 + i; }
+
+static void *reader(void *arg)
+{
+    int rotate = (int)(intptr_t)arg;
+    id obj = (id)Leaf;
+    Class meta = object_getClass(Leaf);
+
+    while (!atomic_load(&done)) {
+        _objc_flush_caches(meta);
+        for (int n = 0; n < SELS; n++) {
+            int i = (n + rotate) % SELS;
+            // Read before sending: an override published before the
+            // send must be found.
+            bool mustOverride = i < atomic_load(&overridden);
+
+            IMP imp = class_getMethodImplementation(meta, sels[i]);
+            testassert(imp == overrideImps[i]  ||
+                       (!mustOverride  &&  imp == baseImps[i]));
+
+            uintptr_t result = ((uintptr_t(*)(id, SEL))objc_msgSend)(obj, sels[i]);
+            testassert(result == overrideValue(i)  ||
+                       (!mustOverride  &&  result == baseValue(i)));
+        }
+    }
+    return NULL;
+}
+
+static IMP impReturning(uintptr_t value)
+{
+    return imp_implementationWithBlock(^(id self __unused) { return value; });
+}
+
+int main()
+{
+    // LookupStaleBase has every method. The readers message the leaf
+    // class three levels down; the writer overrides in the middle one.
+    Class base = objc_allocateClassPair([TestRoot class], "LookupStaleBase", 0);
+    Class baseMeta = object_getClass(base);
+    for (int i = 0; i < SELS; i++) {
+        char *name;
+        asprintf(&name, "lookupStaleSel%d", i);
+        sels[i] = sel_registerName(name);
+        free(name);
+        baseImps[i] = impReturning(baseValue(i));
+        overrideImps[i] = impReturning(overrideValue(i));
+        class_addMethod(baseMeta, sels[i], baseImps[i], "L@:");
+    }
+    objc_registerClassPair(base);
+
+    Class middle = objc_allocateClassPair(base, "LookupStaleMiddle", 0);
+    objc_registerClassPair(middle);
+    Class middleMeta = object_getClass(middle);
+    Leaf = objc_allocateClassPair(middle, "LookupStaleLeaf", 0);
+    objc_registerClassPair(Leaf);
+    [Leaf self];  // +initialize
+
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &reader, (void *)(intptr_t)(t * 17));
+    }
+
+    for (int i = 0; i < SELS; i++) {
+        // Each added method replaces a method list array that readers
+        // may be walking.
+        for (int c = 0; c < CHURN; c++) {
+            char *name;
+            asprintf(&name, "lookupStaleChurn%d_%d", i, c);
+            class_addMethod(baseMeta, sel_registerName(name),
+                            impReturning(0), "L@:");
+            free(name);
+        }
+        testassert(class_addMethod(middleMeta, sels[i], overrideImps[i], "L@:"));
+        atomic_store(&overridden, i + 1);
+    }
+
+    atomic_store(&done, 1);
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    for (int i = 0; i < SELS; i++) {
+        testassert(((uintptr_t(*)(id, SEL))objc_msgSend)(Leaf, sels[i]) ==
+                   overrideValue(i));
+    }
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,108 @@
+// TEST_CFLAGS -Wl,-no_objc_category_merging
+// TEST_CONFIG MEM=mrc
+
+// Classes with many category method lists are searched through a merged
+// method index. Lookups must find the same method as a walk of the
+// method lists in order, so the category that overrides last still
+// wins. Methods added after the index is built must be found too.
+// Reports ns per class_getInstanceMethod(); set
+// OBJC_DISABLE_METHOD_INDEX=YES to compare with the list walk.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+#include <mach/mach_time.h>
+
+#define LOOKUPS 1000000
+
+@interface IndexedClass : TestRoot @end
+@implementation IndexedClass
+-(int)override { return -1; }
+-(int)baseMethod { return 100; }
++(int)classOverride { return -1; }
+@end
+
+#define CATEGORY(n)                                        \
+    @interface IndexedClass (Category##n) @end             \
+    @implementation IndexedClass (Category##n)             \
+    -(int)override { return n; }                           \
+    -(int)category##n { return n; }                        \
+    +(int)classOverride { return n; }                      \
+    @end
+
+CATEGORY(0)  CATEGORY(1)  CATEGORY(2)  CATEGORY(3)
+CATEGORY(4)  CATEGORY(5)  CATEGORY(6)  CATEGORY(7)
+CATEGORY(8)  CATEGORY(9)  CATEGORY(10) CATEGORY(11)
+
+static int added(id self __unused, SEL _cmd __unused) { return 200; }
+
+// The method a walk of cls's method lists finds first.
+static Method firstInLists(Class cls, SEL sel)
+{
+    unsigned count;
+    Method *methods = class_copyMethodList(cls, &count);
+    Method result = NULL;
+    for (unsigned i = 0; i < count; i++) {
+        if (method_getName(methods[i]) == sel) {
+            result = methods[i];
+            break;
+        }
+    }
+    free(methods);
+    return result;
+}
+
+static void check(Class cls)
+{
+    Method expected = firstInLists(cls, @selector(override));
+    testassert(expected);
+    Class meta = object_getClass(cls);
+    // Search often enough for the index to be built.
+    for (int i = 0; i < 3; i++) {
+        testassert(class_getInstanceMethod(cls, @selector(override)) == expected);
+        testassert(class_getInstanceMethod(cls, @selector(baseMethod)) ==
+                   firstInLists(cls, @selector(baseMethod)));
+        testassert(class_getInstanceMethod(cls, @selector(category0)));
+        testassert(class_getInstanceMethod(cls, @selector(category11)));
+        testassert(!class_getInstanceMethod(cls, @selector(noSuchMethod)));
+        testassert(class_getClassMethod(cls, @selector(classOverride)) ==
+                   firstInLists(meta, @selector(classOverride)));
+    }
+}
+
+int main()
+{
+    Class cls = [IndexedClass class];
+    IndexedClass *obj = [IndexedClass new];
+
+    check(cls);
+    // Some category's override wins over the class's own method.
+    IMP imp = method_getImplementation(firstInLists(cls, @selector(override)));
+    int winner = ((int(*)(id, SEL))imp)(obj, @selector(override));
+    testassert(winner >= 0  &&  winner <= 11);
+    testassert([obj override] == winner);
+    testassert([obj baseMethod] == 100);
+
+    // Adding a method discards the index; the new method is found.
+    testassert(class_addMethod(cls, @selector(addedMethod), (IMP)added, "i@:"));
+    check(cls);
+    testassert(class_getInstanceMethod(cls, @selector(addedMethod)));
+    testassert(((int(*)(id, SEL))objc_msgSend)(obj, @selector(addedMethod)) == 200);
+    // Replacing an existing method changes its IMP in place.
+    class_replaceMethod(cls, @selector(baseMethod), (IMP)added, "i@:");
+    testassert([obj baseMethod] == 200);
+    testassert([obj override] == winner);
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    uint64_t start = mach_absolute_time();
+    for (int i = 0; i < LOOKUPS; i++) {
+        class_getInstanceMethod(cls, @selector(baseMethod));
+    }
+    testprintf("%.2f ns per class_getInstanceMethod of a base method\n",
+               (double)(mach_absolute_time() - start) * timebase.numer
+               / timebase.denom / LOOKUPS);
+
+    [obj release];
+    succeed(__FILE__);
+}
@@ -0,0 +1,82 @@
+// TEST_CONFIG
+
+// Selectors that respondsToSelector: did not find are remembered in a
+// negative cache outside of the method cache, whether or not the class
+// has a class_rw_ext_t. Check that adding the method later, to the
+// class or to a superclass, is still seen either way, and that many
+// classes can have negative caches at once.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+
+@interface Super : TestRoot @end
+@implementation Super @end
+
+@interface Sub : Super @end
+@implementation Sub @end
+
+static id fn(id self, SEL _cmd __unused) { return self; }
+
+#define CLASSES 300
+
+int main()
+{
+    SEL missing = sel_registerName("negativeLookupCacheMissing");
+    SEL later = sel_registerName("negativeLookupCacheLater");
+    SEL inherited = sel_registerName("negativeLookupCacheInherited");
+
+    Sub *obj = [Sub new];
+
+    for (int i = 0; i < 100; i++) {
+        testassert(![obj respondsToSelector:missing]);
+        testassert(!class_respondsToSelector([Sub class], later));
+        testassert(!class_respondsToSelector([Sub class], inherited));
+        testassert(class_getMethodImplementation([Sub class], missing)
+                   == (IMP)_objc_msgForward);
+    }
+
+    class_addMethod([Sub class], later, (IMP)fn, "@@:");
+    testassert([obj respondsToSelector:later]);
+    testassert(class_respondsToSelector([Sub class], later));
+
+    class_addMethod([Super class], inherited, (IMP)fn, "@@:");
+    testassert([obj respondsToSelector:inherited]);
+    testassert(class_respondsToSelector([Sub class], inherited));
+
+    // Sub has a class_rw_ext_t now.
+    SEL missingAfter = sel_registerName("negativeLookupCacheMissingAfter");
+    for (int i = 0; i < 100; i++) {
+        testassert(![obj respondsToSelector:missing]);
+        testassert(![obj respondsToSelector:missingAfter]);
+    }
+    class_addMethod([Sub class], missingAfter, (IMP)fn, "@@:");
+    testassert([obj respondsToSelector:missingAfter]);
+
+    // Enough classes with negative caches to grow the table that finds
+    // them, some freed along the way.
+    Class classes[CLASSES];
+    for (int i = 0; i < CLASSES; i++) {
+        char *name;
+        asprintf(&name, "NegativeLookupCache%d", i);
+        classes[i] = objc_allocateClassPair([TestRoot class], name, 0);
+        free(name);
+        objc_registerClassPair(classes[i]);
+        for (int j = 0; j < 3; j++) {
+            testassert(!class_respondsToSelector(classes[i], missing));
+        }
+        if (i % 3 == 0) {
+            objc_disposeClassPair(classes[i]);
+            classes[i] = nil;
+        }
+    }
+    for (int i = 0; i < CLASSES; i++) {
+        if (!classes[i]) continue;
+        testassert(!class_respondsToSelector(classes[i], missing));
+        testassert(!class_respondsToSelector(classes[i], later));
+        class_addMethod(classes[i], later, (IMP)fn, "@@:");
+        testassert(class_respondsToSelector(classes[i], later));
+    }
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,90 @@
+// TEST_CONFIG MEM=mrc
+
+// Autorelease pool pop with 10^5 objects. Objects that autorelease more
+// objects from -dealloc, repeated autoreleases of one object, and nested
+// pools must all be released by the right pop. Reports pop latency per
+// object. poolPopBatch.m runs the same test with OBJC_BATCH_POOL_POP.
+
+#include "test.h"
+#include <objc/objc-internal.h>
+#include <Foundation/Foundation.h>
+#include <mach/mach_time.h>
+
+#ifndef NAME
+#define NAME "poolPop"
+#endif
+
+#define OBJECTS 100000
+#define RUNS 20
+
+static int deallocs;
+
+@interface PoolPopObject : NSObject {
+@public
+    int chain;
+}
+@end
+@implementation PoolPopObject
+-(void)dealloc {
+    deallocs++;
+    if (chain > 0) {
+        PoolPopObject *obj = [PoolPopObject new];
+        obj->chain = chain - 1;
+        [obj autorelease];
+    }
+    [super dealloc];
+}
+@end
+
+int main()
+{
+    // Deallocs that autorelease more objects, repeated autoreleases,
+    // and a nested pool.
+    deallocs = 0;
+    id survivor = [PoolPopObject new];
+    void *outer = objc_autoreleasePoolPush();
+    [[survivor retain] autorelease];
+    void *pool = objc_autoreleasePoolPush();
+    for (int i = 0; i < 1000; i++) {
+        PoolPopObject *obj = [PoolPopObject new];
+        obj->chain = 3;
+        [obj autorelease];
+        [[survivor retain] autorelease];
+        [[survivor retain] autorelease];
+    }
+    void *inner = objc_autoreleasePoolPush();
+    for (int i = 0; i < 1000; i++) {
+        [[PoolPopObject new] autorelease];
+    }
+    objc_autoreleasePoolPop(inner);
+    testassert(deallocs == 1000);
+    objc_autoreleasePoolPop(pool);
+    testassert(deallocs == 1000 + 1000*4);
+    testassert([survivor retainCount] == 2);
+    objc_autoreleasePoolPop(outer);
+    testassert([survivor retainCount] == 1);
+    [survivor release];
+
+    // Benchmark.
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    uint64_t total = 0, worst = 0;
+    for (int run = 0; run < RUNS; run++) {
+        deallocs = 0;
+        pool = objc_autoreleasePoolPush();
+        for (int i = 0; i < OBJECTS; i++) {
+            [[PoolPopObject new] autorelease];
+        }
+        uint64_t start = mach_absolute_time();
+        objc_autoreleasePoolPop(pool);
+        uint64_t t = mach_absolute_time() - start;
+        testassert(deallocs == OBJECTS);
+        total += t;
+        if (t > worst) worst = t;
+    }
+    testprintf("pop %d objects: %6.2f ns/object, worst pop %8.0f us\n", OBJECTS,
+               (double)total * timebase.numer / timebase.denom / RUNS / OBJECTS,
+               (double)worst * timebase.numer / timebase.denom / 1000);
+
+    succeed(NAME);
+}
@@ -0,0 +1,8 @@
+// TEST_ENV OBJC_BATCH_POOL_POP=YES
+// TEST_CONFIG MEM=mrc
+
+// poolPop.m with pool contents released through objc_releaseBatch.
+
+#define NAME "poolPopBatch"
+
+#include "poolPop.m"
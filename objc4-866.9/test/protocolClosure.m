@@ -0,0 +1,145 @@
+// TEST_CONFIG MEM=mrc
+
+// class_conformsToProtocol() answers from a cached closure of each
+// class's protocols. Checks inherited protocols, that class_addProtocol()
+// and new protocols are seen after a class was already asked about, that
+// a disposed class's answers don't outlive it, that more classes than
+// the cache holds are answered correctly, and that threads asking
+// while protocols are added agree. Reports ns per lookup.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+
+#define THREADS 8
+#define LOOKUPS 1000000
+#define ADDED 200
+#define MANY 3000
+
+@protocol ClosureBase @end
+@protocol ClosureMiddle <ClosureBase> @end
+@protocol ClosureTop <ClosureMiddle> @end
+@protocol ClosureOther @end
+@protocol ClosureLater @end
+@protocol ClosureNever @end
+
+@interface ClosureClass : TestRoot <ClosureTop> @end
+@implementation ClosureClass @end
+
+@interface ClosureSubclass : ClosureClass <ClosureOther> @end
+@implementation ClosureSubclass @end
+
+static _Atomic int stop;
+
+static void *reader(void *arg __unused)
+{
+    Class cls = [ClosureClass class];
+    while (!atomic_load(&stop)) {
+        testassert(class_conformsToProtocol(cls, @protocol(ClosureBase)));
+        testassert(class_conformsToProtocol(cls, @protocol(ClosureTop)));
+        testassert(!class_conformsToProtocol(cls, @protocol(ClosureNever)));
+    }
+    return NULL;
+}
+
+int main()
+{
+    Class cls = [ClosureClass class];
+    Class sub = [ClosureSubclass class];
+
+    // Inherited protocols, asked twice to use the closure.
+    for (int i = 0; i < 2; i++) {
+        testassert(class_conformsToProtocol(cls, @protocol(ClosureTop)));
+        testassert(class_conformsToProtocol(cls, @protocol(ClosureMiddle)));
+        testassert(class_conformsToProtocol(cls, @protocol(ClosureBase)));
+        testassert(!class_conformsToProtocol(cls, @protocol(ClosureOther)));
+        // Superclasses' protocols are not the class's own.
+        testassert(class_conformsToProtocol(sub, @protocol(ClosureOther)));
+        testassert(!class_conformsToProtocol(sub, @protocol(ClosureTop)));
+    }
+
+    // Added after the closure was built.
+    testassert(!class_conformsToProtocol(cls, @protocol(ClosureLater)));
+    testassert(class_addProtocol(cls, @protocol(ClosureLater)));
+    testassert(class_conformsToProtocol(cls, @protocol(ClosureLater)));
+    testassert(!class_conformsToProtocol(sub, @protocol(ClosureLater)));
+
+    // A runtime-made protocol that adopts another.
+    Protocol *made = objc_allocateProtocol("ClosureMade");
+    protocol_addProtocol(made, @protocol(ClosureOther));
+    objc_registerProtocol(made);
+    testassert(!class_conformsToProtocol(cls, made));
+    testassert(class_addProtocol(cls, made));
+    testassert(class_conformsToProtocol(cls, made));
+    testassert(class_conformsToProtocol(cls, @protocol(ClosureOther)));
+
+    // A disposed class's closure is not used for a later class.
+    for (int i = 0; i < 100; i++) {
+        Class c = objc_allocateClassPair([TestRoot class], "ClosureDynamic", 0);
+        objc_registerClassPair(c);
+        testassert(!class_conformsToProtocol(c, @protocol(ClosureBase)));
+        if (i % 2 == 0) {
+            testassert(class_addProtocol(c, @protocol(ClosureTop)));
+            testassert(class_conformsToProtocol(c, @protocol(ClosureBase)));
+        }
+        objc_disposeClassPair(c);
+    }
+
+    // More classes than the cache holds, asked in turn. Classes
+    // that find no room are answered without a closure.
+    static Class many[MANY];
+    for (int i = 0; i < MANY; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "ClosureMany%d", i);
+        many[i] = objc_allocateClassPair([TestRoot class], name, 0);
+        objc_registerClassPair(many[i]);
+        if (i % 3) testassert(class_addProtocol(many[i], @protocol(ClosureTop)));
+    }
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < MANY; i++) {
+            testassert(class_conformsToProtocol(many[i], @protocol(ClosureBase)) == (i % 3 != 0));
+            testassert(!class_conformsToProtocol(many[i], @protocol(ClosureOther)));
+        }
+        testassert(class_conformsToProtocol(cls, @protocol(ClosureBase)));
+    }
+
+    // Readers keep agreeing while other classes gain protocols.
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &reader, NULL);
+    }
+    for (int i = 0; i < ADDED; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "ClosureAdded%d", i);
+        Class c = objc_allocateClassPair([TestRoot class], name, 0);
+        objc_registerClassPair(c);
+        testassert(class_addProtocol(c, @protocol(ClosureMiddle)));
+        testassert(class_conformsToProtocol(c, @protocol(ClosureBase)));
+    }
+    atomic_store(&stop, 1);
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    uint64_t start = mach_absolute_time();
+    for (int i = 0; i < LOOKUPS; i++) {
+        class_conformsToProtocol(cls, @protocol(ClosureBase));
+    }
+    testprintf("%.2f ns per class_conformsToProtocol (inherited)\n",
+               (double)(mach_absolute_time() - start) * timebase.numer
+               / timebase.denom / LOOKUPS);
+    start = mach_absolute_time();
+    for (int i = 0; i < LOOKUPS; i++) {
+        class_conformsToProtocol(cls, @protocol(ClosureNever));
+    }
+    testprintf("%.2f ns per class_conformsToProtocol (not adopted)\n",
+               (double)(mach_absolute_time() - start) * timebase.numer
+               / timebase.denom / LOOKUPS);
+
+    succeed(__FILE__);
+}
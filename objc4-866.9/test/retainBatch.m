@@ -0,0 +1,135 @@
+// TEST_CONFIG MEM=mrc
+
+// objc_retainBatch and objc_releaseBatch: duplicates, nil, side table
+// overflow, RR overrides, and deferred deallocation. Then compare them
+// with per-element objc_retain/objc_release loops at 1, 8, and 64
+// threads sharing the same objects.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+#include <Foundation/Foundation.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+
+static int deallocs;
+static id watched;
+static NSUInteger watchedCountAtDealloc;
+
+@interface BatchObject : NSObject @end
+@implementation BatchObject
+-(void)dealloc {
+    deallocs++;
+    if (watched) watchedCountAtDealloc = [watched retainCount];
+    [super dealloc];
+}
+@end
+
+#define OBJECTS 256
+#define ITERATIONS 2000
+#define MAXTHREADS 64
+
+static id shared[OBJECTS];
+static _Atomic int startFlag;
+static bool useBatch;
+
+static void *worker(void *arg __unused)
+{
+    id objs[OBJECTS];
+    memcpy(objs, shared, sizeof(objs));
+
+    while (!atomic_load(&startFlag)) { }
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        if (useBatch) {
+            objc_retainBatch(objs, OBJECTS);
+            objc_releaseBatch(objs, OBJECTS);
+        } else {
+            for (int j = 0; j < OBJECTS; j++) objc_retain(objs[j]);
+            for (int j = 0; j < OBJECTS; j++) objc_release(objs[j]);
+        }
+    }
+    return NULL;
+}
+
+static uint64_t run(int threadCount, bool batch)
+{
+    pthread_t threads[MAXTHREADS];
+    useBatch = batch;
+    atomic_store(&startFlag, 0);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_create(&threads[t], NULL, &worker, NULL);
+    }
+    uint64_t start = mach_absolute_time();
+    atomic_store(&startFlag, 1);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    return mach_absolute_time() - start;
+}
+
+int main()
+{
+    // Duplicates and nil.
+    id obj = [BatchObject new];
+    id objs[] = { obj, nil, obj, obj };
+    objc_retainBatch(objs, 4);
+    testassert([obj retainCount] == 4);
+    objc_releaseBatch(objs, 4);
+    testassert([obj retainCount] == 1);
+    testassert(deallocs == 0);
+
+    // More duplicates than fit in the inline count.
+    id many[1000];
+    for (int i = 0; i < 1000; i++) many[i] = obj;
+    objc_retainBatch(many, 1000);
+    testassert([obj retainCount] == 1001);
+    objc_releaseBatch(many, 1000);
+    testassert([obj retainCount] == 1);
+
+    // Deallocation waits for the whole batch.
+    id survivor = [BatchObject new];
+    [survivor retain];
+    watched = survivor;
+    id pair[] = { obj, survivor };
+    objc_releaseBatch(pair, 2);
+    testassert(deallocs == 1);
+    testassert(watchedCountAtDealloc == 1);
+    watched = nil;
+    [survivor release];
+    testassert(deallocs == 2);
+
+    // Objects with RR overrides get real messages.
+    id root = [TestRoot new];
+    id roots[] = { root, root };
+    TestRootRetain = 0;
+    TestRootRelease = 0;
+    objc_retainBatch(roots, 2);
+    objc_releaseBatch(roots, 2);
+    testassert(TestRootRetain == 2);
+    testassert(TestRootRelease == 2);
+    [root release];
+
+    // Benchmark. Every eighth element repeats an earlier object.
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    for (int i = 0; i < OBJECTS; i++) {
+        shared[i] = (i % 8 == 7) ? shared[i - 7] : [BatchObject new];
+    }
+    for (int threadCount = 1; threadCount <= MAXTHREADS; threadCount *= 8) {
+        uint64_t loop = run(threadCount, false);
+        uint64_t batch = run(threadCount, true);
+        double perElement = (double)threadCount * ITERATIONS * OBJECTS * 2;
+        testprintf("threads %2d: loop %6.2f ns/op, batch %6.2f ns/op\n",
+                   threadCount,
+                   loop * timebase.numer / timebase.denom / perElement,
+                   batch * timebase.numer / timebase.denom / perElement);
+    }
+    for (int i = 0; i < OBJECTS; i++) {
+        testassert([shared[i] retainCount] == 1);
+        if (i % 8 != 7) [shared[i] release];
+    }
+
+    succeed(__FILE__);
+}
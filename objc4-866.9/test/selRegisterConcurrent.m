@@ -0,0 +1,109 @@
+// TEST_CONFIG
+
+// sel_registerName() and sel_getUid() from many threads at once. Every
+// thread registers the same set of new names in a different order and
+// must get the same SEL for each name, while other threads look the
+// names up. Then times lookups of registered names at 1, 8, and 64
+// threads, and registration of new names from one thread.
+
+#include "test.h"
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define NAMES 20000
+#define THREADS 8
+#define MAXTHREADS 64
+#define LOOKUPS 1000000
+
+static uint64_t nowNanoseconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static char *names[NAMES];
+static SEL results[THREADS][NAMES];
+static _Atomic int startFlag;
+
+static void *registerWorker(void *arg)
+{
+    uintptr_t t = (uintptr_t)arg;
+    while (!atomic_load(&startFlag)) { }
+    for (int k = 0; k < NAMES; k++) {
+        int i = (int)((k * 7919 + t * 131) % NAMES);
+        results[t][i] = (t & 1) ? sel_getUid(names[i]) : sel_registerName(names[i]);
+        // A name registered by this thread is visible without a lock.
+        testassert(sel_lookUpByName(names[i]) == results[t][i]);
+        testassert(sel_isMapped(results[t][i]));
+    }
+    return NULL;
+}
+
+static void *lookupWorker(void *arg __unused)
+{
+    while (!atomic_load(&startFlag)) { }
+    for (int i = 0; i < LOOKUPS; i++) {
+        SEL sel = sel_registerName(names[i % NAMES]);
+        testassert(sel != NULL);
+    }
+    return NULL;
+}
+
+static double run(int threadCount, void *(*fn)(void *))
+{
+    pthread_t threads[MAXTHREADS];
+    atomic_store(&startFlag, 0);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_create(&threads[t], NULL, fn, (void *)(uintptr_t)t);
+    }
+    uint64_t start = nowNanoseconds();
+    atomic_store(&startFlag, 1);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    return (double)(nowNanoseconds() - start);
+}
+
+int main()
+{
+    for (int i = 0; i < NAMES; i++) {
+        asprintf(&names[i], "selRegisterConcurrent%d:with:", i);
+        testassert(sel_lookUpByName(names[i]) == NULL);
+    }
+
+    // Racing registrations agree on every SEL.
+    run(THREADS, &registerWorker);
+    for (int i = 0; i < NAMES; i++) {
+        testassert(results[0][i] != NULL);
+        testassert(0 == strcmp(sel_getName(results[0][i]), names[i]));
+        for (int t = 1; t < THREADS; t++) {
+            testassert(results[t][i] == results[0][i]);
+        }
+    }
+    testassert(sel_lookUpByName("selRegisterConcurrentMissing:") == NULL);
+    testassert(!sel_isMapped((SEL)"selRegisterConcurrent0:with:"));
+
+    // Lookup throughput for registered names.
+    for (int threadCount = 1; threadCount <= MAXTHREADS; threadCount *= 8) {
+        double t = run(threadCount, &lookupWorker);
+        testprintf("threads %2d: %6.2f ns per sel_registerName (registered)\n",
+                   threadCount, t / ((double)threadCount * LOOKUPS));
+    }
+
+    // Registration of new names, which grows the table.
+    uint64_t start = nowNanoseconds();
+    for (int i = 0; i < NAMES; i++) {
+        char *name;
+        asprintf(&name, "selRegisterConcurrentNew%d", i);
+        testassert(0 == strcmp(sel_getName(sel_registerName(name)), name));
+        free(name);
+    }
+    testprintf("%6.2f ns per sel_registerName (new)\n",
+               (double)(nowNanoseconds() - start) / NAMES);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,77 @@
+/*
+TEST_CONFIG MEM=mrc
+TEST_BUILD
+    $C{COMPILE} $DIR/selrefParallelDlopen.m -o selrefParallelDlopen.exe
+    $C{COMPILE} $DIR/selrefParallelDlopen2.m -o selrefParallelDlopen2.bundle -bundle -bundle_loader selrefParallelDlopen.exe
+END
+*/
+
+// A bundle with more selector references than CONFIG_PARALLEL_SELREF_MIN
+// is loaded after other threads have started, so map_images() fixes up
+// its references with dispatch_apply() before taking runtimeLock.
+// Threads keep sending messages and exiting meanwhile. The bundle's
+// references must all be uniqued.
+
+#include "test.h"
+#include "testroot.i"
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <objc/runtime.h>
+
+#define PREFIXES 5
+#define PER_PREFIX 4096
+#define COUNT (PREFIXES * PER_PREFIX)
+#define THREADS 4
+
+static SEL refs[COUNT];
+static _Atomic int loaded;
+
+static void *sendOnce(void *arg __unused)
+{
+    [[TestRoot new] release];
+    return NULL;
+}
+
+static void *sender(void *arg __unused)
+{
+    // Short-lived threads, so some exit while the bundle loads.
+    while (!atomic_load(&loaded)) {
+        pthread_t t;
+        pthread_create(&t, NULL, &sendOnce, NULL);
+        pthread_join(t, NULL);
+    }
+    return NULL;
+}
+
+int main()
+{
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &sender, NULL);
+    }
+
+    void *dlh = dlopen("selrefParallelDlopen2.bundle", RTLD_LAZY);
+    testassert(dlh);
+    atomic_store(&loaded, 1);
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    int (*collect)(SEL *) =
+        (int (*)(SEL *))dlsym(dlh, "selrefParallelDlopenCollect");
+    testassert(collect);
+    testassert(collect(refs) == COUNT);
+
+    const char *prefixes = "ABCDE";
+    for (int i = 0; i < COUNT; i++) {
+        char name[64];
+        int d = i % PER_PREFIX;
+        snprintf(name, sizeof(name), "selrefDlopen%c%x%x%x",
+                 prefixes[i / PER_PREFIX], d >> 8, (d >> 4) & 0xf, d & 0xf);
+        testassert(0 == strcmp(sel_getName(refs[i]), name));
+        testassert(refs[i] == sel_registerName(name));
+    }
+
+    succeed(__FILE__);
+}
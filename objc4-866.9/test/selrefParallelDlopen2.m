@@ -0,0 +1,20 @@
+// Bundle for selrefParallelDlopen.m with more selector references
+// than CONFIG_PARALLEL_SELREF_MIN.
+
+#include <objc/objc.h>
+
+#define S(x) refs[n++] = @selector(x);
+#define S1(p) S(p##0) S(p##1) S(p##2) S(p##3) S(p##4) S(p##5) S(p##6) S(p##7) \
+              S(p##8) S(p##9) S(p##a) S(p##b) S(p##c) S(p##d) S(p##e) S(p##f)
+#define S2(p) S1(p##0) S1(p##1) S1(p##2) S1(p##3) S1(p##4) S1(p##5) S1(p##6) S1(p##7) \
+              S1(p##8) S1(p##9) S1(p##a) S1(p##b) S1(p##c) S1(p##d) S1(p##e) S1(p##f)
+#define S3(p) S2(p##0) S2(p##1) S2(p##2) S2(p##3) S2(p##4) S2(p##5) S2(p##6) S2(p##7) \
+              S2(p##8) S2(p##9) S2(p##a) S2(p##b) S2(p##c) S2(p##d) S2(p##e) S2(p##f)
+
+int selrefParallelDlopenCollect(SEL *refs)
+{
+    int n = 0;
+    S3(selrefDlopenA) S3(selrefDlopenB) S3(selrefDlopenC)
+    S3(selrefDlopenD) S3(selrefDlopenE)
+    return n;
+}
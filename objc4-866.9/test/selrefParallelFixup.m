@@ -0,0 +1,64 @@
+// TEST_CONFIG
+
+// This image has more selector references than
+// CONFIG_PARALLEL_SELREF_MIN. It is mapped at launch, before libdispatch
+// is usable, so _read_images() fixes them up serially; images loaded
+// later are fixed up in parallel, as selrefParallelDlopen.m checks.
+// Every reference must end up as the registered SEL for its name, both
+// for new names and for names the runtime already knew.
+// selrefSerialFixup.m checks the same with the parallel fixup disabled.
+
+#include "test.h"
+#include <string.h>
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+
+#ifndef NAME
+#define NAME "selrefParallelFixup"
+#endif
+
+#define PREFIXES 5
+#define PER_PREFIX 4096
+#define COUNT (PREFIXES * PER_PREFIX)
+
+static SEL refs[COUNT];
+static int n;
+
+#define S(x) refs[n++] = @selector(x);
+#define S1(p) S(p##0) S(p##1) S(p##2) S(p##3) S(p##4) S(p##5) S(p##6) S(p##7) \
+              S(p##8) S(p##9) S(p##a) S(p##b) S(p##c) S(p##d) S(p##e) S(p##f)
+#define S2(p) S1(p##0) S1(p##1) S1(p##2) S1(p##3) S1(p##4) S1(p##5) S1(p##6) S1(p##7) \
+              S1(p##8) S1(p##9) S1(p##a) S1(p##b) S1(p##c) S1(p##d) S1(p##e) S1(p##f)
+#define S3(p) S2(p##0) S2(p##1) S2(p##2) S2(p##3) S2(p##4) S2(p##5) S2(p##6) S2(p##7) \
+              S2(p##8) S2(p##9) S2(p##a) S2(p##b) S2(p##c) S2(p##d) S2(p##e) S2(p##f)
+
+static void collect(void)
+{
+    S3(selrefFixupA) S3(selrefFixupB) S3(selrefFixupC)
+    S3(selrefFixupD) S3(selrefFixupE)
+}
+
+int main()
+{
+    collect();
+    testassert(n == COUNT);
+
+    const char *prefixes = "ABCDE";
+    for (int i = 0; i < COUNT; i++) {
+        char name[64];
+        int d = i % PER_PREFIX;
+        snprintf(name, sizeof(name), "selrefFixup%c%x%x%x",
+                 prefixes[i / PER_PREFIX], d >> 8, (d >> 4) & 0xf, d & 0xf);
+        testassert(0 == strcmp(sel_getName(refs[i]), name));
+        testassert(refs[i] == sel_lookUpByName(name));
+        testassert(refs[i] == sel_registerName(name));
+    }
+
+    // Names registered before this image was read.
+    testassert(@selector(retain) == sel_registerName("retain"));
+    testassert(@selector(description) == sel_registerName("description"));
+    testassert(@selector(initialize) == sel_registerName("initialize"));
+    testassert(@selector(alloc) == sel_lookUpByName("alloc"));
+
+    succeed(NAME);
+}
@@ -0,0 +1,8 @@
+// TEST_ENV OBJC_DISABLE_PARALLEL_IMAGE_READING=YES
+// TEST_CONFIG
+
+// selrefParallelFixup.m with the parallel selector fixup disabled.
+
+#define NAME "selrefSerialFixup"
+
+#include "selrefParallelFixup.m"
@@ -7,6 +7,7 @@
 #include <objc/runtime.h>
 #include <objc/objc-sync.h>
 #include <Foundation/NSObject.h>
+#include <mach/mach_time.h>
 
 // synchronized stress test
 // 2-D grid of counters and locks. 
@@ -16,6 +17,8 @@
 // * thread locks all locks [row][0] to [row][col], possibly recursively
 // * thread increments counter [row][col]
 // * thread unlocks all of the locks
+// Then time nested @synchronized on up to 256 distinct objects, and
+// @synchronized on a stream of short-lived objects.
 
 #if defined(__arm__)
 // 16 / 4 / 3 / 1024*8 test takes about 30s on 2nd gen iPod touch
@@ -34,6 +37,12 @@
 static id locks[ROWS][COLS];
 static int counts[ROWS][COLS];
 
+#define NESTED_MAX 256
+#define NESTED_ROUNDS 2000
+#define CHURN_OBJECTS 100000
+
+static id nested[NESTED_MAX];
+
 
 static void *threadfn(void *arg)
 {
@@ -105,8 +114,47 @@ int main()
             int err = objc_sync_enter(locks[r][c]);
             testassert(err == OBJC_SYNC_SUCCESS);
             testassert(counts[r][c] == THREADS*COUNT);
+            err = objc_sync_exit(locks[r][c]);
+            testassert(err == OBJC_SYNC_SUCCESS);
         }
     }
 
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+
+    // Nested: hold depth objects at once, then enter each one again.
+    for (int i = 0; i < NESTED_MAX; i++) {
+        nested[i] = [[NSObject alloc] init];
+    }
+    for (int depth = 1; depth <= NESTED_MAX; depth *= 4) {
+        uint64_t start = mach_absolute_time();
+        for (int n = 0; n < NESTED_ROUNDS; n++) {
+            for (int i = 0; i < depth; i++) objc_sync_enter(nested[i]);
+            for (int i = 0; i < depth; i++) objc_sync_enter(nested[i]);
+            for (int i = depth-1; i >= 0; i--) objc_sync_exit(nested[i]);
+            for (int i = depth-1; i >= 0; i--) objc_sync_exit(nested[i]);
+        }
+        uint64_t t = mach_absolute_time() - start;
+        testprintf("nested %3d: %6.2f ns per enter+exit\n", depth,
+                   (double)t * timebase.numer / timebase.denom
+                   / ((double)NESTED_ROUNDS * depth * 2));
+    }
+
+    // Churn: each object is synchronized once, then freed.
+    uint64_t start = mach_absolute_time();
+    for (int n = 0; n < CHURN_OBJECTS; n++) {
+        id obj = [[NSObject alloc] init];
+        objc_sync_enter(nested[0]);
+        objc_sync_enter(obj);
+        objc_sync_exit(obj);
+        objc_sync_exit(nested[0]);
+#if !__has_feature(objc_arc)
+        [obj release];
+#endif
+    }
+    uint64_t t = mach_absolute_time() - start;
+    testprintf("churn: %6.2f ns per object\n",
+               (double)t * timebase.numer / timebase.denom / CHURN_OBJECTS);
+
     succeed(__FILE__);
 }
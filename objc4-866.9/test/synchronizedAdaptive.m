@@ -0,0 +1,110 @@
+// TEST_CONFIG MEM=mrc
+
+// @synchronized with short critical sections from 1, 8, and 64 threads
+// on one object, where a contended lock should usually be taken by
+// spinning rather than blocking. Checks recursion and exit by a thread
+// that does not own the lock. Prints the lock's histograms.
+
+#include "test.h"
+#include <objc/objc-sync.h>
+#include <objc/objc-internal.h>
+#include <Foundation/NSObject.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+
+#define ITERATIONS 100000
+#define MAXTHREADS 64
+
+static id lockObject;
+static uintptr_t counter;
+static _Atomic int startFlag;
+
+static void *worker(void *arg __unused)
+{
+    while (!atomic_load(&startFlag)) { }
+    for (int i = 0; i < ITERATIONS; i++) {
+        @synchronized(lockObject) {
+            counter++;
+        }
+    }
+    return NULL;
+}
+
+static void *otherThreadExit(void *arg __unused)
+{
+    testassert(objc_sync_exit(lockObject) == OBJC_SYNC_NOT_OWNING_THREAD_ERROR);
+    return NULL;
+}
+
+int main()
+{
+    lockObject = [NSObject new];
+
+    // Recursion, and exit by a thread that does not hold the lock.
+    testassert(objc_sync_enter(lockObject) == OBJC_SYNC_SUCCESS);
+    testassert(objc_sync_enter(lockObject) == OBJC_SYNC_SUCCESS);
+    testassert(objc_sync_try_enter(lockObject));
+    pthread_t thread;
+    pthread_create(&thread, NULL, &otherThreadExit, NULL);
+    pthread_join(thread, NULL);
+    testassert(objc_sync_exit(lockObject) == OBJC_SYNC_SUCCESS);
+    testassert(objc_sync_exit(lockObject) == OBJC_SYNC_SUCCESS);
+    testassert(objc_sync_exit(lockObject) == OBJC_SYNC_SUCCESS);
+    testassert(objc_sync_exit(lockObject) == OBJC_SYNC_NOT_OWNING_THREAD_ERROR);
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    for (int threadCount = 1; threadCount <= MAXTHREADS; threadCount *= 8) {
+        pthread_t threads[MAXTHREADS];
+        counter = 0;
+        atomic_store(&startFlag, 0);
+        for (int t = 0; t < threadCount; t++) {
+            pthread_create(&threads[t], NULL, &worker, NULL);
+        }
+        uint64_t start = mach_absolute_time();
+        atomic_store(&startFlag, 1);
+        for (int t = 0; t < threadCount; t++) {
+            pthread_join(threads[t], NULL);
+        }
+        uint64_t t = mach_absolute_time() - start;
+        testassert(counter == (uintptr_t)threadCount * ITERATIONS);
+        testprintf("threads %2d: %7.2f ns per @synchronized\n", threadCount,
+                   (double)t * timebase.numer / timebase.denom
+                   / ((double)threadCount * ITERATIONS));
+    }
+
+    // Hold the lock so it stays assigned to lockObject while it is read.
+    struct objc_sync_lock_histograms histograms;
+    uint64_t holds = 0, contended = 0;
+    @synchronized(lockObject) {
+        testassert(_objc_getSyncLockHistograms(lockObject, &histograms));
+    }
+    for (unsigned i = 0; i < 32; i++) {
+        holds += histograms.hold[i];
+        if (histograms.hold[i]) {
+            testprintf("hold %10llu ns: %llu\n", 1ULL << i,
+                       (unsigned long long)histograms.hold[i]);
+        }
+    }
+    for (unsigned i = 0; i <= histograms.spinRounds; i++) {
+        contended += histograms.spin[i];
+        if (histograms.spin[i]) {
+            testprintf("%s %2u: %llu\n",
+                       i < histograms.spinRounds ? "spin rounds" : "blocked    ",
+                       i + 1, (unsigned long long)histograms.spin[i]);
+        }
+    }
+    // The lock may have been reassigned between thread counts, so only
+    // the last run is sure to be counted.
+    testassert(holds >= MAXTHREADS * ITERATIONS);
+    testassert(contended <= holds);
+
+    // Objects that were never synchronized have no lock.
+    id other = [NSObject new];
+    testassert(!_objc_getSyncLockHistograms(other, &histograms));
+    [other release];
+
+    [lockObject release];
+    succeed(__FILE__);
+}
@@ -0,0 +1,45 @@
+// TEST_CONFIG MEM=mrc
+
+// @synchronized on many objects that stay alive, one at a time. The
+// runtime's lock memory must follow the number of objects locked at
+// once, not the number ever locked.
+
+#include "test.h"
+#include <Foundation/NSObject.h>
+#include <malloc/malloc.h>
+
+#define OBJCOUNT 100000
+
+int main()
+{
+    id *objs = (id *)malloc(OBJCOUNT * sizeof(id));
+    for (int i = 0; i < OBJCOUNT; i++) {
+        objs[i] = [NSObject new];
+    }
+
+    // Warm up the per-thread cache and the lock lists.
+    for (int i = 0; i < 1000; i++) {
+        @synchronized(objs[i]) { }
+    }
+
+    malloc_statistics_t start, end;
+    malloc_zone_statistics(NULL, &start);
+
+    for (int i = 0; i < OBJCOUNT; i++) {
+        @synchronized(objs[i]) { }
+    }
+
+    malloc_zone_statistics(NULL, &end);
+
+    // One SyncData per object would be several megabytes.
+    ssize_t actual = end.size_in_use - start.size_in_use;
+    testprintf("%zd bytes for %d objects\n", actual, OBJCOUNT);
+    testassert(actual < 256 * 1024);
+
+    for (int i = 0; i < OBJCOUNT; i++) {
+        [objs[i] release];
+    }
+    free(objs);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,282 @@
+// TEST_CONFIG MEM=mrc
+
+// Thread-scaling benchmark for the runtime's hot paths: retain/release
+// (shallow and deep retain counts), weak store and load,
+// associated objects, @synchronized on private and shared objects,
+// autorelease pool push/pop, and method cache miss and fill.
+//
+// Each workload runs at 1, 2, 4, ... threads, up to
+// THREAD_SCALING_MAX_THREADS (default 64). Every thread times SAMPLES
+// batches. The report gives p50, p90, p99 and worst ns per operation
+// over all batches of all threads, and the total throughput. Set
+// THREAD_SCALING_JSON to a file path to also write the results as JSON.
+// threadScalingRawIsa.m runs the same workloads with raw isa, where
+// every retain count lives in the side table.
+// Beyond test.h, only libobjc and POSIX are used, so the benchmark
+// needs no Foundation or Mach timebase.
+
+#include "test.h"
+#include <objc/runtime.h>
+#include <objc/message.h>
+#include <objc/objc-internal.h>
+#include <objc/NSObject.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#ifndef NAME
+#define NAME "threadScaling"
+#endif
+#ifndef RETAIN_KIND
+#define RETAIN_KIND "inline"
+#endif
+
+#define SAMPLES 16
+#define BATCH 1024
+#define CACHE_SELECTORS 64
+#define MAXTHREADS 256
+
+// Retains held at once by the deep retain count workload. They
+// overflow the 8-bit inline count of x86_64 nonpointer isas into the
+// side table. Overflowing the 19-bit arm64 count would take seconds
+// per run, so there they stay inline; threadScalingRawIsa.m covers
+// side table counts everywhere.
+#define RC_SPAN 4096
+
+struct thread_state {
+    id obj;       // private to the thread
+    id cacheObj;  // instance of a class private to the thread
+    id weakVar;
+    double samples[SAMPLES];  // ns per op of each batch
+};
+
+struct workload {
+    const char *name;
+    void (*prepare)(struct thread_state *);  // untimed, before each batch
+    void (*run)(struct thread_state *);
+    unsigned ops;  // operations per batch
+};
+
+static struct thread_state states[MAXTHREADS];
+static SEL cacheSels[CACHE_SELECTORS];
+static id sharedObj;
+static char assocKey;
+static const struct workload *current;
+static _Atomic int startFlag;
+
+static id methodReturningSelf(id self, SEL _cmd __unused) { return self; }
+
+static uint64_t nowNanoseconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void retainRelease(struct thread_state *state)
+{
+    id obj = state->obj;
+    for (int i = 0; i < BATCH; i++) {
+        objc_retain(obj);
+        objc_release(obj);
+    }
+}
+
+static void retainReleaseDeep(struct thread_state *state)
+{
+    id obj = state->obj;
+    for (int i = 0; i < RC_SPAN; i++) objc_retain(obj);
+    for (int i = 0; i < RC_SPAN; i++) objc_release(obj);
+}
+
+static void weakStoreLoad(struct thread_state *state)
+{
+    for (int i = 0; i < BATCH; i++) {
+        objc_storeWeak(&state->weakVar, (i & 1) ? state->obj : sharedObj);
+        objc_release(objc_loadWeakRetained(&state->weakVar));
+    }
+    objc_storeWeak(&state->weakVar, nil);
+}
+
+static void assocSetGet(struct thread_state *state)
+{
+    for (int i = 0; i < BATCH; i++) {
+        objc_setAssociatedObject(state->obj, &assocKey, (i & 1) ? sharedObj : nil,
+                                 OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+        objc_getAssociatedObject(state->obj, &assocKey);
+    }
+}
+
+static void synchronizedPrivate(struct thread_state *state)
+{
+    for (int i = 0; i < BATCH; i++) {
+        @synchronized(state->obj) { }
+    }
+}
+
+static void synchronizedShared(struct thread_state *state __unused)
+{
+    for (int i = 0; i < BATCH; i++) {
+        @synchronized(sharedObj) { }
+    }
+}
+
+static void autoreleasePool(struct thread_state *state)
+{
+    for (int i = 0; i < BATCH; i++) {
+        void *pool = objc_autoreleasePoolPush();
+        objc_autorelease(objc_retain(state->obj));
+        objc_autoreleasePoolPop(pool);
+    }
+}
+
+static void flushCache(struct thread_state *state)
+{
+    _objc_flush_caches(object_getClass(state->cacheObj));
+}
+
+static void cacheMissFill(struct thread_state *state)
+{
+    for (int i = 0; i < CACHE_SELECTORS; i++) {
+        ((id(*)(id, SEL))objc_msgSend)(state->cacheObj, cacheSels[i]);
+    }
+}
+
+static const struct workload workloads[] = {
+    { "retain_release_" RETAIN_KIND, NULL, &retainRelease, BATCH * 2 },
+    { "retain_release_deep", NULL, &retainReleaseDeep, RC_SPAN * 2 },
+    { "weak_store_load", NULL, &weakStoreLoad, BATCH * 2 },
+    { "assoc_set_get", NULL, &assocSetGet, BATCH * 2 },
+    { "synchronized_private", NULL, &synchronizedPrivate, BATCH },
+    { "synchronized_shared", NULL, &synchronizedShared, BATCH },
+    { "autorelease_push_pop", NULL, &autoreleasePool, BATCH },
+    { "cache_miss_fill", &flushCache, &cacheMissFill, CACHE_SELECTORS },
+};
+
+
+static void *runner(void *arg)
+{
+    struct thread_state *state = (struct thread_state *)arg;
+    while (!atomic_load(&startFlag)) { }
+    for (int s = 0; s < SAMPLES; s++) {
+        if (current->prepare) current->prepare(state);
+        uint64_t start = nowNanoseconds();
+        current->run(state);
+        uint64_t t = nowNanoseconds() - start;
+        state->samples[s] = (double)t / current->ops;
+    }
+    return NULL;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, unsigned count, unsigned p)
+{
+    return sorted[(count - 1) * p / 100];
+}
+
+static void measure(const struct workload *w, unsigned threadCount, FILE *json)
+{
+    pthread_t threads[MAXTHREADS];
+    current = w;
+    atomic_store(&startFlag, 0);
+    for (unsigned t = 0; t < threadCount; t++) {
+        pthread_create(&threads[t], NULL, &runner, &states[t]);
+    }
+    uint64_t start = nowNanoseconds();
+    atomic_store(&startFlag, 1);
+    for (unsigned t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    double wall = (double)(nowNanoseconds() - start);
+
+    unsigned count = threadCount * SAMPLES;
+    double *all = (double *)malloc(count * sizeof(double));
+    for (unsigned t = 0; t < threadCount; t++) {
+        memcpy(&all[t * SAMPLES], states[t].samples, sizeof(states[t].samples));
+    }
+    qsort(all, count, sizeof(double), &compareDoubles);
+    double p50 = percentile(all, count, 50);
+    double p90 = percentile(all, count, 90);
+    double p99 = percentile(all, count, 99);
+    double worst = all[count - 1];
+    double mops = (double)w->ops * count / wall * 1000;
+    free(all);
+
+    testprintf("%-26s %3u threads: p50 %8.2f  p90 %8.2f  p99 %8.2f  "
+               "max %8.2f ns/op  %9.2f Mops/s\n",
+               w->name, threadCount, p50, p90, p99, worst, mops);
+    if (json) {
+        static bool first = true;
+        fprintf(json, "%s\n    { \"workload\": \"%s\", \"threads\": %u, "
+                "\"p50_ns\": %.3f, \"p90_ns\": %.3f, \"p99_ns\": %.3f, "
+                "\"max_ns\": %.3f, \"mops_per_sec\": %.3f }",
+                first ? "" : ",", w->name, threadCount,
+                p50, p90, p99, worst, mops);
+        first = false;
+    }
+}
+
+int main()
+{
+    unsigned maxThreads = 64;
+    if (getenv("THREAD_SCALING_MAX_THREADS")) {
+        maxThreads = (unsigned)strtoul(getenv("THREAD_SCALING_MAX_THREADS"), NULL, 10);
+        testassert(maxThreads >= 1  &&  maxThreads <= MAXTHREADS);
+    }
+
+    FILE *json = NULL;
+    if (getenv("THREAD_SCALING_JSON")) {
+        json = fopen(getenv("THREAD_SCALING_JSON"), "w");
+        testassert(json);
+        fprintf(json, "{\n  \"test\": \"%s\",\n  \"samples_per_thread\": %d,\n"
+                "  \"results\": [", NAME, SAMPLES);
+    }
+
+    sharedObj = [NSObject new];
+    for (int i = 0; i < CACHE_SELECTORS; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "threadScalingMethod%d", i);
+        cacheSels[i] = sel_registerName(name);
+    }
+    for (unsigned t = 0; t < maxThreads; t++) {
+        char name[64];
+        snprintf(name, sizeof(name), "ThreadScalingClass%u", t);
+        Class cls = objc_allocateClassPair([NSObject class], name, 0);
+        for (int i = 0; i < CACHE_SELECTORS; i++) {
+            class_addMethod(cls, cacheSels[i], (IMP)methodReturningSelf, "@@:");
+        }
+        objc_registerClassPair(cls);
+        states[t].obj = [NSObject new];
+        states[t].cacheObj = [cls new];
+    }
+
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        for (unsigned threadCount = 1; ; threadCount *= 2) {
+            if (threadCount > maxThreads) threadCount = maxThreads;
+            measure(&workloads[w], threadCount, json);
+            if (threadCount == maxThreads) break;
+        }
+    }
+
+    if (json) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+    }
+
+    for (unsigned t = 0; t < maxThreads; t++) {
+        testassert([states[t].obj retainCount] == 1);
+        objc_setAssociatedObject(states[t].obj, &assocKey, nil, OBJC_ASSOCIATION_ASSIGN);
+        [states[t].obj release];
+        [states[t].cacheObj release];
+    }
+    testassert([sharedObj retainCount] == 1);
+    [sharedObj release];
+
+    succeed(NAME);
+}
@@ -0,0 +1,10 @@
+// TEST_ENV OBJC_DISABLE_NONPOINTER_ISA=YES
+// TEST_CONFIG MEM=mrc
+
+// threadScaling.m with raw isa, so every retain count is kept in the
+// side table.
+
+#define NAME "threadScalingRawIsa"
+#define RETAIN_KIND "sidetable"
+
+#include "threadScaling.m"
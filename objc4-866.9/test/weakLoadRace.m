@@ -0,0 +1,81 @@
+// TEST_CONFIG MEM=mrc
+
+// objc_loadWeakRetained() without the weak lock versus weak clear in
+// dealloc. Readers load a weak variable while the main thread replaces
+// and deallocates its referent. Every load must return nil or a live
+// object, and every object must be deallocated exactly once.
+
+#include "test.h"
+#include <objc/NSObject.h>
+#include <objc/objc-internal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define READERS 8
+#define CYCLES 100000
+
+static _Atomic int liveObjects;
+static _Atomic int done;
+static id weakVar;
+
+@interface WeakLoadRaceObject : NSObject {
+@public
+    uintptr_t magic;
+}
+@end
+@implementation WeakLoadRaceObject
+-(id)init {
+    self = [super init];
+    magic = 0x5eed;
+    atomic_fetch_add(&liveObjects, 1);
+    return self;
+}
+-(void)dealloc {
+    testassert(magic == 0x5eed);
+    magic = 0;
+    atomic_fetch_sub(&liveObjects, 1);
+    [super dealloc];
+}
+@end
+
+static void *reader(void *arg __unused)
+{
+    uintptr_t hits = 0;
+    while (!atomic_load(&done)) {
+        WeakLoadRaceObject *obj = objc_loadWeakRetained(&weakVar);
+        if (obj) {
+            testassert(obj->magic == 0x5eed);
+            hits++;
+            [obj release];
+        }
+    }
+    testprintf("reader %p: %lu hits\n", pthread_self(), hits);
+    return NULL;
+}
+
+int main()
+{
+    objc_initWeak(&weakVar, nil);
+
+    pthread_t threads[READERS];
+    for (int t = 0; t < READERS; t++) {
+        pthread_create(&threads[t], NULL, &reader, NULL);
+    }
+
+    for (int i = 0; i < CYCLES; i++) {
+        id obj = [WeakLoadRaceObject new];
+        objc_storeWeak(&weakVar, obj);
+        [obj release];
+    }
+
+    atomic_store(&done, 1);
+    for (int t = 0; t < READERS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    testassert(objc_loadWeakRetained(&weakVar) == nil);
+    objc_destroyWeak(&weakVar);
+    testassert(liveObjects == 0);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,88 @@
+// TEST_CONFIG MEM=mrc
+
+// Weak stores and objc_loadWeakRetained from 1, 8, and 64 threads.
+// Each thread stores its own objects into its own weak variables and
+// loads them back while also asking for the retain counts of objects
+// shared by all threads, which takes the refcount locks of the same
+// stripes. Reports ns/op.
+
+#include "test.h"
+#include <objc/objc-internal.h>
+#include <Foundation/Foundation.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+
+#define OBJECTS 64
+#define ITERATIONS 2000
+#define MAXTHREADS 64
+
+static id shared[OBJECTS];
+static _Atomic int startFlag;
+
+static void *worker(void *arg)
+{
+    intptr_t index = (intptr_t)arg;
+    id objs[OBJECTS];
+    id weaks[OBJECTS];
+    for (int i = 0; i < OBJECTS; i++) {
+        objs[i] = [NSObject new];
+        weaks[i] = nil;
+    }
+
+    while (!atomic_load(&startFlag)) { }
+
+    for (int n = 0; n < ITERATIONS; n++) {
+        for (int i = 0; i < OBJECTS; i++) {
+            objc_storeWeak(&weaks[i], objs[i]);
+            id loaded = objc_loadWeakRetained(&weaks[i]);
+            testassert(loaded == objs[i]);
+            objc_release(loaded);
+            testassert([shared[(i + index) % OBJECTS] retainCount] == 1);
+        }
+    }
+
+    for (int i = 0; i < OBJECTS; i++) {
+        [objs[i] release];
+        testassert(objc_loadWeakRetained(&weaks[i]) == nil);
+        objc_destroyWeak(&weaks[i]);
+    }
+    return NULL;
+}
+
+static uint64_t run(int threadCount)
+{
+    pthread_t threads[MAXTHREADS];
+    atomic_store(&startFlag, 0);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_create(&threads[t], NULL, &worker, (void *)(intptr_t)t);
+    }
+    uint64_t start = mach_absolute_time();
+    atomic_store(&startFlag, 1);
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    return mach_absolute_time() - start;
+}
+
+int main()
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    for (int i = 0; i < OBJECTS; i++) {
+        shared[i] = [NSObject new];
+    }
+
+    for (int threadCount = 1; threadCount <= MAXTHREADS; threadCount *= 8) {
+        uint64_t t = run(threadCount);
+        double ops = (double)threadCount * ITERATIONS * OBJECTS;
+        testprintf("threads %2d: %7.2f ns/op\n", threadCount,
+                   t * timebase.numer / timebase.denom / ops);
+    }
+
+    for (int i = 0; i < OBJECTS; i++) {
+        [shared[i] release];
+    }
+
+    succeed(__FILE__);
+}
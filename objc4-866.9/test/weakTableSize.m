@@ -0,0 +1,88 @@
+// TEST_CONFIG MEM=mrc
+
+// Weak table register, unregister, and clear at 10^3 and more live
+// entries. Each size registers one weak variable per object, moves half
+// of the variables to nil, then deallocates every object. Reports the
+// mean and worst ns per operation; the worst case shows whether any
+// single operation paid for a whole table resize.
+// Sizes go up to 10^5 by default. Set WEAK_TABLE_MAX_ENTRIES to go
+// further, up to 10^7.
+
+#include "test.h"
+#include <objc/NSObject.h>
+#include <objc/objc-internal.h>
+#include <mach/mach_time.h>
+
+struct stat_t {
+    uint64_t total;
+    uint64_t worst;
+};
+
+static mach_timebase_info_data_t timebase;
+
+static double ns(uint64_t t)
+{
+    return (double)t * timebase.numer / timebase.denom;
+}
+
+static void record(struct stat_t *stat, uint64_t t)
+{
+    stat->total += t;
+    if (t > stat->worst) stat->worst = t;
+}
+
+static void run(size_t count)
+{
+    id *objs = (id *)malloc(count * sizeof(id));
+    id *vars = (id *)calloc(count, sizeof(id));
+    for (size_t i = 0; i < count; i++) {
+        objs[i] = [NSObject new];
+    }
+
+    struct stat_t reg = {}, unreg = {}, clear = {};
+    for (size_t i = 0; i < count; i++) {
+        uint64_t start = mach_absolute_time();
+        objc_storeWeak(&vars[i], objs[i]);
+        record(&reg, mach_absolute_time() - start);
+    }
+    for (size_t i = 0; i < count; i += 2) {
+        uint64_t start = mach_absolute_time();
+        objc_storeWeak(&vars[i], nil);
+        record(&unreg, mach_absolute_time() - start);
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint64_t start = mach_absolute_time();
+        [objs[i] release];
+        record(&clear, mach_absolute_time() - start);
+    }
+    for (size_t i = 0; i < count; i++) {
+        testassert(vars[i] == nil);
+    }
+
+    testprintf("%8zu entries: register %6.1f ns (worst %9.0f), "
+               "unregister %6.1f ns (worst %9.0f), "
+               "clear+dealloc %6.1f ns (worst %9.0f)\n",
+               count,
+               ns(reg.total) / count, ns(reg.worst),
+               ns(unreg.total) / (count / 2), ns(unreg.worst),
+               ns(clear.total) / count, ns(clear.worst));
+
+    free(objs);
+    free(vars);
+}
+
+int main()
+{
+    mach_timebase_info(&timebase);
+
+    size_t max = 100000;
+    if (getenv("WEAK_TABLE_MAX_ENTRIES")) {
+        max = strtoul(getenv("WEAK_TABLE_MAX_ENTRIES"), NULL, 10);
+        if (max > 10000000) max = 10000000;
+    }
+    for (size_t count = 1000; count <= max; count *= 10) {
+        run(count);
+    }
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,102 @@
+// TEST_CONFIG MEM=mrc
+
+// Runtime metadata from the packed zone allocators is cached per thread.
+// Threads create, extend, and dispose of classes, which allocates and
+// frees class_rw_ext_t. Every class must come back intact, and
+// _objc_getZoneStatistics() must count the allocations, frees, and
+// magazine traffic of the class_rw_ext_t zone.
+
+#include "test.h"
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+#include <Foundation/NSObject.h>
+#include <pthread.h>
+#include <mach/mach_time.h>
+
+#define THREADS 8
+#define CLASSES 2000
+#define MAXZONES 8
+
+static id method(id self, SEL _cmd __unused) { return self; }
+
+static void *worker(void *arg)
+{
+    uintptr_t t = (uintptr_t)arg;
+    for (int i = 0; i < CLASSES; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "ZoneStatisticsClass_%lu_%d", (unsigned long)t, i);
+        Class cls = objc_allocateClassPair([NSObject class], name, 0);
+        testassert(cls);
+        // Adding a method gives the class a class_rw_ext_t.
+        testassert(class_addMethod(cls, @selector(zoneStatisticsMethod), (IMP)method, "@@:"));
+        objc_registerClassPair(cls);
+        testassert(class_getMethodImplementation(cls, @selector(zoneStatisticsMethod)) == (IMP)method);
+        objc_disposeClassPair(cls);
+    }
+    return NULL;
+}
+
+static const struct objc_zone_statistics *
+findZone(struct objc_zone_statistics *stats, unsigned count, const char *name)
+{
+    for (unsigned i = 0; i < count; i++) {
+        if (0 == strcmp(stats[i].name, name)) return &stats[i];
+    }
+    return NULL;
+}
+
+int main()
+{
+    struct objc_zone_statistics before[MAXZONES];
+    unsigned count = _objc_getZoneStatistics(before, MAXZONES);
+    testassert(count <= MAXZONES);
+    for (unsigned i = 0; i < count; i++) {
+        testassert(before[i].elementSize > 0);
+    }
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    pthread_t threads[THREADS];
+    uint64_t start = mach_absolute_time();
+    for (uintptr_t t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &worker, (void *)t);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    testprintf("%.0f ns per class create/extend/dispose\n",
+               (double)(mach_absolute_time() - start) * timebase.numer
+               / timebase.denom / (THREADS * CLASSES));
+
+    struct objc_zone_statistics after[MAXZONES];
+    testassert(_objc_getZoneStatistics(after, MAXZONES) == count);
+    for (unsigned i = 0; i < count; i++) {
+        testprintf("%s (%zu bytes): %llu allocations, %llu frees, "
+                   "%llu refills, %llu spills, %llu slabs\n",
+                   after[i].name, after[i].elementSize,
+                   after[i].allocations, after[i].frees,
+                   after[i].refills, after[i].spills, after[i].slabs);
+    }
+
+    // The exited threads have added in their counts. Each one allocated
+    // and freed a class_rw_ext_t per class, which is always packed.
+    const struct objc_zone_statistics *rwe0 = findZone(before, count, "class_rw_ext_t");
+    const struct objc_zone_statistics *rwe1 = findZone(after, count, "class_rw_ext_t");
+    testassert(rwe0  &&  rwe1);
+    testassert(rwe1->elementSize % 16 != 0);
+    testassert(rwe1->allocations - rwe0->allocations >= THREADS * CLASSES);
+    testassert(rwe1->frees - rwe0->frees >= THREADS * CLASSES);
+    // Each thread filled its magazine once and spilled it on exit.
+    // Allocating and freeing one element at a time never goes back to
+    // the depot, even at a magazine boundary: the loaded and previous
+    // magazines are swapped instead.
+    uint64_t filled = (rwe1->refills + rwe1->slabs) - (rwe0->refills + rwe0->slabs);
+    uint64_t spilled = rwe1->spills - rwe0->spills;
+    testassert(filled >= THREADS  &&  filled <= THREADS * 4);
+    testassert(spilled >= THREADS  &&  spilled <= THREADS * 4);
+
+    // The count alone can be asked for.
+    testassert(_objc_getZoneStatistics(NULL, 0) == count);
+
+    succeed(__FILE__);
+}